@@ -0,0 +1,347 @@
+#include "Autotiler.hpp"
+#include "Map.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+namespace tmx
+{
+
+Autotiler::Autotiler(Layer& layer, Tileset& tileset, unsigned int seed)
+: mLayer(layer)
+, mTileset(tileset)
+, mRandom(seed)
+, mResolving(false)
+, mSize()
+, mCorners()
+, mSignatures()
+, mChoices()
+, mGids()
+, mProbabilities()
+, mAliases()
+{
+    mLayer.addListener(this);
+    rebuild();
+}
+
+Autotiler::~Autotiler()
+{
+    mLayer.removeListener(this);
+}
+
+int Autotiler::getTerrain(std::string const& name) const
+{
+    for (std::size_t i = 0; i < mTileset.terrains(); i++)
+    {
+        if (mTileset.getTerrain(i).getName() == name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void Autotiler::paint(sf::Vector2i const& coords, int terrain)
+{
+    paint(std::vector<sf::Vector2i>(1, coords), terrain);
+}
+
+void Autotiler::paint(std::vector<sf::Vector2i> const& cells, int terrain)
+{
+    if (terrain < -1 || terrain >= static_cast<int>(std::min(mTileset.terrains(), std::size_t(255))))
+    {
+        detail::log("Autotiler : Unknown terrain " + detail::toString(terrain));
+        return;
+    }
+    ensureSize();
+    sf::Vector2i size = mLayer.getMap().getMapSize();
+    std::vector<std::size_t> resolved;
+    resolved.reserve(cells.size() * 9);
+    for (std::size_t i = 0; i < cells.size(); i++)
+    {
+        sf::Vector2i const& coords = cells[i];
+        if (coords.x < 0 || coords.x >= size.x || coords.y < 0 || coords.y >= size.y)
+        {
+            continue;
+        }
+        setCornerValue(coords, terrain);
+        setCornerValue(sf::Vector2i(coords.x + 1, coords.y), terrain);
+        setCornerValue(sf::Vector2i(coords.x, coords.y + 1), terrain);
+        setCornerValue(sf::Vector2i(coords.x + 1, coords.y + 1), terrain);
+        for (int y = std::max(coords.y - 1, 0); y <= std::min(coords.y + 1, size.y - 1); y++)
+        {
+            for (int x = std::max(coords.x - 1, 0); x <= std::min(coords.x + 1, size.x - 1); x++)
+            {
+                resolved.push_back(x + y * size.x);
+            }
+        }
+    }
+
+    // Cells shared by the neighbourhoods of several painted cells are resolved once
+    std::sort(resolved.begin(), resolved.end());
+    resolved.erase(std::unique(resolved.begin(), resolved.end()), resolved.end());
+    std::vector<sf::Vector2i> changed;
+    std::vector<unsigned int> gids;
+    for (std::size_t i = 0; i < resolved.size(); i++)
+    {
+        resolve(sf::Vector2i(static_cast<int>(resolved[i] % size.x), static_cast<int>(resolved[i] / size.x)), changed, gids);
+    }
+    setTiles(changed, gids);
+}
+
+void Autotiler::paintCorner(sf::Vector2i const& corner, int terrain)
+{
+    if (terrain < -1 || terrain >= static_cast<int>(std::min(mTileset.terrains(), std::size_t(255))))
+    {
+        detail::log("Autotiler : Unknown terrain " + detail::toString(terrain));
+        return;
+    }
+    ensureSize();
+    if (corner.x < 0 || corner.x >= mSize.x || corner.y < 0 || corner.y >= mSize.y)
+    {
+        return;
+    }
+    setCornerValue(corner, terrain);
+    sf::Vector2i size = mLayer.getMap().getMapSize();
+    std::vector<sf::Vector2i> changed;
+    std::vector<unsigned int> gids;
+    for (int y = std::max(corner.y - 1, 0); y <= std::min(corner.y, size.y - 1); y++)
+    {
+        for (int x = std::max(corner.x - 1, 0); x <= std::min(corner.x, size.x - 1); x++)
+        {
+            resolve(sf::Vector2i(x, y), changed, gids);
+        }
+    }
+    setTiles(changed, gids);
+}
+
+int Autotiler::getCorner(sf::Vector2i const& corner) const
+{
+    if (corner.x < 0 || corner.x >= mSize.x || corner.y < 0 || corner.y >= mSize.y)
+    {
+        return -1;
+    }
+    return mCorners[corner.x + corner.y * mSize.x];
+}
+
+void Autotiler::setSeed(unsigned int seed)
+{
+    mRandom.seed(seed);
+}
+
+void Autotiler::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (!mResolving && ensureSize())
+    {
+        readTile(coords, gid);
+    }
+}
+
+void Autotiler::rebuild()
+{
+    // Signatures of the tiles, the tiles of a signature are grouped in order of their id
+    std::map<unsigned int, std::vector<std::size_t>> groups;
+    mSignatures.assign(mTileset.getTileCount(), 0);
+    for (std::size_t i = 0; i < mTileset.tiles(); i++)
+    {
+        Tileset::Tile& tile = mTileset.getTile(i);
+        int corners[4];
+        for (std::size_t j = 0; j < 4; j++)
+        {
+            const std::string& terrain = tile.getTerrain(j);
+            corners[j] = (terrain.empty()) ? -1 : std::atoi(terrain.c_str());
+            if (corners[j] < -1 || corners[j] >= 255)
+            {
+                corners[j] = -1;
+            }
+        }
+        unsigned int signature = getSignature(corners[0], corners[1], corners[2], corners[3]);
+        if (signature != 0)
+        {
+            if (tile.getId() >= mSignatures.size())
+            {
+                mSignatures.resize(tile.getId() + 1, 0);
+            }
+            mSignatures[tile.getId()] = signature;
+            groups[signature].push_back(i);
+        }
+    }
+
+    // Alias tables (Vose) : a slot is drawn uniformly, then either its own tile or its alias by one more draw
+    mChoices.clear();
+    mGids.clear();
+    mProbabilities.clear();
+    mAliases.clear();
+    for (auto itr = groups.begin(); itr != groups.end(); itr++)
+    {
+        std::vector<std::size_t> const& tiles = itr->second;
+        Choice choice;
+        choice.first = mGids.size();
+        choice.count = tiles.size();
+        mChoices[itr->first] = choice;
+
+        float total = 0.f;
+        for (std::size_t i = 0; i < tiles.size(); i++)
+        {
+            total += std::max(mTileset.getTile(tiles[i]).getProbability(), 0.f);
+        }
+        std::vector<float> scaled(tiles.size());
+        std::vector<std::size_t> small;
+        std::vector<std::size_t> large;
+        for (std::size_t i = 0; i < tiles.size(); i++)
+        {
+            // Tiles which can never be drawn are still used when they are the only ones
+            float weight = (total > 0.f) ? std::max(mTileset.getTile(tiles[i]).getProbability(), 0.f) / total : 1.f / tiles.size();
+            scaled[i] = weight * tiles.size();
+            ((scaled[i] < 1.f) ? small : large).push_back(i);
+            mGids.push_back(mTileset.getFirstGid() + mTileset.getTile(tiles[i]).getId());
+            mProbabilities.push_back(1.f);
+            mAliases.push_back(i);
+        }
+        while (!small.empty() && !large.empty())
+        {
+            std::size_t less = small.back();
+            std::size_t more = large.back();
+            small.pop_back();
+            large.pop_back();
+            mProbabilities[choice.first + less] = scaled[less];
+            mAliases[choice.first + less] = more;
+            scaled[more] += scaled[less] - 1.f;
+            ((scaled[more] < 1.f) ? small : large).push_back(more);
+        }
+    }
+
+    // Corners from the tiles already on the layer
+    mSize = mLayer.getMap().getMapSize() + sf::Vector2i(1, 1);
+    mCorners.assign(mSize.x * mSize.y, -1);
+    sf::Vector2i coords;
+    for (coords.y = 0; coords.y + 1 < mSize.y; coords.y++)
+    {
+        for (coords.x = 0; coords.x + 1 < mSize.x; coords.x++)
+        {
+            readTile(coords, mLayer.getTileId(coords));
+        }
+    }
+}
+
+unsigned int Autotiler::getSignature(int topLeft, int topRight, int bottomLeft, int bottomRight)
+{
+    // One byte by corner, 0 for none, so the signature of a tile without terrain is 0
+    return static_cast<unsigned int>(topLeft + 1) | static_cast<unsigned int>(topRight + 1) << 8
+         | static_cast<unsigned int>(bottomLeft + 1) << 16 | static_cast<unsigned int>(bottomRight + 1) << 24;
+}
+
+unsigned int Autotiler::getCellSignature(sf::Vector2i const& coords) const
+{
+    std::size_t corner = coords.x + coords.y * mSize.x;
+    return getSignature(mCorners[corner], mCorners[corner + 1], mCorners[corner + mSize.x], mCorners[corner + mSize.x + 1]);
+}
+
+unsigned int Autotiler::getTileSignature(unsigned int gid) const
+{
+    if (gid < mTileset.getFirstGid() || gid - mTileset.getFirstGid() >= mSignatures.size())
+    {
+        return 0;
+    }
+    return mSignatures[gid - mTileset.getFirstGid()];
+}
+
+const Autotiler::Choice* Autotiler::findChoice(unsigned int signature)
+{
+    auto itr = mChoices.find(signature);
+    if (itr != mChoices.end())
+    {
+        return (itr->second.count > 0) ? &itr->second : nullptr;
+    }
+
+    // Without a tile for these corners, the tiles with the most corners in common are used, and remembered
+    unsigned int best = 0;
+    int bestScore = 0;
+    for (itr = mChoices.begin(); itr != mChoices.end(); itr++)
+    {
+        if (itr->second.count == 0)
+        {
+            continue;
+        }
+        unsigned int candidate = getTileSignature(mGids[itr->second.first]);
+        int score = 0;
+        for (unsigned int shift = 0; shift < 32; shift += 8)
+        {
+            score += (((candidate >> shift) & 0xff) == ((signature >> shift) & 0xff)) ? 1 : 0;
+        }
+        if (score > bestScore || (score == bestScore && score > 0 && candidate < best))
+        {
+            best = candidate;
+            bestScore = score;
+        }
+    }
+    Choice choice = (bestScore > 0) ? mChoices[best] : Choice();
+    choice.count = (bestScore > 0) ? choice.count : 0;
+    mChoices[signature] = choice;
+    return (choice.count > 0) ? &mChoices[signature] : nullptr;
+}
+
+unsigned int Autotiler::pick(Choice const& choice)
+{
+    std::size_t slot = std::uniform_int_distribution<std::size_t>(0, choice.count - 1)(mRandom);
+    float draw = std::uniform_real_distribution<float>(0.f, 1.f)(mRandom);
+    std::size_t index = (draw < mProbabilities[choice.first + slot]) ? slot : mAliases[choice.first + slot];
+    return mGids[choice.first + index];
+}
+
+void Autotiler::setCornerValue(sf::Vector2i const& corner, int terrain)
+{
+    if (0 <= corner.x && corner.x < mSize.x && 0 <= corner.y && corner.y < mSize.y)
+    {
+        mCorners[corner.x + corner.y * mSize.x] = terrain;
+    }
+}
+
+void Autotiler::readTile(sf::Vector2i const& coords, unsigned int gid)
+{
+    // Tiles without terrain leave the corners as they are
+    unsigned int signature = getTileSignature(gid);
+    if (signature != 0)
+    {
+        setCornerValue(coords, static_cast<int>(signature & 0xff) - 1);
+        setCornerValue(sf::Vector2i(coords.x + 1, coords.y), static_cast<int>((signature >> 8) & 0xff) - 1);
+        setCornerValue(sf::Vector2i(coords.x, coords.y + 1), static_cast<int>((signature >> 16) & 0xff) - 1);
+        setCornerValue(sf::Vector2i(coords.x + 1, coords.y + 1), static_cast<int>(signature >> 24) - 1);
+    }
+}
+
+void Autotiler::resolve(sf::Vector2i const& coords, std::vector<sf::Vector2i>& cells, std::vector<unsigned int>& gids)
+{
+    unsigned int signature = getCellSignature(coords);
+    const Choice* choice = (signature != 0) ? findChoice(signature) : nullptr;
+    unsigned int target = (choice != nullptr) ? getTileSignature(mGids[choice->first]) : 0;
+
+    // A tile already matching is kept, so the variations drawn before stay, as do the tiles without terrain
+    unsigned int current = mLayer.getTileId(coords);
+    if (getTileSignature(current) != target)
+    {
+        cells.push_back(coords);
+        gids.push_back((choice != nullptr) ? pick(*choice) : 0);
+    }
+}
+
+void Autotiler::setTiles(std::vector<sf::Vector2i> const& cells, std::vector<unsigned int> const& gids)
+{
+    // The corners are already set, the tiles must not change them back
+    mResolving = true;
+    mLayer.setTileIds(cells, gids);
+    mResolving = false;
+}
+
+bool Autotiler::ensureSize()
+{
+    if (mSize != mLayer.getMap().getMapSize() + sf::Vector2i(1, 1))
+    {
+        rebuild();
+        return false;
+    }
+    return true;
+}
+
+} // namespace tmx
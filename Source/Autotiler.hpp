@@ -0,0 +1,81 @@
+#ifndef TMX_AUTOTILER_HPP
+#define TMX_AUTOTILER_HPP
+
+#include <random>
+#include <unordered_map>
+
+#include "Layer.hpp"
+
+namespace tmx
+{
+
+// Terrain painting on a tile layer, from the terrain types of a tileset and the four corner terrains of its tiles
+// Terrains are the indices of the tileset terrains, -1 for none, and are held by the corners of the cells
+// A cell shows a tile with the same four corners, drawn among them with their probability by the alias method,
+// or the tile with the most corners in common, a cell whose tile already matches keeps it,
+// and a cell left without any terrain loses its terrain tile
+// Painting only resolves the cells around the changed corners, the 3x3 cells around a painted cell,
+// and sets their new tiles as one bulk edit of the layer
+// Corners follow the cell coordinates, as in Tiled for orthogonal and isometric maps
+// The autotiler listens to its layer, so tiles set by other means update the corners, and must not outlive it
+class Autotiler : public Layer::Listener
+{
+    public:
+        Autotiler(Layer& layer, Tileset& tileset, unsigned int seed = 0);
+        ~Autotiler();
+
+        // Index of a terrain of the tileset by its name, -1 if there is none
+        int getTerrain(std::string const& name) const;
+
+        // The four corners of a cell, or one corner (from 0 to the map size included)
+        void paint(sf::Vector2i const& coords, int terrain);
+        void paint(std::vector<sf::Vector2i> const& cells, int terrain);
+        void paintCorner(sf::Vector2i const& corner, int terrain);
+        int getCorner(sf::Vector2i const& corner) const;
+
+        void setSeed(unsigned int seed);
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+
+        // Needed after the terrains or the probabilities of the tileset changed
+        void rebuild();
+
+    private:
+        // Tiles sharing a signature, with their alias table
+        struct Choice
+        {
+            std::size_t first;
+            std::size_t count;
+        };
+
+        static unsigned int getSignature(int topLeft, int topRight, int bottomLeft, int bottomRight);
+        unsigned int getCellSignature(sf::Vector2i const& coords) const;
+        unsigned int getTileSignature(unsigned int gid) const;
+        const Choice* findChoice(unsigned int signature);
+        unsigned int pick(Choice const& choice);
+        void setCornerValue(sf::Vector2i const& corner, int terrain);
+        void readTile(sf::Vector2i const& coords, unsigned int gid);
+        // Appends the cell and its new tile when it must change
+        void resolve(sf::Vector2i const& coords, std::vector<sf::Vector2i>& cells, std::vector<unsigned int>& gids);
+        void setTiles(std::vector<sf::Vector2i> const& cells, std::vector<unsigned int> const& gids);
+        bool ensureSize();
+
+    private:
+        Layer& mLayer;
+        Tileset& mTileset;
+        std::mt19937 mRandom;
+        bool mResolving;
+
+        sf::Vector2i mSize; // Corners, one more than the cells on each axis
+        std::vector<int> mCorners;
+
+        std::vector<unsigned int> mSignatures; // Local tile id to signature, 0 without terrain
+        std::unordered_map<unsigned int, Choice> mChoices; // Also caches the closest tiles of unknown signatures
+        std::vector<unsigned int> mGids;
+        std::vector<float> mProbabilities;
+        std::vector<std::size_t> mAliases;
+};
+
+} // namespace tmx
+
+#endif // TMX_AUTOTILER_HPP
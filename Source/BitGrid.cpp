@@ -0,0 +1,71 @@
+#include "BitGrid.hpp"
+
+#include <algorithm>
+
+namespace tmx
+{
+
+BitGrid::BitGrid()
+: mSize()
+, mStride(0)
+, mWords()
+{
+}
+
+BitGrid::BitGrid(sf::Vector2i const& size)
+: mSize()
+, mStride(0)
+, mWords()
+{
+    resize(size);
+}
+
+void BitGrid::resize(sf::Vector2i const& size)
+{
+    mSize.x = std::max(size.x, 0);
+    mSize.y = std::max(size.y, 0);
+    mStride = (static_cast<std::size_t>(mSize.x) + 63) / 64;
+    mWords.assign(mStride * mSize.y, 0);
+}
+
+const sf::Vector2i& BitGrid::getSize() const
+{
+    return mSize;
+}
+
+void BitGrid::clear()
+{
+    std::fill(mWords.begin(), mWords.end(), 0);
+}
+
+std::size_t BitGrid::count() const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < mWords.size(); i++)
+    {
+        sf::Uint64 word = mWords[i];
+        while (word != 0)
+        {
+            word &= word - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+std::size_t BitGrid::getStride() const
+{
+    return mStride;
+}
+
+const std::vector<sf::Uint64>& BitGrid::getWords() const
+{
+    return mWords;
+}
+
+std::vector<sf::Uint64>& BitGrid::getWords()
+{
+    return mWords;
+}
+
+} // namespace tmx
@@ -0,0 +1,69 @@
+#ifndef TMX_BITGRID_HPP
+#define TMX_BITGRID_HPP
+
+#include <vector>
+
+#include <SFML/Config.hpp>
+#include <SFML/System/Vector2.hpp>
+
+namespace tmx
+{
+
+// One bit per cell, rows padded to 64 bits words
+class BitGrid
+{
+    public:
+        BitGrid();
+        BitGrid(sf::Vector2i const& size);
+
+        // Resizing clears every bit, the storage is kept when it is large enough
+        void resize(sf::Vector2i const& size);
+        const sf::Vector2i& getSize() const;
+
+        void clear();
+        std::size_t count() const;
+
+        bool contains(sf::Vector2i const& coords) const;
+        bool test(sf::Vector2i const& coords) const;
+        void set(sf::Vector2i const& coords, bool value = true);
+
+        // Out of the grid coords are never set
+        bool testOr(sf::Vector2i const& coords, bool outside) const;
+
+        std::size_t getStride() const;
+        const std::vector<sf::Uint64>& getWords() const;
+
+        // Raw rows for bulk operations, the padding bits past the width must stay cleared
+        std::vector<sf::Uint64>& getWords();
+
+    private:
+        sf::Vector2i mSize;
+        std::size_t mStride;
+        std::vector<sf::Uint64> mWords;
+};
+
+inline bool BitGrid::contains(sf::Vector2i const& coords) const
+{
+    return 0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y;
+}
+
+inline bool BitGrid::test(sf::Vector2i const& coords) const
+{
+    return ((mWords[coords.y * mStride + (coords.x >> 6)] >> (coords.x & 63)) & 1) != 0;
+}
+
+inline void BitGrid::set(sf::Vector2i const& coords, bool value)
+{
+    sf::Uint64& word = mWords[coords.y * mStride + (coords.x >> 6)];
+    sf::Uint64 bit = sf::Uint64(1) << (coords.x & 63);
+    word = (value) ? (word | bit) : (word & ~bit);
+}
+
+inline bool BitGrid::testOr(sf::Vector2i const& coords, bool outside) const
+{
+    return (contains(coords)) ? test(coords) : outside;
+}
+
+} // namespace tmx
+
+#endif // TMX_BITGRID_HPP
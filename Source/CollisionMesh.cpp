@@ -0,0 +1,189 @@
+#include "CollisionMesh.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+namespace tmx
+{
+
+CollisionMesh::CollisionMesh(Layer& layer, TileSelector const& selector, unsigned int bandHeight)
+: mLayer(layer)
+, mSelector(selector)
+, mBandHeight((bandHeight > 0) ? bandHeight : 1)
+, mSize()
+, mBands()
+, mDirtyBands()
+, mRectangles()
+, mNeedsUpdate(true)
+{
+    mLayer.addListener(this);
+}
+
+CollisionMesh::~CollisionMesh()
+{
+    mLayer.removeListener(this);
+}
+
+const std::vector<sf::IntRect>& CollisionMesh::getRectangles() const
+{
+    ensureUpdated();
+    return mRectangles;
+}
+
+std::vector<sf::FloatRect> CollisionMesh::getWorldRectangles() const
+{
+    ensureUpdated();
+    sf::Vector2f tileSize = static_cast<sf::Vector2f>(mLayer.getMap().getTileSize());
+    sf::Vector2f offset = mLayer.getOffset() + mLayer.getMap().getMapOffset();
+    std::vector<sf::FloatRect> rectangles;
+    rectangles.reserve(mRectangles.size());
+    for (std::size_t i = 0; i < mRectangles.size(); i++)
+    {
+        const sf::IntRect& r = mRectangles[i];
+        rectangles.push_back(sf::FloatRect(offset.x + r.left * tileSize.x, offset.y + r.top * tileSize.y, r.width * tileSize.x, r.height * tileSize.y));
+    }
+    return rectangles;
+}
+
+const TileSelector& CollisionMesh::getSelector() const
+{
+    return mSelector;
+}
+
+void CollisionMesh::setSelector(TileSelector const& selector)
+{
+    mSelector = selector;
+    invalidate();
+}
+
+void CollisionMesh::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (mSelector(previous) != mSelector(gid))
+    {
+        std::size_t band = coords.y / mBandHeight;
+        if (band < mDirtyBands.size())
+        {
+            mDirtyBands[band] = 1;
+        }
+        mNeedsUpdate = true;
+    }
+}
+
+void CollisionMesh::invalidate()
+{
+    mSize = sf::Vector2i();
+    mNeedsUpdate = true;
+}
+
+void CollisionMesh::ensureUpdated() const
+{
+    sf::Vector2i size = mLayer.getMap().getMapSize();
+
+    // A layer not yet matching the map size has no mesh, it is built again once the layer is
+    if (size.x <= 0 || size.y <= 0 || mLayer.getTileIds().size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        mSize = sf::Vector2i();
+        mBands.clear();
+        mDirtyBands.clear();
+        mRectangles.clear();
+        mNeedsUpdate = true;
+        return;
+    }
+    if (size != mSize)
+    {
+        mSize = size;
+        std::size_t bands = (size.y > 0) ? (size.y + mBandHeight - 1) / mBandHeight : 0;
+        mBands.assign(bands, std::vector<sf::IntRect>());
+        mDirtyBands.assign(bands, 1);
+        mNeedsUpdate = true;
+    }
+    if (!mNeedsUpdate)
+    {
+        return;
+    }
+
+    std::vector<std::size_t> dirty;
+    for (std::size_t i = 0; i < mDirtyBands.size(); i++)
+    {
+        if (mDirtyBands[i] != 0)
+        {
+            dirty.push_back(i);
+        }
+    }
+    detail::ThreadPool::getDefault().parallelFor(dirty.size(), [this, &dirty](std::size_t begin, std::size_t end)
+    {
+        std::vector<unsigned char> used;
+        for (std::size_t i = begin; i < end; i++)
+        {
+            meshBand(dirty[i], used);
+        }
+    }, 1);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < mBands.size(); i++)
+    {
+        count += mBands[i].size();
+    }
+    mRectangles.clear();
+    mRectangles.reserve(count);
+    for (std::size_t i = 0; i < mBands.size(); i++)
+    {
+        mRectangles.insert(mRectangles.end(), mBands[i].begin(), mBands[i].end());
+    }
+    std::fill(mDirtyBands.begin(), mDirtyBands.end(), 0);
+    mNeedsUpdate = false;
+}
+
+void CollisionMesh::meshBand(std::size_t band, std::vector<unsigned char>& used) const
+{
+    const std::vector<unsigned int>& tiles = mLayer.getTileIds();
+    const int width = mSize.x;
+    const int top = static_cast<int>(band * mBandHeight);
+    const int bottom = std::min(mSize.y, top + static_cast<int>(mBandHeight));
+    std::vector<sf::IntRect>& rectangles = mBands[band];
+    rectangles.clear();
+
+    used.assign(static_cast<std::size_t>(width) * (bottom - top), 0);
+    for (int y = top; y < bottom; y++)
+    {
+        const unsigned int* row = &tiles[y * width];
+        unsigned char* usedRow = &used[(y - top) * width];
+        for (int x = 0; x < width; x++)
+        {
+            if (usedRow[x] != 0 || !mSelector(row[x]))
+            {
+                continue;
+            }
+
+            // Widest run on this row, then as many rows below as the whole run fits in
+            int w = 1;
+            while (x + w < width && usedRow[x + w] == 0 && mSelector(row[x + w]))
+            {
+                w++;
+            }
+            int h = 1;
+            while (y + h < bottom)
+            {
+                const unsigned int* next = &tiles[(y + h) * width];
+                const unsigned char* usedNext = &used[(y + h - top) * width];
+                int i = 0;
+                while (i < w && usedNext[x + i] == 0 && mSelector(next[x + i]))
+                {
+                    i++;
+                }
+                if (i < w)
+                {
+                    break;
+                }
+                h++;
+            }
+            for (int j = 0; j < h; j++)
+            {
+                std::fill_n(&used[(y + j - top) * width + x], w, 1);
+            }
+            rectangles.push_back(sf::IntRect(x, y, w, h));
+            x += w - 1;
+        }
+    }
+}
+
+} // namespace tmx
@@ -0,0 +1,50 @@
+#ifndef TMX_COLLISIONMESH_HPP
+#define TMX_COLLISIONMESH_HPP
+
+#include "Layer.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+// Merges the selected cells of a layer into rectangles (greedy meshing)
+// The layer is split in bands of rows meshed in parallel, a tile change only remeshes its band
+// The mesh listens to its layer and must not outlive it
+class CollisionMesh : public Layer::Listener
+{
+    public:
+        CollisionMesh(Layer& layer, TileSelector const& selector, unsigned int bandHeight = 32);
+        ~CollisionMesh();
+
+        // Rectangles in cells
+        const std::vector<sf::IntRect>& getRectangles() const;
+
+        // Rectangles in pixels, for orthogonal maps
+        std::vector<sf::FloatRect> getWorldRectangles() const;
+
+        const TileSelector& getSelector() const;
+        void setSelector(TileSelector const& selector);
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+
+        void invalidate();
+
+    private:
+        void ensureUpdated() const;
+        void meshBand(std::size_t band, std::vector<unsigned char>& used) const;
+
+    private:
+        Layer& mLayer;
+        TileSelector mSelector;
+        unsigned int mBandHeight;
+
+        mutable sf::Vector2i mSize;
+        mutable std::vector<std::vector<sf::IntRect>> mBands;
+        mutable std::vector<unsigned char> mDirtyBands;
+        mutable std::vector<sf::IntRect> mRectangles;
+        mutable bool mNeedsUpdate;
+};
+
+} // namespace tmx
+
+#endif // TMX_COLLISIONMESH_HPP
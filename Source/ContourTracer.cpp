@@ -0,0 +1,209 @@
+#include "ContourTracer.hpp"
+#include "Map.hpp"
+#include "ObjectGroup.hpp"
+#include "Polygon.h"
+#include "Polyline.h"
+
+namespace tmx
+{
+
+namespace
+{
+
+// Right, down, left, up : the next direction is a clockwise turn on screen
+const int DirectionX[4] = {1, 0, -1, 0};
+const int DirectionY[4] = {0, 1, 0, -1};
+
+} // namespace
+
+ContourTracer::ContourTracer(Layer& layer, TileSelector const& selector)
+: mLayer(layer)
+, mSelector(selector)
+{
+}
+
+std::vector<std::vector<sf::Vector2i>> ContourTracer::trace() const
+{
+    std::vector<std::vector<sf::Vector2i>> contours;
+    const sf::Vector2i size = mLayer.getMap().getMapSize();
+    const std::vector<unsigned int>& tiles = mLayer.getTileIds();
+    if (size.x <= 0 || size.y <= 0 || tiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        return contours;
+    }
+
+    // Boundary edges on the corners grid, each selected cell is walked clockwise
+    const int stride = size.x + 1;
+    std::vector<unsigned char> edges(static_cast<std::size_t>(stride) * (size.y + 1), 0);
+    auto solid = [&](int x, int y) -> bool
+    {
+        return 0 <= x && x < size.x && 0 <= y && y < size.y && mSelector(tiles[x + y * size.x]);
+    };
+    for (int y = 0; y < size.y; y++)
+    {
+        for (int x = 0; x < size.x; x++)
+        {
+            if (!solid(x, y))
+            {
+                continue;
+            }
+            if (!solid(x, y - 1))
+            {
+                edges[x + y * stride] |= 1 << 0;
+            }
+            if (!solid(x + 1, y))
+            {
+                edges[(x + 1) + y * stride] |= 1 << 1;
+            }
+            if (!solid(x, y + 1))
+            {
+                edges[(x + 1) + (y + 1) * stride] |= 1 << 2;
+            }
+            if (!solid(x - 1, y))
+            {
+                edges[x + (y + 1) * stride] |= 1 << 3;
+            }
+        }
+    }
+
+    for (std::size_t start = 0; start < edges.size(); start++)
+    {
+        while (edges[start] != 0)
+        {
+            int startDirection = 0;
+            while ((edges[start] & (1 << startDirection)) == 0)
+            {
+                startDirection++;
+            }
+
+            std::vector<sf::Vector2i> contour;
+            std::size_t vertex = start;
+            int direction = startDirection;
+            while (true)
+            {
+                edges[vertex] &= ~(1 << direction);
+                vertex += DirectionX[direction] + DirectionY[direction] * stride;
+
+                // Tightest clockwise turn first, it keeps the walk around the same area on saddles
+                unsigned char available = edges[vertex];
+                if (vertex == start)
+                {
+                    available |= 1 << startDirection;
+                }
+                int next = -1;
+                for (int turn : {1, 0, 3})
+                {
+                    int candidate = (direction + turn) % 4;
+                    if ((available & (1 << candidate)) != 0)
+                    {
+                        next = candidate;
+                        break;
+                    }
+                }
+                if (next < 0 || (vertex == start && next == startDirection))
+                {
+                    if (direction != startDirection)
+                    {
+                        contour.push_back(sf::Vector2i(start % stride, start / stride));
+                    }
+                    break;
+                }
+                if (next != direction)
+                {
+                    contour.push_back(sf::Vector2i(vertex % stride, vertex / stride));
+                }
+                direction = next;
+            }
+            if (contour.size() >= 3)
+            {
+                contours.push_back(std::move(contour));
+            }
+        }
+    }
+    return contours;
+}
+
+std::vector<std::vector<sf::Vector2f>> ContourTracer::traceWorld() const
+{
+    std::vector<std::vector<sf::Vector2f>> contours;
+    const std::string& orientation = mLayer.getMap().getOrientation();
+    if (orientation != "orthogonal" && orientation != "isometric")
+    {
+        detail::log("Contours can only be converted to pixels on orthogonal and isometric maps");
+        return contours;
+    }
+    std::vector<std::vector<sf::Vector2i>> corners = trace();
+    contours.resize(corners.size());
+    for (std::size_t i = 0; i < corners.size(); i++)
+    {
+        contours[i].reserve(corners[i].size());
+        for (std::size_t j = 0; j < corners[i].size(); j++)
+        {
+            contours[i].push_back(cornerToWorld(corners[i][j]));
+        }
+    }
+    return contours;
+}
+
+std::size_t ContourTracer::createPolygons(ObjectGroup& group) const
+{
+    std::vector<std::vector<sf::Vector2f>> contours = traceWorld();
+    sf::Vector2f offset = group.getOffset();
+    for (std::size_t i = 0; i < contours.size(); i++)
+    {
+        Polygon* polygon = group.createObject<Polygon>(group.getMap().getNextObjectId());
+        if (polygon == nullptr)
+        {
+            return i;
+        }
+        sf::Vector2f origin = contours[i].front();
+        polygon->setPosition(origin - offset);
+        for (std::size_t j = 0; j < contours[i].size(); j++)
+        {
+            polygon->addPoint(contours[i][j] - origin);
+        }
+    }
+    return contours.size();
+}
+
+std::size_t ContourTracer::createPolylines(ObjectGroup& group) const
+{
+    std::vector<std::vector<sf::Vector2f>> contours = traceWorld();
+    sf::Vector2f offset = group.getOffset();
+    for (std::size_t i = 0; i < contours.size(); i++)
+    {
+        Polyline* polyline = group.createObject<Polyline>(group.getMap().getNextObjectId());
+        if (polyline == nullptr)
+        {
+            return i;
+        }
+        sf::Vector2f origin = contours[i].front();
+        polyline->setPosition(origin - offset);
+        for (std::size_t j = 0; j < contours[i].size(); j++)
+        {
+            polyline->addPoint(contours[i][j] - origin);
+        }
+        polyline->addPoint(sf::Vector2f());
+    }
+    return contours.size();
+}
+
+sf::Vector2f ContourTracer::cornerToWorld(sf::Vector2i const& corner) const
+{
+    sf::Vector2f tileSize = static_cast<sf::Vector2f>(mLayer.getMap().getTileSize());
+    sf::Vector2f world;
+    if (mLayer.getMap().getOrientation() == "isometric")
+    {
+        // Cell (0,0) has its top corner in the middle of its quad
+        world.x = (corner.x - corner.y + 1) * tileSize.x * 0.5f;
+        world.y = (corner.x + corner.y) * tileSize.y * 0.5f;
+    }
+    else
+    {
+        world.x = corner.x * tileSize.x;
+        world.y = corner.y * tileSize.y;
+    }
+    return world + mLayer.getOffset();
+}
+
+} // namespace tmx
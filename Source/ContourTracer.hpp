@@ -0,0 +1,39 @@
+#ifndef TMX_CONTOURTRACER_HPP
+#define TMX_CONTOURTRACER_HPP
+
+#include "Layer.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+class ObjectGroup;
+
+// Traces the outlines of the selected cells of a layer, collinear points are removed
+// Outlines run clockwise on screen around solid areas and counter clockwise around holes
+// Diagonal neighbours are separate areas
+class ContourTracer
+{
+    public:
+        ContourTracer(Layer& layer, TileSelector const& selector);
+
+        // Closed outlines on the cell corners grid
+        std::vector<std::vector<sf::Vector2i>> trace() const;
+
+        // Closed outlines in pixels, for orthogonal and isometric maps
+        std::vector<std::vector<sf::Vector2f>> traceWorld() const;
+
+        // One object per outline, polylines are closed by repeating their first point
+        std::size_t createPolygons(ObjectGroup& group) const;
+        std::size_t createPolylines(ObjectGroup& group) const;
+
+        sf::Vector2f cornerToWorld(sf::Vector2i const& corner) const;
+
+    private:
+        Layer& mLayer;
+        TileSelector mSelector;
+};
+
+} // namespace tmx
+
+#endif // TMX_CONTOURTRACER_HPP
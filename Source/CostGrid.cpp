@@ -0,0 +1,193 @@
+#include "CostGrid.hpp"
+#include "Map.hpp"
+
+namespace tmx
+{
+
+CostGrid::CostGrid(Map& map)
+: mMap(map)
+, mLayers()
+, mGidCosts()
+, mCells()
+, mSize()
+, mWeighted(0)
+, mListeners()
+{
+}
+
+CostGrid::~CostGrid()
+{
+    for (std::size_t i = 0; i < mLayers.size(); i++)
+    {
+        mLayers[i]->removeListener(this);
+    }
+}
+
+void CostGrid::setCost(unsigned int gid, unsigned char cost)
+{
+    if (gid == 0)
+    {
+        return;
+    }
+    if (gid >= mGidCosts.size())
+    {
+        mGidCosts.resize(gid + 1, 1);
+    }
+    mGidCosts[gid] = cost;
+}
+
+void CostGrid::setCosts(std::string const& property)
+{
+    for (std::size_t i = 0; i < mMap.getTilesetCount(); i++)
+    {
+        Tileset* tileset = mMap.getTilesetAt(i);
+        for (std::size_t j = 0; j < tileset->tiles(); j++)
+        {
+            Tileset::Tile& tile = tileset->getTile(j);
+            if (tile.hasProperty(property))
+            {
+                int cost = tile.getProperty<int>(property);
+                setCost(tileset->getFirstGid() + tile.getId(), static_cast<unsigned char>(std::max(0, std::min(cost, 255))));
+            }
+        }
+    }
+}
+
+void CostGrid::setBlocked(TileSelector const& selector)
+{
+    for (std::size_t i = 0; i < mMap.getTilesetCount(); i++)
+    {
+        Tileset* tileset = mMap.getTilesetAt(i);
+        for (unsigned int id = 0; id < tileset->getTileCount(); id++)
+        {
+            unsigned int gid = tileset->getFirstGid() + id;
+            if (selector(gid))
+            {
+                setCost(gid, 0);
+            }
+        }
+    }
+}
+
+void CostGrid::addLayer(Layer& layer)
+{
+    if (std::find(mLayers.begin(), mLayers.end(), &layer) == mLayers.end())
+    {
+        mLayers.push_back(&layer);
+        layer.addListener(this);
+    }
+}
+
+void CostGrid::removeLayer(Layer& layer)
+{
+    auto found = std::find(mLayers.begin(), mLayers.end(), &layer);
+    if (found != mLayers.end())
+    {
+        mLayers.erase(found);
+        layer.removeListener(this);
+    }
+}
+
+void CostGrid::rebuild()
+{
+    mSize = mMap.getMapSize();
+    mCells.assign(static_cast<std::size_t>(std::max(0, mSize.x * mSize.y)), 1);
+    mWeighted = 0;
+    for (std::size_t i = 0; i < mCells.size(); i++)
+    {
+        mCells[i] = computeCost(i);
+        if (mCells[i] > 1)
+        {
+            mWeighted++;
+        }
+    }
+}
+
+bool CostGrid::isUniform() const
+{
+    return mWeighted == 0;
+}
+
+const sf::Vector2i& CostGrid::getSize() const
+{
+    return mSize;
+}
+
+const std::vector<unsigned char>& CostGrid::getCosts() const
+{
+    return mCells;
+}
+
+Map& CostGrid::getMap() const
+{
+    return mMap;
+}
+
+CostGrid::Listener::~Listener()
+{
+}
+
+void CostGrid::addListener(Listener* listener)
+{
+    if (listener != nullptr && std::find(mListeners.begin(), mListeners.end(), listener) == mListeners.end())
+    {
+        mListeners.push_back(listener);
+    }
+}
+
+void CostGrid::removeListener(Listener* listener)
+{
+    mListeners.erase(std::remove(mListeners.begin(), mListeners.end(), listener), mListeners.end());
+}
+
+void CostGrid::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (!contains(coords) || getGidCost(previous) == getGidCost(gid))
+    {
+        return;
+    }
+    std::size_t cell = coords.x + coords.y * mSize.x;
+    unsigned char before = mCells[cell];
+    setCell(cell, computeCost(cell));
+    if (mCells[cell] != before)
+    {
+        for (std::size_t i = 0; i < mListeners.size(); i++)
+        {
+            mListeners[i]->onCostChanged(*this, coords, before, mCells[cell]);
+        }
+    }
+}
+
+unsigned char CostGrid::computeCost(std::size_t cell) const
+{
+    unsigned char cost = 1;
+    for (std::size_t i = 0; i < mLayers.size(); i++)
+    {
+        const std::vector<unsigned int>& tiles = mLayers[i]->getTileIds();
+        if (cell < tiles.size())
+        {
+            unsigned char c = getGidCost(tiles[cell]);
+            if (c == 0)
+            {
+                return 0;
+            }
+            cost = std::max(cost, c);
+        }
+    }
+    return cost;
+}
+
+void CostGrid::setCell(std::size_t cell, unsigned char cost)
+{
+    if (mCells[cell] > 1)
+    {
+        mWeighted--;
+    }
+    mCells[cell] = cost;
+    if (cost > 1)
+    {
+        mWeighted++;
+    }
+}
+
+} // namespace tmx
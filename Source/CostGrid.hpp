@@ -0,0 +1,91 @@
+#ifndef TMX_COSTGRID_HPP
+#define TMX_COSTGRID_HPP
+
+#include "Layer.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+class Map;
+
+// Movement cost of every cell, combined from the gids of one or more layers
+// A cost of 0 blocks the cell, any layer blocking wins and the highest cost is kept otherwise
+// Gids without cost and empty cells cost 1, the grid follows the tile changes of its layers
+// rebuild() fills the grid once the layers and the costs are set
+class CostGrid : public Layer::Listener
+{
+    public:
+        CostGrid(Map& map);
+        ~CostGrid();
+
+        void setCost(unsigned int gid, unsigned char cost);
+        void setCosts(std::string const& property);
+        void setBlocked(TileSelector const& selector);
+        unsigned char getGidCost(unsigned int gid) const;
+
+        void addLayer(Layer& layer);
+        void removeLayer(Layer& layer);
+        void rebuild();
+
+        unsigned char getCost(sf::Vector2i const& coords) const;
+        bool isWalkable(sf::Vector2i const& coords) const;
+        bool contains(sf::Vector2i const& coords) const;
+
+        // True when every walkable cell costs 1
+        bool isUniform() const;
+
+        const sf::Vector2i& getSize() const;
+        const std::vector<unsigned char>& getCosts() const;
+        Map& getMap() const;
+
+        class Listener
+        {
+            public:
+                virtual ~Listener();
+
+                virtual void onCostChanged(CostGrid& grid, sf::Vector2i const& coords, unsigned char previous, unsigned char cost) = 0;
+        };
+
+        void addListener(Listener* listener);
+        void removeListener(Listener* listener);
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+
+    private:
+        unsigned char computeCost(std::size_t cell) const;
+        void setCell(std::size_t cell, unsigned char cost);
+
+    private:
+        Map& mMap;
+        std::vector<Layer*> mLayers;
+        std::vector<unsigned char> mGidCosts;
+        std::vector<unsigned char> mCells;
+        sf::Vector2i mSize;
+        std::size_t mWeighted;
+        std::vector<Listener*> mListeners;
+};
+
+inline unsigned char CostGrid::getGidCost(unsigned int gid) const
+{
+    return (gid < mGidCosts.size()) ? mGidCosts[gid] : 1;
+}
+
+inline bool CostGrid::contains(sf::Vector2i const& coords) const
+{
+    return 0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y;
+}
+
+inline unsigned char CostGrid::getCost(sf::Vector2i const& coords) const
+{
+    return contains(coords) ? mCells[coords.x + coords.y * mSize.x] : 0;
+}
+
+inline bool CostGrid::isWalkable(sf::Vector2i const& coords) const
+{
+    return getCost(coords) != 0;
+}
+
+} // namespace tmx
+
+#endif // TMX_COSTGRID_HPP
@@ -0,0 +1,256 @@
+#include "DistanceField.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace tmx
+{
+
+namespace
+{
+
+const float Infinity = std::numeric_limits<float>::infinity();
+
+long long floorDiv(long long a, long long b)
+{
+    long long q = a / b;
+    return (q * b != a && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Lower envelope functions of Meijster et al., f is the distance from x to the column i, sep the first x where u beats i
+struct Envelope
+{
+    DistanceField::Metric metric;
+    const int* g;
+    long long infinity;
+
+    long long f(long long x, long long i) const
+    {
+        long long dx = std::abs(x - i);
+        switch (metric)
+        {
+            case DistanceField::EEuclidean: return dx * dx + static_cast<long long>(g[i]) * g[i];
+            case DistanceField::EChessboard: return std::max<long long>(dx, g[i]);
+            default: return dx + g[i];
+        }
+    }
+
+    long long sep(long long i, long long u) const
+    {
+        long long gi = g[i];
+        long long gu = g[u];
+        switch (metric)
+        {
+            case DistanceField::EEuclidean:
+                return floorDiv(u * u - i * i + gu * gu - gi * gi, 2 * (u - i));
+            case DistanceField::EChessboard:
+                return (gi <= gu) ? std::max(i + gu, floorDiv(i + u, 2)) : std::min(u - gi, floorDiv(i + u, 2));
+            default:
+                if (gu >= gi + u - i)
+                {
+                    return infinity;
+                }
+                if (gi > gu + u - i)
+                {
+                    return -infinity;
+                }
+                return floorDiv(gu - gi + u + i, 2);
+        }
+    }
+};
+
+} // namespace
+
+DistanceField::DistanceField()
+: mSize()
+, mDistances()
+, mColumns()
+, mQueue()
+, mMask()
+{
+}
+
+void DistanceField::compute(BitGrid const& sources, Metric metric)
+{
+    if (metric == ESteps)
+    {
+        computeSteps(sources, MapGeometry());
+        return;
+    }
+    mSize = sources.getSize();
+    const std::size_t width = static_cast<std::size_t>(mSize.x);
+    const int far = mSize.x + mSize.y + 1;
+    mColumns.resize(width * mSize.y);
+    mDistances.resize(width * mSize.y);
+    if (mDistances.empty())
+    {
+        return;
+    }
+
+    // Distance to the nearest source of the same column, chunks of columns sweep down then up
+    detail::ThreadPool::getDefault().parallelFor(width, [&](std::size_t begin, std::size_t end)
+    {
+        for (int y = 0; y < mSize.y; y++)
+        {
+            int* row = &mColumns[y * width];
+            const int* above = (y > 0) ? &mColumns[(y - 1) * width] : nullptr;
+            for (std::size_t x = begin; x < end; x++)
+            {
+                if (sources.test(sf::Vector2i(static_cast<int>(x), y)))
+                {
+                    row[x] = 0;
+                }
+                else
+                {
+                    row[x] = (above != nullptr) ? std::min(above[x] + 1, far) : far;
+                }
+            }
+        }
+        for (int y = mSize.y - 2; y >= 0; y--)
+        {
+            int* row = &mColumns[y * width];
+            const int* below = &mColumns[(y + 1) * width];
+            for (std::size_t x = begin; x < end; x++)
+            {
+                row[x] = std::min(row[x], below[x] + 1);
+            }
+        }
+    }, 64);
+
+    // Lower envelope of the columns along each row
+    detail::ThreadPool::getDefault().parallelFor(static_cast<std::size_t>(mSize.y), [&](std::size_t begin, std::size_t end)
+    {
+        std::vector<int> s(width);
+        std::vector<int> t(width);
+        for (std::size_t y = begin; y < end; y++)
+        {
+            transformRow(y, metric, s, t);
+        }
+    });
+}
+
+void DistanceField::computeSteps(BitGrid const& sources, MapGeometry const& geometry, bool corners, BitGrid const* blocked)
+{
+    mSize = sources.getSize();
+    const std::size_t width = static_cast<std::size_t>(mSize.x);
+    mDistances.assign(width * mSize.y, Infinity);
+    mQueue.clear();
+    for (int y = 0; y < mSize.y; y++)
+    {
+        for (int x = 0; x < mSize.x; x++)
+        {
+            if (sources.test(sf::Vector2i(x, y)))
+            {
+                mDistances[x + y * width] = 0.f;
+                mQueue.push_back(x + y * mSize.x);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < mQueue.size(); i++)
+    {
+        int cell = mQueue[i];
+        sf::Vector2i coords(cell % mSize.x, cell / mSize.x);
+        float next = mDistances[cell] + 1.f;
+        Span<sf::Vector2i> offsets = geometry.getNeighbourOffsets(coords, corners);
+        for (std::size_t k = 0; k < offsets.size(); k++)
+        {
+            sf::Vector2i n = coords + offsets[k];
+            if (sources.contains(n) && mDistances[n.x + n.y * width] == Infinity && (blocked == nullptr || !blocked->test(n)))
+            {
+                mDistances[n.x + n.y * width] = next;
+                mQueue.push_back(n.x + n.y * mSize.x);
+            }
+        }
+    }
+}
+
+void DistanceField::compute(Layer const& layer, TileSelector const& sources, Metric metric)
+{
+    sources.selectCells(layer, mMask);
+    if (metric == ESteps)
+    {
+        computeSteps(mMask, layer.getMap().getGeometry());
+    }
+    else
+    {
+        compute(mMask, metric);
+    }
+}
+
+const sf::Vector2i& DistanceField::getSize() const
+{
+    return mSize;
+}
+
+float DistanceField::getDistance(sf::Vector2i const& coords) const
+{
+    if (0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y)
+    {
+        return mDistances[coords.x + coords.y * mSize.x];
+    }
+    return Infinity;
+}
+
+const std::vector<float>& DistanceField::getDistances() const
+{
+    return mDistances;
+}
+
+void DistanceField::transformRow(std::size_t y, Metric metric, std::vector<int>& s, std::vector<int>& t)
+{
+    const int width = mSize.x;
+    const long long far = mSize.x + mSize.y + 1;
+    Envelope envelope;
+    envelope.metric = metric;
+    envelope.g = &mColumns[y * width];
+    envelope.infinity = std::numeric_limits<long long>::max() / 4;
+
+    int q = 0;
+    s[0] = 0;
+    t[0] = 0;
+    for (int u = 1; u < width; u++)
+    {
+        while (q >= 0 && envelope.f(t[q], s[q]) > envelope.f(t[q], u))
+        {
+            q--;
+        }
+        if (q < 0)
+        {
+            q = 0;
+            s[0] = u;
+        }
+        else
+        {
+            long long w = 1 + envelope.sep(s[q], u);
+            if (w < width)
+            {
+                q++;
+                s[q] = u;
+                t[q] = static_cast<int>(std::max(w, 0LL));
+            }
+        }
+    }
+
+    float* row = &mDistances[y * width];
+    const long long unreachable = (metric == EEuclidean) ? far * far : far;
+    for (int u = width - 1; u >= 0; u--)
+    {
+        long long d = envelope.f(u, s[q]);
+        if (d >= unreachable)
+        {
+            row[u] = Infinity;
+        }
+        else
+        {
+            row[u] = (metric == EEuclidean) ? std::sqrt(static_cast<float>(d)) : static_cast<float>(d);
+        }
+        if (u == t[q])
+        {
+            q--;
+        }
+    }
+}
+
+} // namespace tmx
@@ -0,0 +1,53 @@
+#ifndef TMX_DISTANCEFIELD_HPP
+#define TMX_DISTANCEFIELD_HPP
+
+#include "BitGrid.hpp"
+#include "Layer.hpp"
+#include "MapGeometry.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+// Distance of every cell to the nearest source cell, infinity when there is no source
+// The buffers are kept between computations
+class DistanceField
+{
+    public:
+        enum Metric
+        {
+            EManhattan,
+            EChessboard,
+            EEuclidean,
+            ESteps
+        };
+
+        DistanceField();
+
+        // Exact distances on the cell grid, computed in parallel by columns then by rows (ESteps uses orthogonal neighbours)
+        void compute(BitGrid const& sources, Metric metric = EEuclidean);
+
+        // Breadth first search from every source at once through the neighbours of the geometry, never entering blocked cells
+        void computeSteps(BitGrid const& sources, MapGeometry const& geometry, bool corners = false, BitGrid const* blocked = nullptr);
+
+        // Sources taken from a layer, steps follow the geometry of its map
+        void compute(Layer const& layer, TileSelector const& sources, Metric metric = EEuclidean);
+
+        const sf::Vector2i& getSize() const;
+        float getDistance(sf::Vector2i const& coords) const;
+        const std::vector<float>& getDistances() const;
+
+    private:
+        void transformRow(std::size_t y, Metric metric, std::vector<int>& s, std::vector<int>& t);
+
+    private:
+        sf::Vector2i mSize;
+        std::vector<float> mDistances;
+        std::vector<int> mColumns;
+        std::vector<int> mQueue;
+        BitGrid mMask;
+};
+
+} // namespace tmx
+
+#endif // TMX_DISTANCEFIELD_HPP
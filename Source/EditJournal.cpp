@@ -0,0 +1,395 @@
+#include "EditJournal.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace tmx
+{
+
+EditJournal::EditJournal(std::size_t capacity, std::size_t memoryBudget)
+: mRing(std::max(capacity, std::size_t(1)))
+, mFirst(0)
+, mCount(0)
+, mCursor(0)
+, mMemory(0)
+, mMemoryBudget(memoryBudget)
+, mDepth(0)
+, mReplaying(false)
+, mPendingTiles()
+, mPendingObjects()
+, mLayers()
+, mGroups()
+{
+}
+
+EditJournal::~EditJournal()
+{
+    unwatch();
+}
+
+void EditJournal::watch(Map& map)
+{
+    for (std::size_t i = 0; i < map.getLayerCount(); i++)
+    {
+        if (map.getLayerType(i) == ELayer)
+        {
+            watch(*map.getLayer<Layer>(i));
+        }
+        else if (map.getLayerType(i) == EObjectGroup)
+        {
+            watch(*map.getLayer<ObjectGroup>(i));
+        }
+    }
+}
+
+void EditJournal::watch(Layer& layer)
+{
+    if (std::find(mLayers.begin(), mLayers.end(), &layer) == mLayers.end())
+    {
+        layer.addListener(this);
+        mLayers.push_back(&layer);
+    }
+}
+
+void EditJournal::watch(ObjectGroup& group)
+{
+    if (std::find(mGroups.begin(), mGroups.end(), &group) == mGroups.end())
+    {
+        group.addListener(this);
+        mGroups.push_back(&group);
+    }
+}
+
+void EditJournal::unwatch()
+{
+    for (std::size_t i = 0; i < mLayers.size(); i++)
+    {
+        mLayers[i]->removeListener(this);
+    }
+    for (std::size_t i = 0; i < mGroups.size(); i++)
+    {
+        mGroups[i]->removeListener(this);
+    }
+    mLayers.clear();
+    mGroups.clear();
+}
+
+void EditJournal::beginStroke()
+{
+    mDepth++;
+}
+
+void EditJournal::endStroke()
+{
+    if (mDepth > 0 && --mDepth == 0)
+    {
+        commit();
+    }
+}
+
+bool EditJournal::canUndo() const
+{
+    return mDepth == 0 && mCursor > 0;
+}
+
+bool EditJournal::canRedo() const
+{
+    return mDepth == 0 && mCursor < mCount;
+}
+
+bool EditJournal::undo()
+{
+    if (!canUndo())
+    {
+        return false;
+    }
+    mCursor--;
+    replay(at(mCursor), false);
+    return true;
+}
+
+bool EditJournal::redo()
+{
+    if (!canRedo())
+    {
+        return false;
+    }
+    replay(at(mCursor), true);
+    mCursor++;
+    return true;
+}
+
+std::size_t EditJournal::getEntryCount() const
+{
+    return mCount;
+}
+
+std::size_t EditJournal::getMemoryUsage() const
+{
+    return mMemory;
+}
+
+std::size_t EditJournal::getCapacity() const
+{
+    return mRing.size();
+}
+
+std::size_t EditJournal::getMemoryBudget() const
+{
+    return mMemoryBudget;
+}
+
+void EditJournal::setCapacity(std::size_t capacity)
+{
+    capacity = std::max(capacity, std::size_t(1));
+
+    // The newest entries are kept, in order from the start of the new ring
+    std::size_t dropped = (mCount > capacity) ? mCount - capacity : 0;
+    std::vector<Entry> ring(capacity);
+    for (std::size_t i = dropped; i < mCount; i++)
+    {
+        std::swap(ring[i - dropped], at(i));
+    }
+    for (std::size_t i = 0; i < dropped; i++)
+    {
+        mMemory -= at(i).memory;
+    }
+    mRing.swap(ring);
+    mFirst = 0;
+    mCount -= dropped;
+    mCursor = (mCursor > dropped) ? mCursor - dropped : 0;
+}
+
+void EditJournal::setMemoryBudget(std::size_t memoryBudget)
+{
+    mMemoryBudget = memoryBudget;
+    trim();
+}
+
+void EditJournal::clear()
+{
+    for (std::size_t i = 0; i < mRing.size(); i++)
+    {
+        mRing[i] = Entry();
+    }
+    mFirst = 0;
+    mCount = 0;
+    mCursor = 0;
+    mMemory = 0;
+    mPendingTiles.clear();
+    mPendingObjects.clear();
+}
+
+void EditJournal::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (mReplaying)
+    {
+        return;
+    }
+    PendingTile tile;
+    tile.layer = &layer;
+    tile.cell = coords.x + coords.y * layer.getMap().getMapSize().x;
+    tile.before = previous;
+    tile.after = gid;
+    mPendingTiles.push_back(tile);
+    if (mDepth == 0)
+    {
+        commit();
+    }
+}
+
+void EditJournal::onBatchBegin(Layer& layer)
+{
+    beginStroke();
+}
+
+void EditJournal::onBatchEnd(Layer& layer)
+{
+    endStroke();
+}
+
+void EditJournal::onObjectChanging(ObjectGroup& group, ObjectBase& object)
+{
+    if (mReplaying || object.getId() == 0)
+    {
+        return;
+    }
+    auto key = std::make_pair(&group, object.getId());
+    if (mPendingObjects.find(key) == mPendingObjects.end())
+    {
+        mPendingObjects[key] = ObjectGroup::saveObject(object);
+    }
+}
+
+void EditJournal::onObjectChanged(ObjectGroup& group, unsigned int id)
+{
+    if (mReplaying || id == 0)
+    {
+        return;
+    }
+    // Without a previous state, the object was just created
+    mPendingObjects.insert(std::make_pair(std::make_pair(&group, id), std::string()));
+    if (mDepth == 0)
+    {
+        commit();
+    }
+}
+
+void EditJournal::commit()
+{
+    Entry entry;
+    entry.memory = sizeof(Entry);
+
+    // Bulk edits come in row major order, so the sort is mostly skipped
+    // A cell edited many times keeps its first before and its last after, the stable sort keeps them in order
+    auto less = [](PendingTile const& a, PendingTile const& b)
+    {
+        return std::less<Layer*>()(a.layer, b.layer) || (a.layer == b.layer && a.cell < b.cell);
+    };
+    if (!std::is_sorted(mPendingTiles.begin(), mPendingTiles.end(), less))
+    {
+        std::stable_sort(mPendingTiles.begin(), mPendingTiles.end(), less);
+    }
+
+    // Cells next to each other on a row share a run
+    for (std::size_t i = 0; i < mPendingTiles.size();)
+    {
+        PendingTile const& first = mPendingTiles[i];
+        unsigned int after = first.after;
+        for (i++; i < mPendingTiles.size() && mPendingTiles[i].layer == first.layer && mPendingTiles[i].cell == first.cell; i++)
+        {
+            after = mPendingTiles[i].after;
+        }
+        if (first.before == after)
+        {
+            continue;
+        }
+        Layer* layer = first.layer;
+        int width = layer->getMap().getMapSize().x;
+        sf::Vector2i coords(static_cast<int>(first.cell % width), static_cast<int>(first.cell / width));
+        if (entry.tiles.empty() || entry.tiles.back().layer != layer || entry.tiles.back().start.y != coords.y
+        || entry.tiles.back().start.x + static_cast<int>(entry.tiles.back().before.size()) != coords.x)
+        {
+            entry.tiles.push_back(TileRun());
+            entry.tiles.back().layer = layer;
+            entry.tiles.back().start = coords;
+            entry.memory += sizeof(TileRun);
+        }
+        entry.tiles.back().before.push_back(first.before);
+        entry.tiles.back().after.push_back(after);
+        entry.memory += 2 * sizeof(unsigned int);
+    }
+
+    for (auto itr = mPendingObjects.begin(); itr != mPendingObjects.end(); itr++)
+    {
+        ObjectEdit edit;
+        edit.group = itr->first.first;
+        edit.id = itr->first.second;
+        edit.before = itr->second;
+        ObjectBase* object = edit.group->getObjectById(edit.id);
+        if (object != nullptr)
+        {
+            edit.after = ObjectGroup::saveObject(*object);
+        }
+        if (edit.before != edit.after)
+        {
+            entry.memory += sizeof(ObjectEdit) + edit.before.size() + edit.after.size();
+            entry.objects.push_back(edit);
+        }
+    }
+
+    mPendingTiles.clear();
+    mPendingObjects.clear();
+    if (!entry.tiles.empty() || !entry.objects.empty())
+    {
+        push(entry);
+    }
+}
+
+void EditJournal::push(Entry& entry)
+{
+    // A new edit forgets the entries which could be redone
+    for (std::size_t i = mCursor; i < mCount; i++)
+    {
+        mMemory -= at(i).memory;
+        at(i) = Entry();
+    }
+    mCount = mCursor;
+    if (mCount == mRing.size())
+    {
+        mMemory -= at(0).memory;
+        at(0) = Entry();
+        mFirst = (mFirst + 1) % mRing.size();
+        mCount--;
+        mCursor--;
+    }
+    mMemory += entry.memory;
+    std::swap(at(mCount), entry);
+    mCount++;
+    mCursor++;
+    trim();
+}
+
+void EditJournal::replay(Entry const& entry, bool forward)
+{
+    mReplaying = true;
+    for (std::size_t i = 0; i < entry.tiles.size(); i++)
+    {
+        TileRun const& run = entry.tiles[i];
+        std::vector<unsigned int> const& gids = (forward) ? run.after : run.before;
+        run.layer->paste(run.start, sf::Vector2i(static_cast<int>(gids.size()), 1), gids);
+    }
+
+    // Every object leaves before any comes back, so an id can move from a group to another
+    for (std::size_t i = 0; i < entry.objects.size(); i++)
+    {
+        ObjectEdit const& edit = entry.objects[i];
+        if (!((forward) ? edit.before : edit.after).empty())
+        {
+            edit.group->removeObject(edit.id);
+        }
+    }
+    for (std::size_t i = 0; i < entry.objects.size(); i++)
+    {
+        ObjectEdit const& edit = entry.objects[i];
+        std::string const& state = (forward) ? edit.after : edit.before;
+        if (!state.empty())
+        {
+            pugi::xml_document doc;
+            if (doc.load_string(state.c_str()))
+            {
+                edit.group->loadObject(doc.first_child());
+            }
+        }
+    }
+    mReplaying = false;
+}
+
+void EditJournal::trim()
+{
+    // The oldest entries go first, then the newest ones which could only be redone
+    while (mMemory > mMemoryBudget && mCount > 1)
+    {
+        if (mCursor > 0)
+        {
+            mMemory -= at(0).memory;
+            at(0) = Entry();
+            mFirst = (mFirst + 1) % mRing.size();
+            mCount--;
+            mCursor--;
+        }
+        else
+        {
+            mMemory -= at(mCount - 1).memory;
+            at(mCount - 1) = Entry();
+            mCount--;
+        }
+    }
+}
+
+EditJournal::Entry& EditJournal::at(std::size_t index)
+{
+    return mRing[(mFirst + index) % mRing.size()];
+}
+
+} // namespace tmx
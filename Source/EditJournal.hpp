@@ -0,0 +1,115 @@
+#ifndef TMX_EDITJOURNAL_HPP
+#define TMX_EDITJOURNAL_HPP
+
+#include <map>
+
+#include "Layer.hpp"
+#include "ObjectGroup.hpp"
+
+namespace tmx
+{
+
+// Undo and redo of the tile and object edits of the watched layers, so their cost follows the size of the edits
+// Cells are kept as runs of before / after gids along the rows, objects as their xml node before and after
+// Edits between beginStroke() and endStroke() make one entry, a cell or an object edited many times keeps
+// its first and last states only, edits outside of a stroke make one entry each
+// The entries live in a ring buffer, the oldest ones are dropped past its capacity or its memory budget
+// The journal listens to the watched layers and must not outlive them
+class EditJournal : public Layer::Listener, public ObjectGroup::Listener
+{
+    public:
+        EditJournal(std::size_t capacity = 256, std::size_t memoryBudget = 8 * 1024 * 1024);
+        ~EditJournal();
+
+        // Every tile layer and object group of the map
+        void watch(Map& map);
+        void watch(Layer& layer);
+        void watch(ObjectGroup& group);
+        void unwatch();
+
+        // Strokes can be nested, the entry is made when the outermost one ends
+        void beginStroke();
+        void endStroke();
+
+        bool canUndo() const;
+        bool canRedo() const;
+        bool undo();
+        bool redo();
+
+        // Entries which can be undone and redone
+        std::size_t getEntryCount() const;
+        std::size_t getMemoryUsage() const;
+
+        std::size_t getCapacity() const;
+        std::size_t getMemoryBudget() const;
+        void setCapacity(std::size_t capacity);
+        void setMemoryBudget(std::size_t memoryBudget);
+
+        void clear();
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+        // A bulk edit of a layer is a stroke
+        void onBatchBegin(Layer& layer);
+        void onBatchEnd(Layer& layer);
+        void onObjectChanging(ObjectGroup& group, ObjectBase& object);
+        void onObjectChanged(ObjectGroup& group, unsigned int id);
+
+    private:
+        struct TileRun
+        {
+            Layer* layer;
+            sf::Vector2i start;
+            std::vector<unsigned int> before;
+            std::vector<unsigned int> after;
+        };
+
+        struct ObjectEdit
+        {
+            ObjectGroup* group;
+            unsigned int id;
+            std::string before; // Empty for a created object
+            std::string after; // Empty for a removed object
+        };
+
+        struct PendingTile
+        {
+            Layer* layer;
+            std::size_t cell;
+            unsigned int before;
+            unsigned int after;
+        };
+
+        struct Entry
+        {
+            std::vector<TileRun> tiles;
+            std::vector<ObjectEdit> objects;
+            std::size_t memory;
+        };
+
+        void commit();
+        void push(Entry& entry);
+        void replay(Entry const& entry, bool forward);
+        void trim();
+        Entry& at(std::size_t index);
+
+    private:
+        std::vector<Entry> mRing;
+        std::size_t mFirst;
+        std::size_t mCount;
+        std::size_t mCursor; // Entries before it can be undone, the others redone
+        std::size_t mMemory;
+        std::size_t mMemoryBudget;
+        unsigned int mDepth;
+        bool mReplaying;
+
+        // Edits of the current stroke in the order they came, sorted by layer then row major cell when committed
+        std::vector<PendingTile> mPendingTiles;
+        std::map<std::pair<ObjectGroup*, unsigned int>, std::string> mPendingObjects;
+
+        std::vector<Layer*> mLayers;
+        std::vector<ObjectGroup*> mGroups;
+};
+
+} // namespace tmx
+
+#endif // TMX_EDITJOURNAL_HPP
@@ -1,13 +1,14 @@
 #include "Ellipse.h"
 #include "ObjectGroup.hpp"
 
+#include <mutex>
+
 namespace tmx
 {
 
 Ellipse::Ellipse(ObjectGroup& group)
 : ObjectBase(group)
-, mShape()
-, mPointCount(50)
+, mPointCount(0)
 {
 }
 
@@ -20,23 +21,63 @@ void Ellipse::setPointCount(std::size_t count)
 {
     mPointCount = count;
     update();
-    mGroup.sort(mGroup.getDrawOrder());
 }
 
-void Ellipse::update()
+std::size_t Ellipse::getPointCount() const
+{
+    return (mPointCount != 0) ? mPointCount : computePointCount();
+}
+
+sf::Vector2f Ellipse::getCenter() const
+{
+    return getTransform().transformPoint(getSize() * 0.5f);
+}
+
+sf::Vector2f Ellipse::getRadius() const
+{
+    return getSize() * 0.5f;
+}
+
+bool Ellipse::contains(sf::Vector2f const& point) const
+{
+    sf::Vector2f radius = getRadius();
+    if (radius.x <= 0.f || radius.y <= 0.f)
+    {
+        return false;
+    }
+    sf::Vector2f local;
+    if (getRotation() == 0.f)
+    {
+        local = point - getPosition() - getLayerOffset() - getMapOffset();
+    }
+    else
+    {
+        local = getTransform().getInverse().transformPoint(point);
+    }
+    local -= radius;
+    float x = local.x / radius.x;
+    float y = local.y / radius.y;
+    return x * x + y * y <= 1.f;
+}
+
+const std::vector<sf::Vector2f>& Ellipse::getUnitCircle(std::size_t count)
 {
-    mShape.setPosition(mPosition + mSize * 0.5f + getLayerOffset() + getMapOffset());
-    mShape.setRotation(mRotation);
-    mShape.setPointCount(mPointCount);
-    mShape.setOutlineThickness(2.f);
-    const float pi = 3.141592654f;
-    for (std::size_t i = 0; i < mShape.getPointCount(); i++)
+    // Shared by all the ellipses, filled once per point count
+    static std::unordered_map<std::size_t, std::vector<sf::Vector2f>> circles;
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<sf::Vector2f>& circle = circles[count];
+    if (circle.size() != count)
     {
-        float angle = i * 2 * pi / mShape.getPointCount() - pi / 2;
-        float x = std::cos(angle) * mSize.x * 0.5f;
-        float y = std::sin(angle) * mSize.y * 0.5f;
-        mShape.setPoint(i, sf::Vector2f(x, y));
+        const double pi = 3.14159265358979323846;
+        circle.resize(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            double angle = i * 2 * pi / count - pi / 2;
+            circle[i] = sf::Vector2f(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+        }
     }
+    return circle;
 }
 
 void Ellipse::saveToNode(pugi::xml_node& object)
@@ -46,20 +87,53 @@ void Ellipse::saveToNode(pugi::xml_node& object)
     object.append_child("ellipse");
 }
 
-void Ellipse::setColor(sf::Color const& color)
+sf::FloatRect Ellipse::getLocalBounds() const
 {
-    sf::Color c = color;
-    c.a = 32;
-    mShape.setOutlineColor(color);
-    mShape.setFillColor(c);
+    return sf::FloatRect(sf::Vector2f(), getSize());
 }
 
-void Ellipse::draw(sf::RenderTarget& target, sf::RenderStates states) const
+void Ellipse::buildVertices(std::vector<sf::Vertex>& vertices) const
 {
-    if (mVisible)
+    const std::size_t count = getPointCount();
+    if (count < 3)
+    {
+        return;
+    }
+    const std::vector<sf::Vector2f>& circle = getUnitCircle(count);
+    sf::Vector2f radius = getRadius();
+    sf::Vector2f center = radius;
+    std::vector<sf::Vector2f> points(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        points[i] = sf::Vector2f(center.x + circle[i].x * radius.x, center.y + circle[i].y * radius.y);
+    }
+
+    sf::Color fill = mColor;
+    fill.a = 32;
+    vertices.reserve(count * 9);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        vertices.push_back(sf::Vertex(center, fill));
+        vertices.push_back(sf::Vertex(points[i], fill));
+        vertices.push_back(sf::Vertex(points[(i + 1) % count], fill));
+    }
+    appendOutline(vertices, points, true, mColor);
+}
+
+std::size_t Ellipse::computePointCount() const
+{
+    // Enough points to keep the chord error around half a pixel : n = pi * sqrt(r / (2 * error))
+    sf::Vector2f radius = getRadius();
+    float pixels = std::max(radius.x, radius.y) * mGroup.getPixelScale();
+    float count = 3.141592654f * std::sqrt(std::max(pixels, 0.f));
+
+    // Only power of two counts, so few unit circles are ever built
+    std::size_t result = 8;
+    while (result < count && result < 128)
     {
-        target.draw(mShape, states);
+        result *= 2;
     }
+    return result;
 }
 
 }
@@ -14,18 +14,24 @@ class Ellipse : public ObjectBase
 
         ObjectType getObjectType() const;
 
-        void setPointCount(std::size_t count);
+        void setPointCount(std::size_t count); // 0 adapts the count to the size on screen
+        std::size_t getPointCount() const;
 
-        void update();
+        sf::Vector2f getCenter() const;
+        sf::Vector2f getRadius() const;
+        bool contains(sf::Vector2f const& point) const;
+
+        static const std::vector<sf::Vector2f>& getUnitCircle(std::size_t count);
 
         void saveToNode(pugi::xml_node& object);
 
-        void setColor(sf::Color const& color);
+    protected:
+        sf::FloatRect getLocalBounds() const;
+        void buildVertices(std::vector<sf::Vertex>& vertices) const;
 
-        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
+        std::size_t computePointCount() const;
 
     private:
-        sf::ConvexShape mShape;
         std::size_t mPointCount;
 };
 
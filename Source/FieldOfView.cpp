@@ -0,0 +1,202 @@
+#include "FieldOfView.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdlib>
+
+namespace tmx
+{
+
+FieldOfView::Observer::Observer()
+: position()
+, radius(0)
+{
+}
+
+FieldOfView::Observer::Observer(sf::Vector2i const& position, int radius)
+: position(position)
+, radius(radius)
+{
+}
+
+FieldOfView::FieldOfView(Layer& layer, TileSelector const& opaque)
+: mLayer(layer)
+, mSelector(opaque)
+, mOpacity()
+{
+    mLayer.addListener(this);
+    rebuild();
+}
+
+FieldOfView::~FieldOfView()
+{
+    mLayer.removeListener(this);
+}
+
+const BitGrid& FieldOfView::getOpacity() const
+{
+    return mOpacity;
+}
+
+bool FieldOfView::isOpaque(sf::Vector2i const& coords) const
+{
+    return mOpacity.testOr(coords, true);
+}
+
+const TileSelector& FieldOfView::getSelector() const
+{
+    return mSelector;
+}
+
+void FieldOfView::setSelector(TileSelector const& opaque)
+{
+    mSelector = opaque;
+    rebuild();
+}
+
+void FieldOfView::compute(sf::Vector2i const& origin, int radius, BitGrid& visible) const
+{
+    const sf::Vector2i& size = mOpacity.getSize();
+    visible.resize(size);
+    if (!mOpacity.contains(origin))
+    {
+        return;
+    }
+    if (radius <= 0)
+    {
+        radius = size.x + size.y;
+    }
+    visible.set(origin);
+
+    // The eight octants, as transforms of the first one
+    static const int xx[8] = {1, 0, 0, -1, -1, 0, 0, 1};
+    static const int xy[8] = {0, 1, -1, 0, 0, -1, 1, 0};
+    static const int yx[8] = {0, 1, 1, 0, 0, -1, -1, 0};
+    static const int yy[8] = {1, 0, 0, 1, -1, 0, 0, -1};
+    for (int octant = 0; octant < 8; octant++)
+    {
+        castLight(origin, 1, 1.f, 0.f, radius, xx[octant], xy[octant], yx[octant], yy[octant], visible);
+    }
+}
+
+void FieldOfView::compute(Observer const& observer, BitGrid& visible) const
+{
+    compute(observer.position, observer.radius, visible);
+}
+
+void FieldOfView::compute(std::vector<Observer> const& observers, std::vector<BitGrid>& visible) const
+{
+    visible.resize(observers.size());
+    detail::ThreadPool::getDefault().parallelFor(observers.size(), [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            compute(observers[i], visible[i]);
+        }
+    }, 1);
+}
+
+bool FieldOfView::hasLineOfSight(sf::Vector2i const& a, sf::Vector2i const& b) const
+{
+    int dx = std::abs(b.x - a.x);
+    int dy = -std::abs(b.y - a.y);
+    int sx = (a.x < b.x) ? 1 : -1;
+    int sy = (a.y < b.y) ? 1 : -1;
+    int error = dx + dy;
+    sf::Vector2i p = a;
+    while (p != b)
+    {
+        int error2 = 2 * error;
+        if (error2 >= dy)
+        {
+            error += dy;
+            p.x += sx;
+        }
+        if (error2 <= dx)
+        {
+            error += dx;
+            p.y += sy;
+        }
+        if (p != b && isOpaque(p))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FieldOfView::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (mOpacity.getSize() != mLayer.getMap().getMapSize())
+    {
+        rebuild();
+    }
+    else if (mOpacity.contains(coords))
+    {
+        mOpacity.set(coords, mSelector(gid));
+    }
+}
+
+void FieldOfView::rebuild()
+{
+    mSelector.selectCells(mLayer, mOpacity);
+}
+
+void FieldOfView::castLight(sf::Vector2i const& origin, int row, float start, float end, int radius, int xx, int xy, int yx, int yy, BitGrid& visible) const
+{
+    // Scans the rows of an octant between two slopes, each opaque run splits the scan in a recursive call
+    if (start < end)
+    {
+        return;
+    }
+    const int radius2 = radius * radius;
+    float newStart = 0.f;
+    for (int j = row; j <= radius; j++)
+    {
+        int dy = -j;
+        bool blocked = false;
+        for (int dx = -j; dx <= 0; dx++)
+        {
+            float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+            float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+            if (start < rightSlope)
+            {
+                continue;
+            }
+            if (end > leftSlope)
+            {
+                break;
+            }
+            sf::Vector2i cell(origin.x + dx * xx + dy * xy, origin.y + dx * yx + dy * yy);
+            if (dx * dx + dy * dy < radius2 && visible.contains(cell))
+            {
+                visible.set(cell);
+            }
+            bool opaque = isOpaque(cell);
+            if (blocked)
+            {
+                if (opaque)
+                {
+                    newStart = rightSlope;
+                }
+                else
+                {
+                    blocked = false;
+                    start = newStart;
+                }
+            }
+            else if (opaque && j < radius)
+            {
+                blocked = true;
+                castLight(origin, j + 1, start, leftSlope, radius, xx, xy, yx, yy, visible);
+                newStart = rightSlope;
+            }
+        }
+        if (blocked)
+        {
+            break;
+        }
+    }
+}
+
+} // namespace tmx
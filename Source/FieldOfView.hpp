@@ -0,0 +1,60 @@
+#ifndef TMX_FIELDOFVIEW_HPP
+#define TMX_FIELDOFVIEW_HPP
+
+#include "BitGrid.hpp"
+#include "Layer.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+// Visibility over the opaque cells of a layer, kept in a bit grid updated on each tile change
+// Cells are seen as squares of the tile grid, out of the map cells are opaque
+// The field of view listens to its layer and must not outlive it
+class FieldOfView : public Layer::Listener
+{
+    public:
+        struct Observer
+        {
+            Observer();
+            Observer(sf::Vector2i const& position, int radius = 0);
+
+            sf::Vector2i position;
+            int radius; // 0 means unlimited
+        };
+
+        FieldOfView(Layer& layer, TileSelector const& opaque);
+        ~FieldOfView();
+
+        const BitGrid& getOpacity() const;
+        bool isOpaque(sf::Vector2i const& coords) const;
+
+        const TileSelector& getSelector() const;
+        void setSelector(TileSelector const& opaque);
+
+        // Recursive shadowcasting, the visible cells are written into a reused bit grid
+        void compute(sf::Vector2i const& origin, int radius, BitGrid& visible) const;
+        void compute(Observer const& observer, BitGrid& visible) const;
+
+        // One bit grid per observer, computed in parallel
+        void compute(std::vector<Observer> const& observers, std::vector<BitGrid>& visible) const;
+
+        // Bresenham line, only the cells strictly between a and b can block it
+        bool hasLineOfSight(sf::Vector2i const& a, sf::Vector2i const& b) const;
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+
+        void rebuild();
+
+    private:
+        void castLight(sf::Vector2i const& origin, int row, float start, float end, int radius, int xx, int xy, int yx, int yy, BitGrid& visible) const;
+
+    private:
+        Layer& mLayer;
+        TileSelector mSelector;
+        BitGrid mOpacity;
+};
+
+} // namespace tmx
+
+#endif // TMX_FIELDOFVIEW_HPP
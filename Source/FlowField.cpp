@@ -0,0 +1,346 @@
+#include "FlowField.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+
+namespace tmx
+{
+
+namespace
+{
+
+const float Unreachable = std::numeric_limits<float>::infinity();
+
+// Neighbours reach up to two cells away on staggered maps
+const int Halo = 2;
+
+} // namespace
+
+FlowField::FlowField()
+: mGoal()
+, mSize()
+, mCosts()
+, mNext()
+{
+}
+
+void FlowField::compute(Pathfinder const& pathfinder, sf::Vector2i const& goal, unsigned int chunkSize)
+{
+    const CostGrid& grid = pathfinder.getGrid();
+    mGoal = goal;
+    mSize = grid.getSize();
+    const std::size_t cells = static_cast<std::size_t>(mSize.x * mSize.y);
+    mCosts.assign(cells, Unreachable);
+    mNext.assign(cells, -1);
+    if (!grid.isWalkable(goal))
+    {
+        return;
+    }
+    mCosts[goal.x + goal.y * mSize.x] = 0.f;
+
+    const int size = std::max(static_cast<int>(chunkSize), Halo);
+    const sf::Vector2i chunks((mSize.x + size - 1) / size, (mSize.y + size - 1) / size);
+    std::vector<unsigned char> active(static_cast<std::size_t>(chunks.x * chunks.y), 0);
+    active[goal.x / size + (goal.y / size) * chunks.x] = 1;
+    bool running = true;
+    std::vector<int> batch;
+    std::vector<unsigned char> spread;
+    while (running)
+    {
+        running = false;
+
+        // Four phases, chunks of the same phase never touch each other
+        for (int phase = 0; phase < 4; phase++)
+        {
+            batch.clear();
+            for (int cy = phase / 2; cy < chunks.y; cy += 2)
+            {
+                for (int cx = phase % 2; cx < chunks.x; cx += 2)
+                {
+                    int chunk = cx + cy * chunks.x;
+                    if (active[chunk] != 0)
+                    {
+                        active[chunk] = 0;
+                        batch.push_back(chunk);
+                    }
+                }
+            }
+            spread.assign(batch.size(), 0);
+            detail::ThreadPool::getDefault().parallelFor(batch.size(), [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t i = begin; i < end; i++)
+                {
+                    int cx = batch[i] % chunks.x;
+                    int cy = batch[i] / chunks.x;
+                    sf::IntRect chunk(cx * size, cy * size, std::min(size, mSize.x - cx * size), std::min(size, mSize.y - cy * size));
+                    spread[i] = integrateChunk(pathfinder, chunk) ? 1 : 0;
+                }
+            }, 1);
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                if (spread[i] == 0)
+                {
+                    continue;
+                }
+                int cx = batch[i] % chunks.x;
+                int cy = batch[i] / chunks.x;
+                for (int y = std::max(0, cy - 1); y <= std::min(chunks.y - 1, cy + 1); y++)
+                {
+                    for (int x = std::max(0, cx - 1); x <= std::min(chunks.x - 1, cx + 1); x++)
+                    {
+                        if (x != cx || y != cy)
+                        {
+                            active[x + y * chunks.x] = 1;
+                            running = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Each cell points to the neighbour it reaches the goal through
+    const std::vector<unsigned char>& costs = grid.getCosts();
+    detail::ThreadPool::getDefault().parallelFor(static_cast<std::size_t>(mSize.y), [&](std::size_t begin, std::size_t end)
+    {
+        int neighbours[8];
+        float steps[8];
+        for (std::size_t y = begin; y < end; y++)
+        {
+            for (int x = 0; x < mSize.x; x++)
+            {
+                int cell = x + static_cast<int>(y) * mSize.x;
+                if (mCosts[cell] == Unreachable)
+                {
+                    continue;
+                }
+                float best = Unreachable;
+                int next = cell;
+                std::size_t count = pathfinder.getNeighbours(cell, neighbours, steps);
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    float cost = mCosts[neighbours[i]] + steps[i] * costs[neighbours[i]];
+                    if (cost < best)
+                    {
+                        best = cost;
+                        next = neighbours[i];
+                    }
+                }
+                mNext[cell] = (mCosts[cell] == 0.f) ? cell : next;
+            }
+        }
+    });
+}
+
+const sf::Vector2i& FlowField::getGoal() const
+{
+    return mGoal;
+}
+
+bool FlowField::isReachable(sf::Vector2i const& coords) const
+{
+    return contains(coords) && mCosts[coords.x + coords.y * mSize.x] != Unreachable;
+}
+
+float FlowField::getCost(sf::Vector2i const& coords) const
+{
+    return (contains(coords)) ? mCosts[coords.x + coords.y * mSize.x] : Unreachable;
+}
+
+sf::Vector2i FlowField::getNext(sf::Vector2i const& coords) const
+{
+    if (!contains(coords) || mNext[coords.x + coords.y * mSize.x] < 0)
+    {
+        return coords;
+    }
+    int next = mNext[coords.x + coords.y * mSize.x];
+    return sf::Vector2i(next % mSize.x, next / mSize.x);
+}
+
+sf::Vector2i FlowField::getDirection(sf::Vector2i const& coords) const
+{
+    return getNext(coords) - coords;
+}
+
+const std::vector<float>& FlowField::getCosts() const
+{
+    return mCosts;
+}
+
+bool FlowField::integrateChunk(Pathfinder const& pathfinder, sf::IntRect const& chunk)
+{
+    // Costs are pulled from the cells around the chunk, then spread inside it
+    // Returns true when a cell close enough to the border to be a neighbour of another chunk improved
+    static thread_local std::vector<std::pair<float, int>> open;
+    open.clear();
+    const std::vector<unsigned char>& costs = pathfinder.getGrid().getCosts();
+    const int width = mSize.x;
+    int neighbours[8];
+    float steps[8];
+    auto inside = [&](int cell) -> bool
+    {
+        return chunk.contains(cell % width, cell / width);
+    };
+    auto push = [&](int cell)
+    {
+        open.push_back(std::make_pair(mCosts[cell], cell));
+        std::push_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+    };
+    auto nearBorder = [&](int cell) -> bool
+    {
+        int x = cell % width;
+        int y = cell / width;
+        return x < chunk.left + Halo || x >= chunk.left + chunk.width - Halo || y < chunk.top + Halo || y >= chunk.top + chunk.height - Halo;
+    };
+
+    for (int y = chunk.top; y < chunk.top + chunk.height; y++)
+    {
+        for (int x = chunk.left; x < chunk.left + chunk.width; x++)
+        {
+            int cell = x + y * width;
+            if (costs[cell] == 0)
+            {
+                continue;
+            }
+            if (mCosts[cell] == 0.f)
+            {
+                push(cell);
+                continue;
+            }
+            if (!nearBorder(cell))
+            {
+                continue;
+            }
+            float best = mCosts[cell];
+            std::size_t count = pathfinder.getNeighbours(cell, neighbours, steps);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                if (!inside(neighbours[i]))
+                {
+                    best = std::min(best, mCosts[neighbours[i]] + steps[i] * costs[neighbours[i]]);
+                }
+            }
+            if (best < mCosts[cell])
+            {
+                mCosts[cell] = best;
+                push(cell);
+            }
+        }
+    }
+
+    bool spread = false;
+    while (!open.empty())
+    {
+        std::pop_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+        std::pair<float, int> top = open.back();
+        open.pop_back();
+        int cell = top.second;
+        if (top.first > mCosts[cell])
+        {
+            continue;
+        }
+        if (nearBorder(cell))
+        {
+            spread = true;
+        }
+        std::size_t count = pathfinder.getNeighbours(cell, neighbours, steps);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int next = neighbours[i];
+            float cost = mCosts[cell] + steps[i] * costs[cell];
+            if (inside(next) && cost < mCosts[next])
+            {
+                mCosts[next] = cost;
+                push(next);
+            }
+        }
+    }
+    return spread;
+}
+
+bool FlowField::contains(sf::Vector2i const& coords) const
+{
+    return 0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y;
+}
+
+FlowFieldCache::FlowFieldCache(CostGrid& grid, std::size_t capacity, bool diagonal)
+: mGrid(grid)
+, mPathfinder(grid, diagonal)
+, mCapacity(std::max<std::size_t>(1, capacity))
+, mEntries()
+, mIndex()
+{
+    mGrid.addListener(this);
+}
+
+FlowFieldCache::~FlowFieldCache()
+{
+    mGrid.removeListener(this);
+}
+
+const FlowField& FlowFieldCache::getField(sf::Vector2i const& goal)
+{
+    int key = goal.x + goal.y * mGrid.getSize().x;
+    auto found = mIndex.find(key);
+    if (found != mIndex.end())
+    {
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+    }
+    else
+    {
+        // The least recently used field is recycled, its buffers are kept
+        if (mEntries.size() >= mCapacity)
+        {
+            mIndex.erase(mEntries.back().goal);
+            mEntries.splice(mEntries.begin(), mEntries, std::prev(mEntries.end()));
+        }
+        else
+        {
+            mEntries.push_front(Entry());
+        }
+        mEntries.front().goal = key;
+        mEntries.front().stale = true;
+        mIndex[key] = mEntries.begin();
+    }
+    Entry& entry = mEntries.front();
+    if (entry.stale || entry.field.getGoal() != goal)
+    {
+        entry.field.compute(mPathfinder, goal);
+        entry.stale = false;
+    }
+    return entry.field;
+}
+
+std::size_t FlowFieldCache::getCapacity() const
+{
+    return mCapacity;
+}
+
+void FlowFieldCache::setCapacity(std::size_t capacity)
+{
+    mCapacity = std::max<std::size_t>(1, capacity);
+    while (mEntries.size() > mCapacity)
+    {
+        mIndex.erase(mEntries.back().goal);
+        mEntries.pop_back();
+    }
+}
+
+void FlowFieldCache::clear()
+{
+    mEntries.clear();
+    mIndex.clear();
+}
+
+void FlowFieldCache::onCostChanged(CostGrid& grid, sf::Vector2i const& coords, unsigned char previous, unsigned char cost)
+{
+    for (auto itr = mEntries.begin(); itr != mEntries.end(); ++itr)
+    {
+        itr->stale = true;
+    }
+}
+
+} // namespace tmx
@@ -0,0 +1,76 @@
+#ifndef TMX_FLOWFIELD_HPP
+#define TMX_FLOWFIELD_HPP
+
+#include <list>
+#include <unordered_map>
+
+#include "Pathfinder.hpp"
+
+namespace tmx
+{
+
+// Cost to reach one goal from every cell, and the next cell to step to
+// The integration runs a Dijkstra in each chunk of cells, chunks far enough apart run in parallel and spread their borders to their neighbours
+class FlowField
+{
+    public:
+        FlowField();
+
+        void compute(Pathfinder const& pathfinder, sf::Vector2i const& goal, unsigned int chunkSize = 32);
+
+        const sf::Vector2i& getGoal() const;
+        bool isReachable(sf::Vector2i const& coords) const;
+        float getCost(sf::Vector2i const& coords) const;
+
+        // The goal points to itself, unreachable cells to themselves
+        sf::Vector2i getNext(sf::Vector2i const& coords) const;
+        sf::Vector2i getDirection(sf::Vector2i const& coords) const;
+
+        const std::vector<float>& getCosts() const;
+
+    private:
+        bool integrateChunk(Pathfinder const& pathfinder, sf::IntRect const& chunk);
+        bool contains(sf::Vector2i const& coords) const;
+
+    private:
+        sf::Vector2i mGoal;
+        sf::Vector2i mSize;
+        std::vector<float> mCosts;
+        std::vector<int> mNext;
+};
+
+// Flow fields of the most recently used goals, every field is recomputed after a cost change
+class FlowFieldCache : public CostGrid::Listener
+{
+    public:
+        FlowFieldCache(CostGrid& grid, std::size_t capacity = 8, bool diagonal = true);
+        ~FlowFieldCache();
+
+        // The reference stays valid until the field is evicted
+        const FlowField& getField(sf::Vector2i const& goal);
+
+        std::size_t getCapacity() const;
+        void setCapacity(std::size_t capacity);
+        void clear();
+
+        void onCostChanged(CostGrid& grid, sf::Vector2i const& coords, unsigned char previous, unsigned char cost);
+
+    private:
+        struct Entry
+        {
+            FlowField field;
+            int goal;
+            bool stale;
+        };
+
+    private:
+        CostGrid& mGrid;
+        Pathfinder mPathfinder;
+        std::size_t mCapacity;
+        std::list<Entry> mEntries;
+        std::unordered_map<int, std::list<Entry>::iterator> mIndex;
+};
+
+} // namespace tmx
+
+#endif // TMX_FLOWFIELD_HPP
@@ -0,0 +1,414 @@
+#include "FogLayer.hpp"
+#include "Map.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace tmx
+{
+
+FogLayer::FogLayer(Map& map)
+: mMap(map)
+, mExploredCells()
+, mVisibleCells()
+, mUnexploredColor(sf::Color::Black)
+, mExploredColor(0, 0, 0, 160)
+, mPerCell(false)
+, mCells(sf::Triangles)
+, mPixels()
+, mTexture()
+, mDirtyBegin(0)
+, mDirtyEnd(0)
+{
+    update();
+}
+
+LayerType FogLayer::getLayerType() const
+{
+    return tmx::EFogLayer;
+}
+
+bool FogLayer::loadFromNode(pugi::xml_node const& layer)
+{
+    if (!layer)
+    {
+        return false;
+    }
+    LayerBase::loadFromNode(layer);
+    update();
+    pugi::xml_node dataNode = layer.child("data");
+    if (!dataNode)
+    {
+        return true;
+    }
+    sf::Vector2i size(layer.attribute("width").as_int(), layer.attribute("height").as_int());
+    if (!loadFromCode(dataNode.text().get(), size))
+    {
+        detail::log("Unable to read the explored cells of the fog layer : " + mName);
+        return false;
+    }
+    return true;
+}
+
+void FogLayer::saveToNode(pugi::xml_node& layer)
+{
+    if (!layer)
+    {
+        return;
+    }
+    LayerBase::saveToNode(layer);
+    layer.append_attribute("width") = mExploredCells.getSize().x;
+    layer.append_attribute("height") = mExploredCells.getSize().y;
+    pugi::xml_node dataNode = layer.append_child("data");
+    if (!dataNode)
+    {
+        return;
+    }
+    dataNode.append_attribute("encoding") = "base64";
+    dataNode.append_attribute("compression") = "zlib";
+    dataNode.text().set(getCode().c_str());
+}
+
+void FogLayer::reveal(BitGrid const& visible)
+{
+    if (visible.getSize() != mVisibleCells.getSize())
+    {
+        detail::log("Visible cells of another size than the fog layer : " + mName);
+        return;
+    }
+
+    // Whole words at once, only the rows with new bits have to be drawn again
+    const std::vector<sf::Uint64>& source = visible.getWords();
+    std::vector<sf::Uint64>& explored = mExploredCells.getWords();
+    std::vector<sf::Uint64>& shown = mVisibleCells.getWords();
+    std::size_t stride = mVisibleCells.getStride();
+    int begin = mVisibleCells.getSize().y;
+    int end = 0;
+    for (int y = 0; y < mVisibleCells.getSize().y; y++)
+    {
+        sf::Uint64 changed = 0;
+        for (std::size_t i = y * stride; i < (y + 1) * stride; i++)
+        {
+            changed |= source[i] & ~shown[i];
+            shown[i] |= source[i];
+            explored[i] |= source[i];
+        }
+        if (changed != 0)
+        {
+            begin = std::min(begin, y);
+            end = y + 1;
+        }
+    }
+    invalidate(begin, end);
+}
+
+void FogLayer::reveal(std::vector<BitGrid> const& visible)
+{
+    for (std::size_t i = 0; i < visible.size(); i++)
+    {
+        reveal(visible[i]);
+    }
+}
+
+void FogLayer::reveal(sf::Vector2i const& coords)
+{
+    if (mVisibleCells.contains(coords) && !mVisibleCells.test(coords))
+    {
+        mVisibleCells.set(coords);
+        mExploredCells.set(coords);
+        invalidate(coords.y, coords.y + 1);
+    }
+}
+
+void FogLayer::conceal()
+{
+    const std::vector<sf::Uint64>& shown = mVisibleCells.getWords();
+    std::size_t stride = mVisibleCells.getStride();
+    int begin = mVisibleCells.getSize().y;
+    int end = 0;
+    for (std::size_t i = 0; i < shown.size(); i++)
+    {
+        if (shown[i] != 0)
+        {
+            int y = static_cast<int>(i / stride);
+            begin = std::min(begin, y);
+            end = y + 1;
+        }
+    }
+    mVisibleCells.clear();
+    invalidate(begin, end);
+}
+
+void FogLayer::reset()
+{
+    mExploredCells.clear();
+    mVisibleCells.clear();
+    invalidate(0, mExploredCells.getSize().y);
+}
+
+bool FogLayer::isExplored(sf::Vector2i const& coords) const
+{
+    return mExploredCells.testOr(coords, false);
+}
+
+bool FogLayer::isVisible(sf::Vector2i const& coords) const
+{
+    return mVisibleCells.testOr(coords, false);
+}
+
+const BitGrid& FogLayer::getExplored() const
+{
+    return mExploredCells;
+}
+
+const BitGrid& FogLayer::getVisible() const
+{
+    return mVisibleCells;
+}
+
+const sf::Color& FogLayer::getUnexploredColor() const
+{
+    return mUnexploredColor;
+}
+
+const sf::Color& FogLayer::getExploredColor() const
+{
+    return mExploredColor;
+}
+
+void FogLayer::setUnexploredColor(sf::Color const& color)
+{
+    mUnexploredColor = color;
+    invalidate(0, mExploredCells.getSize().y);
+}
+
+void FogLayer::setExploredColor(sf::Color const& color)
+{
+    mExploredColor = color;
+    invalidate(0, mExploredCells.getSize().y);
+}
+
+bool FogLayer::loadFromCode(std::string const& code, sf::Vector2i const& size)
+{
+    std::string data = code;
+    data.erase(std::remove_if(data.begin(), data.end(), [](char c)->bool{return std::isspace(static_cast<unsigned char>(c)) != 0;}), data.end());
+    if (!decompress(data))
+    {
+        return false;
+    }
+
+    // Rows of bytes, first cell in the lowest bit
+    std::size_t rowBytes = (static_cast<std::size_t>(std::max(size.x, 0)) + 7) / 8;
+    if (data.size() < rowBytes * std::max(size.y, 0))
+    {
+        return false;
+    }
+    mExploredCells.clear();
+    sf::Vector2i coords;
+    for (coords.y = 0; coords.y < std::min(size.y, mExploredCells.getSize().y); coords.y++)
+    {
+        for (coords.x = 0; coords.x < std::min(size.x, mExploredCells.getSize().x); coords.x++)
+        {
+            unsigned char byte = static_cast<unsigned char>(data[coords.y * rowBytes + coords.x / 8]);
+            if ((byte >> (coords.x & 7)) & 1)
+            {
+                mExploredCells.set(coords);
+            }
+        }
+    }
+    invalidate(0, mExploredCells.getSize().y);
+    return true;
+}
+
+std::string FogLayer::getCode() const
+{
+    const sf::Vector2i& size = mExploredCells.getSize();
+    const std::vector<sf::Uint64>& words = mExploredCells.getWords();
+    std::size_t stride = mExploredCells.getStride();
+    std::size_t rowBytes = (static_cast<std::size_t>(size.x) + 7) / 8;
+    std::string data;
+    data.reserve(rowBytes * size.y);
+    for (int y = 0; y < size.y; y++)
+    {
+        for (std::size_t i = 0; i < rowBytes; i++)
+        {
+            data.push_back(static_cast<char>(words[y * stride + i / 8] >> ((i % 8) * 8)));
+        }
+    }
+    if (!compress(data))
+    {
+        return "";
+    }
+    return data;
+}
+
+void FogLayer::update()
+{
+    const MapGeometry& geometry = mMap.getGeometry();
+    sf::Vector2i size = mMap.getMapSize();
+    if (size != mExploredCells.getSize())
+    {
+        mExploredCells.resize(size);
+        mVisibleCells.resize(size);
+    }
+    mPerCell = geometry.getOrientation() == MapGeometry::EStaggered || geometry.getOrientation() == MapGeometry::EHexagonal;
+
+    if (!mPerCell)
+    {
+        // Cell corners map affinely to the world, so one quad covers the whole map
+        sf::Vector2f origin;
+        if (geometry.getOrientation() == MapGeometry::EIsometric)
+        {
+            origin.x = geometry.getTileSize().x * 0.5f;
+        }
+        sf::Vector2i corners[4] = {sf::Vector2i(0, 0), sf::Vector2i(size.x, 0), size, sf::Vector2i(0, size.y)};
+        sf::Vertex vertices[4];
+        for (std::size_t i = 0; i < 4; i++)
+        {
+            vertices[i] = sf::Vertex(origin + geometry.coordsToWorld(corners[i]), sf::Color::White, static_cast<sf::Vector2f>(corners[i]));
+        }
+        mQuad[0] = vertices[0];
+        mQuad[1] = vertices[1];
+        mQuad[2] = vertices[2];
+        mQuad[3] = vertices[2];
+        mQuad[4] = vertices[3];
+        mQuad[5] = vertices[0];
+
+        mCells.clear();
+        mPixels.resize(size.x * size.y * 4);
+        if (sf::Vector2i(mTexture.getSize()) != size && size.x > 0 && size.y > 0)
+        {
+            mTexture.create(size.x, size.y);
+        }
+    }
+    else
+    {
+        // Hexagon of the cell in the frame of the stagger axis, a diamond when the caps meet
+        bool staggerX = geometry.isStaggerX();
+        float across = (staggerX) ? geometry.getTileSize().y : geometry.getTileSize().x;
+        float along = (staggerX) ? geometry.getTileSize().x : geometry.getTileSize().y;
+        float cap = geometry.getCapHeight();
+        sf::Vector2f points[6] = {sf::Vector2f(across * 0.5f, 0.f), sf::Vector2f(across, cap), sf::Vector2f(across, along - cap),
+                                  sf::Vector2f(across * 0.5f, along), sf::Vector2f(0.f, along - cap), sf::Vector2f(0.f, cap)};
+        for (std::size_t i = 0; i < 6; i++)
+        {
+            if (staggerX)
+            {
+                std::swap(points[i].x, points[i].y);
+            }
+        }
+
+        mCells.resize(size.x * size.y * 12);
+        mPixels.clear();
+        sf::Vector2i coords;
+        for (coords.y = 0; coords.y < size.y; coords.y++)
+        {
+            for (coords.x = 0; coords.x < size.x; coords.x++)
+            {
+                sf::Vector2f pos = geometry.coordsToWorld(coords);
+                sf::Vertex* tri = &mCells[(coords.x + coords.y * size.x) * 12];
+                for (std::size_t i = 0; i < 4; i++)
+                {
+                    tri[i * 3].position = pos + points[0];
+                    tri[i * 3 + 1].position = pos + points[i + 1];
+                    tri[i * 3 + 2].position = pos + points[i + 2];
+                }
+            }
+        }
+    }
+    invalidate(0, size.y);
+}
+
+void FogLayer::setOpacity(float opacity)
+{
+    // The opacity is in the colors of the cells, the geometry stays
+    mOpacity = opacity;
+    invalidate(0, mExploredCells.getSize().y);
+}
+
+void FogLayer::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    if (mVisible && mExploredCells.getSize().x > 0 && mExploredCells.getSize().y > 0)
+    {
+        ensureUpdated();
+        states.transform.translate(mOffset + mMap.getMapOffset());
+        if (mPerCell)
+        {
+            target.draw(mCells, states);
+        }
+        else
+        {
+            states.texture = &mTexture;
+            target.draw(mQuad, 6, sf::Triangles, states);
+        }
+    }
+}
+
+void FogLayer::invalidate(int begin, int end)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+    if (mDirtyBegin >= mDirtyEnd)
+    {
+        mDirtyBegin = begin;
+        mDirtyEnd = end;
+    }
+    else
+    {
+        mDirtyBegin = std::min(mDirtyBegin, begin);
+        mDirtyEnd = std::max(mDirtyEnd, end);
+    }
+}
+
+void FogLayer::ensureUpdated() const
+{
+    if (mDirtyBegin >= mDirtyEnd)
+    {
+        return;
+    }
+    const sf::Vector2i& size = mExploredCells.getSize();
+    sf::Vector2i coords;
+    for (coords.y = mDirtyBegin; coords.y < mDirtyEnd; coords.y++)
+    {
+        for (coords.x = 0; coords.x < size.x; coords.x++)
+        {
+            sf::Color color = getColor(coords);
+            color.a = static_cast<sf::Uint8>(color.a * mOpacity);
+            std::size_t cell = coords.x + coords.y * size.x;
+            if (mPerCell)
+            {
+                for (std::size_t i = 0; i < 12; i++)
+                {
+                    mCells[cell * 12 + i].color = color;
+                }
+            }
+            else
+            {
+                mPixels[cell * 4] = color.r;
+                mPixels[cell * 4 + 1] = color.g;
+                mPixels[cell * 4 + 2] = color.b;
+                mPixels[cell * 4 + 3] = color.a;
+            }
+        }
+    }
+    if (!mPerCell)
+    {
+        // Only the rows which changed are uploaded
+        mTexture.update(&mPixels[mDirtyBegin * size.x * 4], size.x, mDirtyEnd - mDirtyBegin, 0, mDirtyBegin);
+    }
+    mDirtyBegin = 0;
+    mDirtyEnd = 0;
+}
+
+sf::Color FogLayer::getColor(sf::Vector2i const& coords) const
+{
+    if (mVisibleCells.test(coords))
+    {
+        return sf::Color::Transparent;
+    }
+    return (mExploredCells.test(coords)) ? mExploredColor : mUnexploredColor;
+}
+
+} // namespace tmx
@@ -0,0 +1,77 @@
+#ifndef TMX_FOGLAYER_HPP
+#define TMX_FOGLAYER_HPP
+
+#include "BitGrid.hpp"
+#include "Utils.hpp"
+
+namespace tmx
+{
+
+// Fog of war over the cells of a map, two bits per cell : explored and visible
+// Orthogonal and isometric maps draw it as one quad sampling a texture of one texel per cell,
+// staggered and hexagonal maps as one flat colored polygon per cell
+// Only the explored cells are saved, the visible ones are expected to be revealed again every frame
+class FogLayer : public LayerBase
+{
+    public:
+        FogLayer(Map& map);
+
+        LayerType getLayerType() const;
+
+        bool loadFromNode(pugi::xml_node const& layer);
+        void saveToNode(pugi::xml_node& layer);
+
+        // Visible cells are also explored, the grids must have the size of the map (as field of view results have)
+        void reveal(BitGrid const& visible);
+        void reveal(std::vector<BitGrid> const& visible);
+        void reveal(sf::Vector2i const& coords);
+
+        // Hides every cell, the explored ones stay explored
+        void conceal();
+
+        // Forgets every explored cell
+        void reset();
+
+        bool isExplored(sf::Vector2i const& coords) const;
+        bool isVisible(sf::Vector2i const& coords) const;
+        const BitGrid& getExplored() const;
+        const BitGrid& getVisible() const;
+
+        const sf::Color& getUnexploredColor() const;
+        const sf::Color& getExploredColor() const;
+        void setUnexploredColor(sf::Color const& color);
+        void setExploredColor(sf::Color const& color);
+
+        bool loadFromCode(std::string const& code, sf::Vector2i const& size);
+        std::string getCode() const;
+
+        void setOpacity(float opacity);
+
+        // Resizes the fog to the map, which forgets the explored cells if the size changed
+        void update();
+
+        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
+
+    private:
+        void invalidate(int begin, int end);
+        void ensureUpdated() const;
+        sf::Color getColor(sf::Vector2i const& coords) const;
+
+    private:
+        Map& mMap;
+        BitGrid mExploredCells;
+        BitGrid mVisibleCells;
+        sf::Color mUnexploredColor;
+        sf::Color mExploredColor;
+        bool mPerCell;
+        sf::Vertex mQuad[6];
+        mutable sf::VertexArray mCells;
+        mutable std::vector<sf::Uint8> mPixels;
+        mutable sf::Texture mTexture;
+        mutable int mDirtyBegin;
+        mutable int mDirtyEnd;
+};
+
+} // namespace tmx
+
+#endif // TMX_FOGLAYER_HPP
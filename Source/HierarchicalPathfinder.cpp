@@ -0,0 +1,858 @@
+#include "HierarchicalPathfinder.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+
+namespace tmx
+{
+
+namespace
+{
+
+// Estimates on the graph of the transitions are inflated, so its searches stay near the line to the goal instead of
+// opening every node about as close to it, their paths cost at most that much more than the best one through the graph
+const float Greed = 1.25f;
+
+// The searches on the graph of the transitions, reused like the ones of the pathfinder
+detail::SearchState& getSearch()
+{
+    static thread_local detail::SearchState search;
+    return search;
+}
+
+} // namespace
+
+HierarchicalPathfinder::HierarchicalPathfinder(CostGrid& grid, unsigned int clusterSize, bool diagonal)
+: mGrid(grid)
+, mPathfinder(grid, diagonal)
+, mGeometry(grid.getMap().getGeometry())
+, mReach()
+, mClusterSize(std::max(4, static_cast<int>(clusterSize)))
+, mSize()
+, mClusterCount()
+, mClusters()
+, mVerticalBorders()
+, mHorizontalBorders()
+, mNodeClusters()
+, mComponents()
+, mDirty(true)
+{
+    // Both parities of the staggered coordinate
+    for (int parity = 0; parity < 2; parity++)
+    {
+        Span<sf::Vector2i> offsets = mGeometry.getNeighbourOffsets(sf::Vector2i(parity, parity), diagonal);
+        for (std::size_t i = 0; i < offsets.size(); i++)
+        {
+            mReach.x = std::max(mReach.x, std::abs(offsets[i].x));
+            mReach.y = std::max(mReach.y, std::abs(offsets[i].y));
+        }
+    }
+    mGrid.addListener(this);
+}
+
+HierarchicalPathfinder::~HierarchicalPathfinder()
+{
+    mGrid.removeListener(this);
+}
+
+bool HierarchicalPathfinder::findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path)
+{
+    update();
+    return search(start, goal, path);
+}
+
+void HierarchicalPathfinder::findPaths(std::vector<Pathfinder::Query>& queries)
+{
+    update();
+    detail::ThreadPool::getDefault().parallelFor(queries.size(), [this, &queries](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            queries[i].found = search(queries[i].start, queries[i].goal, queries[i].path);
+        }
+    });
+}
+
+void HierarchicalPathfinder::update()
+{
+    if (mSize != mGrid.getSize())
+    {
+        mSize = mGrid.getSize();
+        mClusterCount.x = (mSize.x + mClusterSize - 1) / mClusterSize;
+        mClusterCount.y = (mSize.y + mClusterSize - 1) / mClusterSize;
+        std::size_t count = static_cast<std::size_t>(mClusterCount.x * mClusterCount.y);
+        mClusters.assign(count, Cluster());
+        for (int y = 0; y < mClusterCount.y; y++)
+        {
+            for (int x = 0; x < mClusterCount.x; x++)
+            {
+                Cluster& cluster = mClusters[x + y * mClusterCount.x];
+                cluster.bounds.left = x * mClusterSize;
+                cluster.bounds.top = y * mClusterSize;
+                cluster.bounds.width = std::min(mClusterSize, mSize.x - cluster.bounds.left);
+                cluster.bounds.height = std::min(mClusterSize, mSize.y - cluster.bounds.top);
+                cluster.dirty = true;
+            }
+        }
+        Border border;
+        border.dirty = true;
+        mVerticalBorders.assign(count, border);
+        mHorizontalBorders.assign(count, border);
+        mDirty = true;
+    }
+    if (!mDirty)
+    {
+        return;
+    }
+
+    // Borders first, a cluster is rebuilt when its own cells or one of its borders changed
+    std::vector<std::pair<std::size_t, bool>> borders;
+    for (std::size_t i = 0; i < mClusters.size(); i++)
+    {
+        if (mVerticalBorders[i].dirty)
+        {
+            borders.push_back(std::make_pair(i, true));
+        }
+        if (mHorizontalBorders[i].dirty)
+        {
+            borders.push_back(std::make_pair(i, false));
+        }
+    }
+    std::vector<unsigned char> changed(borders.size(), 0);
+    detail::ThreadPool::getDefault().parallelFor(borders.size(), [this, &borders, &changed](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            changed[i] = buildBorder(borders[i].first, borders[i].second) ? 1 : 0;
+        }
+    });
+    for (std::size_t i = 0; i < borders.size(); i++)
+    {
+        if (changed[i] == 0)
+        {
+            continue;
+        }
+        const int x = static_cast<int>(borders[i].first) % mClusterCount.x;
+        const int y = static_cast<int>(borders[i].first) / mClusterCount.x;
+        mClusters[borders[i].first].dirty = true;
+        if (borders[i].second)
+        {
+            mClusters[borders[i].first + 1].dirty = true;
+            continue;
+        }
+        for (int other = std::max(0, x - 1); other <= std::min(mClusterCount.x - 1, x + 1); other++)
+        {
+            mClusters[other + (y + 1) * mClusterCount.x].dirty = true;
+        }
+    }
+
+    // The nodes of every changed cluster are known before the links to them are
+    std::vector<std::size_t> clusters;
+    for (std::size_t i = 0; i < mClusters.size(); i++)
+    {
+        if (mClusters[i].dirty)
+        {
+            clusters.push_back(i);
+        }
+    }
+    detail::ThreadPool::getDefault().parallelFor(clusters.size(), [this, &clusters](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            collectNodes(clusters[i]);
+        }
+    });
+    detail::ThreadPool::getDefault().parallelFor(clusters.size(), [this, &clusters](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            buildCluster(clusters[i]);
+        }
+    }, 1);
+
+    // Links name the nodes of the clusters around, which can be numbered again by their other borders
+    std::vector<unsigned char> linked(mClusters.size(), 0);
+    for (std::size_t i = 0; i < clusters.size(); i++)
+    {
+        const int x = static_cast<int>(clusters[i]) % mClusterCount.x;
+        const int y = static_cast<int>(clusters[i]) / mClusterCount.x;
+        for (int ny = std::max(0, y - 1); ny <= std::min(mClusterCount.y - 1, y + 1); ny++)
+        {
+            for (int nx = std::max(0, x - 1); nx <= std::min(mClusterCount.x - 1, x + 1); nx++)
+            {
+                linked[nx + ny * mClusterCount.x] = 1;
+            }
+        }
+    }
+    clusters.clear();
+    for (std::size_t i = 0; i < mClusters.size(); i++)
+    {
+        if (linked[i] != 0)
+        {
+            clusters.push_back(i);
+        }
+    }
+    detail::ThreadPool::getDefault().parallelFor(clusters.size(), [this, &clusters](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            buildLinks(clusters[i]);
+        }
+    });
+
+    if (!clusters.empty())
+    {
+        // Nodes and groups are numbered again when a cluster has a different count of them
+        int count = 0;
+        int groups = 0;
+        bool moved = false;
+        for (std::size_t i = 0; i < mClusters.size(); i++)
+        {
+            Cluster& cluster = mClusters[i];
+            moved = moved || cluster.first != count;
+            cluster.first = count;
+            cluster.firstGroup = groups;
+            count += static_cast<int>(cluster.nodes.size());
+            groups += (cluster.groups.empty()) ? 0 : *std::max_element(cluster.groups.begin(), cluster.groups.end()) + 1;
+        }
+        if (moved || mNodeClusters.size() != static_cast<std::size_t>(count))
+        {
+            mNodeClusters.resize(count);
+            for (std::size_t i = 0; i < mClusters.size(); i++)
+            {
+                std::fill_n(mNodeClusters.begin() + mClusters[i].first, mClusters[i].nodes.size(), static_cast<int>(i));
+            }
+        }
+
+        // Components of the graph, a search between two of them fails without opening any node
+        mComponents.resize(groups);
+        std::iota(mComponents.begin(), mComponents.end(), 0);
+        auto find = [this](int group)
+        {
+            while (mComponents[group] != group)
+            {
+                mComponents[group] = mComponents[mComponents[group]];
+                group = mComponents[group];
+            }
+            return group;
+        };
+        for (std::size_t i = 0; i < mClusters.size(); i++)
+        {
+            const Cluster& cluster = mClusters[i];
+            for (std::size_t j = 0; j < cluster.joins.size(); j++)
+            {
+                const Join& join = cluster.joins[j];
+                mComponents[find(cluster.firstGroup + join.group)] = find(mClusters[join.cluster].firstGroup + join.other);
+            }
+        }
+        for (int i = 0; i < groups; i++)
+        {
+            mComponents[i] = find(i);
+        }
+    }
+    mDirty = false;
+}
+
+std::size_t HierarchicalPathfinder::getNodeCount() const
+{
+    return mNodeClusters.size();
+}
+
+unsigned int HierarchicalPathfinder::getClusterSize() const
+{
+    return static_cast<unsigned int>(mClusterSize);
+}
+
+const Pathfinder& HierarchicalPathfinder::getPathfinder() const
+{
+    return mPathfinder;
+}
+
+void HierarchicalPathfinder::onCostChanged(CostGrid& grid, sf::Vector2i const& coords, unsigned char previous, unsigned char cost)
+{
+    if (mClusters.empty() || mSize != grid.getSize())
+    {
+        return;
+    }
+    mClusters[coords.x / mClusterSize + (coords.y / mClusterSize) * mClusterCount.x].dirty = true;
+
+    // A crossing changes with its cells and the corners it passes by, its border belongs to the cluster above or left of it
+    const int reach = 2 * std::max(mReach.x, mReach.y);
+    const int left = std::max(0, coords.x - reach) / mClusterSize;
+    const int right = std::min(mSize.x - 1, coords.x + reach) / mClusterSize;
+    const int top = std::max(0, coords.y - reach) / mClusterSize;
+    const int bottom = std::min(mSize.y - 1, coords.y + reach) / mClusterSize;
+    for (int y = top; y <= bottom; y++)
+    {
+        for (int x = left; x <= right; x++)
+        {
+            mVerticalBorders[x + y * mClusterCount.x].dirty = true;
+            mHorizontalBorders[x + y * mClusterCount.x].dirty = true;
+        }
+    }
+    mDirty = true;
+}
+
+bool HierarchicalPathfinder::search(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path) const
+{
+    path.clear();
+    if (!mGrid.isWalkable(start) || !mGrid.isWalkable(goal) || mClusters.empty())
+    {
+        return false;
+    }
+    if (start == goal)
+    {
+        path.push_back(start);
+        return true;
+    }
+    const int width = mSize.x;
+    const int from = start.x + start.y * width;
+    const int to = goal.x + goal.y * width;
+    const int startCluster = getClusterIndex(from);
+    const int goalCluster = getClusterIndex(to);
+
+    // Start and goal are linked to the nodes of their clusters for this search only, and to each other in a same cluster
+    // so a shorter way out of the cluster can still win
+    const Cluster& first = mClusters[startCluster];
+    const Cluster& last = mClusters[goalCluster];
+    std::vector<sf::Vector2i> targets;
+    std::vector<float> startCosts;
+    std::vector<float> goalCosts;
+    for (std::size_t i = 0; i < first.nodes.size(); i++)
+    {
+        targets.push_back(sf::Vector2i(first.nodes[i] % width, first.nodes[i] / width));
+    }
+    if (startCluster == goalCluster)
+    {
+        targets.push_back(goal);
+    }
+    mPathfinder.findCosts(start, targets, startCosts, first.bounds);
+    targets.clear();
+    for (std::size_t i = 0; i < last.nodes.size(); i++)
+    {
+        targets.push_back(sf::Vector2i(last.nodes[i] % width, last.nodes[i] / width));
+    }
+    mPathfinder.findCosts(goal, targets, goalCosts, last.bounds, true);
+    const float infinity = std::numeric_limits<float>::infinity();
+    bool connected = (startCluster == goalCluster && startCosts.back() < infinity);
+    for (std::size_t i = 0; i < first.nodes.size() && !connected; i++)
+    {
+        for (std::size_t j = 0; j < last.nodes.size() && startCosts[i] < infinity && !connected; j++)
+        {
+            connected = (goalCosts[j] < infinity && mComponents[first.firstGroup + first.groups[i]] == mComponents[last.firstGroup + last.groups[j]]);
+        }
+    }
+    if (!connected)
+    {
+        return false;
+    }
+
+    // Nodes are numbered over the whole graph, start and goal come after them
+    const int startNode = static_cast<int>(mNodeClusters.size());
+    const int goalNode = startNode + 1;
+    auto estimate = [this, width, &goal](int cell)
+    {
+        return Greed * mPathfinder.getEstimate(sf::Vector2i(cell % width, cell / width), goal);
+    };
+    detail::SearchState& search = getSearch();
+    search.reset(mNodeClusters.size() + 2);
+    search.push(startNode, -1, 0.f, estimate(from));
+    int node;
+    while ((node = search.pop()) >= 0 && node != goalNode)
+    {
+        if (node == startNode)
+        {
+            for (std::size_t i = 0; i < first.nodes.size(); i++)
+            {
+                if (startCosts[i] < infinity)
+                {
+                    search.relax(first.first + static_cast<int>(i), node, startCosts[i], estimate(first.nodes[i]));
+                }
+            }
+            if (startCluster == goalCluster && startCosts.back() < infinity)
+            {
+                search.relax(goalNode, node, startCosts.back(), 0.f);
+            }
+            continue;
+        }
+        const int clusterIndex = mNodeClusters[node];
+        const Cluster& cluster = mClusters[clusterIndex];
+        const std::size_t local = static_cast<std::size_t>(node - cluster.first);
+        const std::size_t count = cluster.nodes.size();
+        const float cost = search.costs[node];
+        const float* costs = &cluster.costs[local * count];
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const int next = cluster.first + static_cast<int>(i);
+            if (costs[i] < infinity && i != local && !search.isClosed(next))
+            {
+                search.relax(next, node, cost + costs[i], estimate(cluster.nodes[i]));
+            }
+        }
+        const std::vector<Link>& links = cluster.links[local];
+        for (std::size_t i = 0; i < links.size(); i++)
+        {
+            const Cluster& other = mClusters[links[i].cluster];
+            const int next = other.first + links[i].node;
+            if (!search.isClosed(next))
+            {
+                search.relax(next, node, cost + links[i].cost, estimate(other.nodes[links[i].node]));
+            }
+        }
+        if (clusterIndex == goalCluster && goalCosts[local] < infinity)
+        {
+            search.relax(goalNode, node, cost + goalCosts[local], 0.f);
+        }
+    }
+    if (node != goalNode)
+    {
+        return false;
+    }
+
+    // Steps inside a cluster follow the cached paths, only the ends are searched
+    std::vector<int> nodes;
+    for (int n = goalNode; n >= 0; n = search.parents[n])
+    {
+        nodes.push_back(n);
+    }
+    std::reverse(nodes.begin(), nodes.end());
+    path.push_back(start);
+    std::vector<sf::Vector2i> part;
+    for (std::size_t i = 1; i < nodes.size(); i++)
+    {
+        const int a = nodes[i - 1];
+        const int b = nodes[i];
+        if (a == startNode || b == goalNode)
+        {
+            sf::Vector2i cellA = (a == startNode) ? start : sf::Vector2i(getNodeCell(a) % width, getNodeCell(a) / width);
+            sf::Vector2i cellB = (b == goalNode) ? goal : sf::Vector2i(getNodeCell(b) % width, getNodeCell(b) / width);
+            if (!mPathfinder.findPath(cellA, cellB, part, ((a == startNode) ? first : last).bounds))
+            {
+                path.clear();
+                return false;
+            }
+            path.insert(path.end(), part.begin() + 1, part.end());
+        }
+        else if (mNodeClusters[a] == mNodeClusters[b])
+        {
+            const Cluster& cluster = mClusters[mNodeClusters[a]];
+            appendRoute(cluster, a - cluster.first, b - cluster.first, path);
+        }
+        else
+        {
+            path.push_back(sf::Vector2i(getNodeCell(b) % width, getNodeCell(b) / width));
+        }
+    }
+    return true;
+}
+
+int HierarchicalPathfinder::getClusterIndex(int cell) const
+{
+    return (cell % mSize.x) / mClusterSize + ((cell / mSize.x) / mClusterSize) * mClusterCount.x;
+}
+
+int HierarchicalPathfinder::getNodeIndex(Cluster const& cluster, int cell) const
+{
+    auto found = std::lower_bound(cluster.nodes.begin(), cluster.nodes.end(), cell);
+    if (found != cluster.nodes.end() && *found == cell)
+    {
+        return static_cast<int>(found - cluster.nodes.begin());
+    }
+    return -1;
+}
+
+int HierarchicalPathfinder::getNodeCell(int node) const
+{
+    const Cluster& cluster = mClusters[mNodeClusters[node]];
+    return cluster.nodes[node - cluster.first];
+}
+
+std::size_t HierarchicalPathfinder::getBorders(std::size_t index, const Border** borders, bool* first) const
+{
+    // The borders of the cluster, then the ones of the clusters left and above which can reach into it
+    const int x = static_cast<int>(index) % mClusterCount.x;
+    const int y = static_cast<int>(index) / mClusterCount.x;
+    std::size_t count = 0;
+    borders[count] = &mVerticalBorders[index];
+    first[count++] = true;
+    borders[count] = &mHorizontalBorders[index];
+    first[count++] = true;
+    if (x > 0)
+    {
+        borders[count] = &mVerticalBorders[index - 1];
+        first[count++] = false;
+    }
+    if (y > 0)
+    {
+        for (int other = std::max(0, x - 1); other <= std::min(mClusterCount.x - 1, x + 1); other++)
+        {
+            borders[count] = &mHorizontalBorders[other + (y - 1) * mClusterCount.x];
+            first[count++] = false;
+        }
+    }
+    return count;
+}
+
+bool HierarchicalPathfinder::buildBorder(std::size_t index, bool vertical)
+{
+    Border& border = (vertical) ? mVerticalBorders[index] : mHorizontalBorders[index];
+    border.dirty = false;
+    const int cx = static_cast<int>(index) % mClusterCount.x;
+    const int cy = static_cast<int>(index) / mClusterCount.x;
+    if ((vertical && cx + 1 >= mClusterCount.x) || (!vertical && cy + 1 >= mClusterCount.y))
+    {
+        bool changed = !border.transitions.empty();
+        border.transitions.clear();
+        border.costs.clear();
+        return changed;
+    }
+    const sf::IntRect& a = mClusters[index].bounds;
+    const int right = a.left + a.width;
+    const int bottom = a.top + a.height;
+    const int width = mSize.x;
+
+    // Every step from the cells near the border to the other side, as the pathfinder takes them
+    struct Crossing
+    {
+        int cluster;
+        int along;
+        float step;
+        int cell;
+        int other;
+    };
+    std::vector<Crossing> crossings;
+    const int left = (vertical) ? std::max(a.left, right - mReach.x) : a.left;
+    const int top = (vertical) ? a.top : std::max(a.top, bottom - mReach.y);
+    int neighbours[8];
+    float steps[8];
+    for (int y = top; y < bottom; y++)
+    {
+        for (int x = left; x < right; x++)
+        {
+            const int cell = x + y * width;
+            if (!mGrid.isWalkable(sf::Vector2i(x, y)))
+            {
+                continue;
+            }
+            const std::size_t count = mPathfinder.getNeighbours(cell, neighbours, steps);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const int nx = neighbours[i] % width;
+                const int ny = neighbours[i] / width;
+                if ((vertical && nx >= right && ny >= a.top && ny < bottom) || (!vertical && ny >= bottom))
+                {
+                    Crossing crossing = {getClusterIndex(neighbours[i]), (vertical) ? y : x, steps[i], cell, neighbours[i]};
+                    crossings.push_back(crossing);
+                }
+            }
+        }
+    }
+    std::sort(crossings.begin(), crossings.end(), [](Crossing const& l, Crossing const& r)
+    {
+        if (l.cluster != r.cluster)
+        {
+            return l.cluster < r.cluster;
+        }
+        if (l.along != r.along)
+        {
+            return l.along < r.along;
+        }
+        if (l.step != r.step)
+        {
+            return l.step < r.step;
+        }
+        return std::make_pair(l.cell, l.other) < std::make_pair(r.cell, r.other);
+    });
+
+    // Crossings are in a same segment when both their sides are neighbours, or the same cell
+    std::vector<int> roots(crossings.size());
+    std::iota(roots.begin(), roots.end(), 0);
+    auto find = [&roots](int i)
+    {
+        while (roots[i] != i)
+        {
+            roots[i] = roots[roots[i]];
+            i = roots[i];
+        }
+        return i;
+    };
+    const int reach = (vertical) ? mReach.y : mReach.x;
+    for (std::size_t i = 0; i < crossings.size(); i++)
+    {
+        const Crossing& c = crossings[i];
+        for (std::size_t j = i + 1; j < crossings.size() && crossings[j].cluster == c.cluster && crossings[j].along - c.along <= reach; j++)
+        {
+            const Crossing& d = crossings[j];
+            if ((c.cell == d.cell || isNeighbour(c.cell, d.cell)) && (c.other == d.other || isNeighbour(c.other, d.other)))
+            {
+                roots[find(static_cast<int>(j))] = find(static_cast<int>(i));
+            }
+        }
+    }
+    std::vector<std::vector<std::size_t>> segments;
+    std::vector<int> segmentIndices(crossings.size(), -1);
+    for (std::size_t i = 0; i < crossings.size(); i++)
+    {
+        int root = find(static_cast<int>(i));
+        if (segmentIndices[root] < 0)
+        {
+            segmentIndices[root] = static_cast<int>(segments.size());
+            segments.push_back(std::vector<std::size_t>());
+        }
+        segments[segmentIndices[root]].push_back(i);
+    }
+
+    // One transition in the middle of each segment, long segments get one at each end instead
+    // The straightest crossing is taken at a position
+    std::vector<std::pair<int, int>> transitions;
+    for (std::size_t i = 0; i < segments.size(); i++)
+    {
+        const std::vector<std::size_t>& segment = segments[i];
+        const int begin = crossings[segment.front()].along;
+        const int end = crossings[segment.back()].along;
+        const int middle = (begin + end) / 2;
+        for (std::size_t j = 0; j < segment.size(); j++)
+        {
+            const Crossing& c = crossings[segment[j]];
+            bool taken = (end - begin + 1 >= 6) ? (j == 0 || (c.along == end && crossings[segment[j - 1]].along != end)) : (c.along >= middle);
+            if (taken)
+            {
+                transitions.push_back(std::make_pair(c.cell, c.other));
+                if (end - begin + 1 < 6)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // The links of both clusters use the cost of entering the other cell, a cell can change its cost and stay walkable
+    std::vector<std::pair<float, float>> costs(transitions.size());
+    for (std::size_t i = 0; i < transitions.size(); i++)
+    {
+        sf::Vector2i cell(transitions[i].first % width, transitions[i].first / width);
+        sf::Vector2i other(transitions[i].second % width, transitions[i].second / width);
+        costs[i] = std::make_pair(mPathfinder.getPathCost({cell, other}), mPathfinder.getPathCost({other, cell}));
+    }
+    bool changed = (transitions != border.transitions || costs != border.costs);
+    border.transitions.swap(transitions);
+    border.costs.swap(costs);
+    return changed;
+}
+
+void HierarchicalPathfinder::collectNodes(std::size_t index)
+{
+    Cluster& cluster = mClusters[index];
+    cluster.nodes.clear();
+    const Border* borders[6];
+    bool first[6];
+    std::size_t count = getBorders(index, borders, first);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (std::size_t j = 0; j < borders[i]->transitions.size(); j++)
+        {
+            const std::pair<int, int>& t = borders[i]->transitions[j];
+            int cell = (first[i]) ? t.first : t.second;
+            if (getClusterIndex(cell) == static_cast<int>(index))
+            {
+                cluster.nodes.push_back(cell);
+            }
+        }
+    }
+    std::sort(cluster.nodes.begin(), cluster.nodes.end());
+    cluster.nodes.erase(std::unique(cluster.nodes.begin(), cluster.nodes.end()), cluster.nodes.end());
+}
+
+void HierarchicalPathfinder::buildCluster(std::size_t index)
+{
+    Cluster& cluster = mClusters[index];
+    cluster.dirty = false;
+    const std::size_t count = cluster.nodes.size();
+
+    // Costs and paths from each node to the others, searched on the steps between the cells of the cluster only
+    const sf::IntRect& bounds = cluster.bounds;
+    const int width = mSize.x;
+    const int cells = bounds.width * bounds.height;
+    const std::vector<unsigned char>& grid = mGrid.getCosts();
+    std::vector<int> firstEdges(cells + 1, 0);
+    std::vector<std::pair<int, float>> edges;
+    int neighbours[8];
+    float steps[8];
+    for (int i = 0; i < cells; i++)
+    {
+        firstEdges[i] = static_cast<int>(edges.size());
+        const int cell = bounds.left + i % bounds.width + (bounds.top + i / bounds.width) * width;
+        if (grid[cell] == 0)
+        {
+            continue;
+        }
+        const std::size_t neighbourCount = mPathfinder.getNeighbours(cell, neighbours, steps);
+        for (std::size_t k = 0; k < neighbourCount; k++)
+        {
+            const int x = neighbours[k] % width - bounds.left;
+            const int y = neighbours[k] / width - bounds.top;
+            if (0 <= x && x < bounds.width && 0 <= y && y < bounds.height)
+            {
+                edges.push_back(std::make_pair(x + y * bounds.width, steps[k] * grid[neighbours[k]]));
+            }
+        }
+    }
+    firstEdges[cells] = static_cast<int>(edges.size());
+
+    std::vector<int> locals(count);
+    std::vector<unsigned char> wanted(cells, 0);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        locals[i] = cluster.nodes[i] % width - bounds.left + (cluster.nodes[i] / width - bounds.top) * bounds.width;
+        wanted[locals[i]] = 1;
+    }
+    const float infinity = std::numeric_limits<float>::infinity();
+    const bool diagonal = mPathfinder.allowsDiagonal();
+    cluster.costs.assign(count * count, infinity);
+    cluster.steps.clear();
+    cluster.routes.assign(count * count + 1, 0);
+    std::vector<float> costs(cells);
+    std::vector<int> parents(cells);
+    std::vector<unsigned char> closed(cells);
+    std::vector<std::pair<float, int>> open;
+    std::vector<int> trail;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::fill(costs.begin(), costs.end(), infinity);
+        std::fill(closed.begin(), closed.end(), 0);
+        costs[locals[i]] = 0.f;
+        parents[locals[i]] = -1;
+        open.assign(1, std::make_pair(0.f, locals[i]));
+        std::size_t remaining = count;
+        while (remaining > 0 && !open.empty())
+        {
+            std::pop_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+            const int cell = open.back().second;
+            open.pop_back();
+            if (closed[cell] != 0)
+            {
+                continue;
+            }
+            closed[cell] = 1;
+            remaining -= wanted[cell];
+            for (int e = firstEdges[cell]; e < firstEdges[cell + 1]; e++)
+            {
+                const int next = edges[e].first;
+                const float cost = costs[cell] + edges[e].second;
+                if (closed[next] == 0 && cost < costs[next])
+                {
+                    costs[next] = cost;
+                    parents[next] = cell;
+                    open.push_back(std::make_pair(cost, next));
+                    std::push_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+                }
+            }
+        }
+        for (std::size_t j = 0; j < count; j++)
+        {
+            cluster.routes[i * count + j] = static_cast<unsigned int>(cluster.steps.size());
+            if (closed[locals[j]] == 0)
+            {
+                continue;
+            }
+            cluster.costs[i * count + j] = costs[locals[j]];
+            trail.clear();
+            for (int cell = locals[j]; cell >= 0; cell = parents[cell])
+            {
+                trail.push_back(cell);
+            }
+            for (std::size_t k = trail.size() - 1; k-- > 0;)
+            {
+                sf::Vector2i from(bounds.left + trail[k + 1] % bounds.width, bounds.top + trail[k + 1] / bounds.width);
+                sf::Vector2i to(bounds.left + trail[k] % bounds.width, bounds.top + trail[k] / bounds.width);
+                Span<sf::Vector2i> offsets = mGeometry.getNeighbourOffsets(from, diagonal);
+                unsigned char step = 0;
+                while (from + offsets[step] != to)
+                {
+                    step++;
+                }
+                cluster.steps.push_back(step);
+            }
+        }
+    }
+    cluster.routes[count * count] = static_cast<unsigned int>(cluster.steps.size());
+
+    // Steps go both ways, a node reaching another one before it joins its group
+    cluster.groups.assign(count, 0);
+    int groups = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::size_t j = 0;
+        while (j < i && cluster.costs[j * count + i] == infinity)
+        {
+            j++;
+        }
+        cluster.groups[i] = (j < i) ? cluster.groups[j] : groups++;
+    }
+}
+
+void HierarchicalPathfinder::buildLinks(std::size_t index)
+{
+    Cluster& cluster = mClusters[index];
+    cluster.links.assign(cluster.nodes.size(), std::vector<Link>());
+    cluster.joins.clear();
+    const Border* borders[6];
+    bool first[6];
+    std::size_t count = getBorders(index, borders, first);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (std::size_t j = 0; j < borders[i]->transitions.size(); j++)
+        {
+            const std::pair<int, int>& t = borders[i]->transitions[j];
+            int cell = (first[i]) ? t.first : t.second;
+            int other = (first[i]) ? t.second : t.first;
+            float cost = (first[i]) ? borders[i]->costs[j].first : borders[i]->costs[j].second;
+            if (getClusterIndex(cell) != static_cast<int>(index) || cost < 0.f)
+            {
+                continue;
+            }
+            Link link = {getClusterIndex(other), 0, cost};
+            link.node = getNodeIndex(mClusters[link.cluster], other);
+            int node = getNodeIndex(cluster, cell);
+            if (node >= 0 && link.node >= 0)
+            {
+                cluster.links[node].push_back(link);
+                Join join = {cluster.groups[node], link.cluster, mClusters[link.cluster].groups[link.node]};
+                cluster.joins.push_back(join);
+            }
+        }
+    }
+    std::sort(cluster.joins.begin(), cluster.joins.end(), [](Join const& a, Join const& b)
+    {
+        return std::make_pair(a.group, std::make_pair(a.cluster, a.other)) < std::make_pair(b.group, std::make_pair(b.cluster, b.other));
+    });
+    cluster.joins.erase(std::unique(cluster.joins.begin(), cluster.joins.end(), [](Join const& a, Join const& b)
+    {
+        return a.group == b.group && a.cluster == b.cluster && a.other == b.other;
+    }), cluster.joins.end());
+}
+
+void HierarchicalPathfinder::appendRoute(Cluster const& cluster, int from, int to, std::vector<sf::Vector2i>& path) const
+{
+    const std::size_t route = static_cast<std::size_t>(from) * cluster.nodes.size() + to;
+    const bool diagonal = mPathfinder.allowsDiagonal();
+    sf::Vector2i coords(cluster.nodes[from] % mSize.x, cluster.nodes[from] / mSize.x);
+    for (unsigned int i = cluster.routes[route]; i < cluster.routes[route + 1]; i++)
+    {
+        coords += mGeometry.getNeighbourOffsets(coords, diagonal)[cluster.steps[i]];
+        path.push_back(coords);
+    }
+}
+
+bool HierarchicalPathfinder::isNeighbour(int cell, int other) const
+{
+    int neighbours[8];
+    float steps[8];
+    std::size_t count = mPathfinder.getNeighbours(cell, neighbours, steps);
+    return std::find(neighbours, neighbours + count, other) != neighbours + count;
+}
+
+} // namespace tmx
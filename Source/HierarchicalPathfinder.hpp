@@ -0,0 +1,103 @@
+#ifndef TMX_HIERARCHICALPATHFINDER_HPP
+#define TMX_HIERARCHICALPATHFINDER_HPP
+
+#include "Pathfinder.hpp"
+
+namespace tmx
+{
+
+// HPA* : the grid is cut in square clusters linked by transitions on their borders
+// Each connected segment of crossings between two clusters gets a transition, the crossings follow the map orientation
+// The costs and paths between the transitions of a cluster are cached, a search runs on that small graph and reuses them
+// Cost changes only recompute the borders and the clusters around the changed cells
+// The search on the graph overestimates a little to stay near the line to the goal, the paths are close to optimal, not always optimal
+class HierarchicalPathfinder : public CostGrid::Listener
+{
+    public:
+        HierarchicalPathfinder(CostGrid& grid, unsigned int clusterSize = 16, bool diagonal = true);
+        ~HierarchicalPathfinder();
+
+        bool findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path);
+
+        // Solves every query on the default thread pool
+        void findPaths(std::vector<Pathfinder::Query>& queries);
+
+        // Recomputes what the cost changes made dirty, done by the searches too
+        void update();
+
+        std::size_t getNodeCount() const;
+        unsigned int getClusterSize() const;
+        const Pathfinder& getPathfinder() const;
+
+        void onCostChanged(CostGrid& grid, sf::Vector2i const& coords, unsigned char previous, unsigned char cost);
+
+    private:
+        // Crossings from the cells of a cluster to the cells right of it (vertical) or below it (horizontal)
+        // The cells below can be in the clusters below left and below right too, where the corners meet
+        struct Border
+        {
+            std::vector<std::pair<int, int>> transitions; // Cell of the cluster, cell of the other one
+            std::vector<std::pair<float, float>> costs; // Crossing each transition forward and back
+            bool dirty;
+        };
+
+        struct Link
+        {
+            int cluster;
+            int node;
+            float cost;
+        };
+
+        struct Join
+        {
+            int group;
+            int cluster;
+            int other; // Group in the other cluster
+        };
+
+        struct Cluster
+        {
+            sf::IntRect bounds;
+            std::vector<int> nodes; // Sorted cells
+            std::vector<std::vector<Link>> links; // Transitions to other clusters, per node
+            std::vector<float> costs; // Node to node, nodes.size() * nodes.size()
+            std::vector<unsigned char> steps; // Paths between the nodes, as indices in the neighbour offsets of the geometry
+            std::vector<unsigned int> routes; // Start of the path from node i to node j in steps, nodes.size() * nodes.size() + 1
+            std::vector<int> groups; // Nodes reaching each other inside the cluster share a group
+            std::vector<Join> joins; // Groups of the other clusters linked to the ones of this cluster, once each
+            int first; // Index of the first node in the whole graph
+            int firstGroup;
+            bool dirty;
+        };
+
+        bool search(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path) const;
+        int getClusterIndex(int cell) const;
+        int getNodeIndex(Cluster const& cluster, int cell) const;
+        int getNodeCell(int node) const;
+        std::size_t getBorders(std::size_t index, const Border** borders, bool* first) const;
+        bool buildBorder(std::size_t index, bool vertical);
+        void collectNodes(std::size_t index);
+        void buildCluster(std::size_t index);
+        void buildLinks(std::size_t index);
+        void appendRoute(Cluster const& cluster, int from, int to, std::vector<sf::Vector2i>& path) const;
+        bool isNeighbour(int cell, int other) const;
+
+    private:
+        CostGrid& mGrid;
+        Pathfinder mPathfinder;
+        MapGeometry mGeometry;
+        sf::Vector2i mReach; // Farthest neighbour along each axis
+        int mClusterSize;
+        sf::Vector2i mSize;
+        sf::Vector2i mClusterCount;
+        std::vector<Cluster> mClusters;
+        std::vector<Border> mVerticalBorders;
+        std::vector<Border> mHorizontalBorders;
+        std::vector<int> mNodeClusters; // Cluster of each node of the whole graph
+        std::vector<int> mComponents; // Component of each group of the whole graph, named by one of its groups
+        bool mDirty;
+};
+
+} // namespace tmx
+
+#endif // TMX_HIERARCHICALPATHFINDER_HPP
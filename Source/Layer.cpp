@@ -2,13 +2,59 @@
 #include "Map.hpp"
 #include "Tileset.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) && !defined(TMX_NO_SIMD)
+    #define TMX_LAYER_SIMD
+    #include <emmintrin.h>
+#endif
+
 namespace tmx
 {
 
+namespace
+{
+
+// First index from begin to end whose tile is (equal) or is not (!equal) value, end if none
+// Blocks of four tiles without any are skipped with one compare
+std::size_t findTile(const unsigned int* tiles, std::size_t begin, std::size_t end, unsigned int value, bool equal)
+{
+    #ifdef TMX_LAYER_SIMD
+    const __m128i values = _mm_set1_epi32(static_cast<int>(value));
+    const int none = (equal) ? 0 : 0xffff;
+    for (; begin + 4 <= end; begin += 4)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tiles + begin));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(block, values)) != none)
+        {
+            break;
+        }
+    }
+    #endif
+    while (begin < end && (tiles[begin] == value) != equal)
+    {
+        begin++;
+    }
+    return begin;
+}
+
+} // namespace
+
 Layer::Layer(Map& map)
 : mMap(map)
 , mTileset(nullptr)
 , mVertices(sf::Triangles)
+, mTiles()
+, mTints()
+, mListeners()
+, mLodThreshold(4.f)
+, mLodPixels()
+, mLodTexture()
+, mLodDirtyBegin(0)
+, mLodDirtyEnd(0)
+, mLeft(false)
+, mUp(false)
 , mEncoding("")
 , mCompression("")
 {
@@ -19,6 +65,11 @@ LayerType Layer::getLayerType() const
     return tmx::ELayer;
 }
 
+Map& Layer::getMap() const
+{
+    return mMap;
+}
+
 bool Layer::loadFromNode(pugi::xml_node const& layer)
 {
     if (!layer)
@@ -46,8 +97,9 @@ bool Layer::loadFromNode(pugi::xml_node const& layer)
         }
     }
     update();
-    sf::Vector2i coords;
     sf::Vector2i size = mMap.getMapSize();
+    std::vector<unsigned int> tiles;
+    tiles.reserve(size.x * size.y);
     if (mEncoding == "base64")
     {
         std::string data;
@@ -75,12 +127,7 @@ bool Layer::loadFromNode(pugi::xml_node const& layer)
         {
             unsigned int gid = byteVector[i] | byteVector[i+1] << 8 | byteVector[i+2] << 16 | byteVector[i+3] << 24;
             detail::readFlip(gid);
-            setTileId(coords, gid);
-            coords.x = (coords.x + 1) % size.x;
-            if (coords.x == 0)
-            {
-                coords.y++;
-            }
+            tiles.push_back(gid);
         }
     }
     else if (mEncoding == "csv")
@@ -95,12 +142,7 @@ bool Layer::loadFromNode(pugi::xml_node const& layer)
                 data.ignore();
             }
             detail::readFlip(gid);
-            setTileId(coords, gid);
-            coords.x = (coords.x + 1) % size.x;
-            if (coords.x == 0)
-            {
-                coords.y++;
-            }
+            tiles.push_back(gid);
         }
     }
     else
@@ -109,14 +151,11 @@ bool Layer::loadFromNode(pugi::xml_node const& layer)
         {
             unsigned int gid = tile.attribute("gid").as_uint();
             detail::readFlip(gid);
-            setTileId(coords, gid);
-            coords.x = (coords.x + 1) % size.x;
-            if (coords.x == 0)
-            {
-                coords.y++;
-            }
+            tiles.push_back(gid);
         }
     }
+    tiles.resize(size.x * size.y, 0);
+    paste(sf::Vector2i(), size, tiles);
     return true;
 }
 
@@ -204,50 +243,369 @@ void Layer::saveToNode(pugi::xml_node& layer)
     }
 }
 
-sf::Vector2i Layer::worldToCoords(sf::Vector2f const& world)
+sf::Vector2i Layer::worldToCoords(sf::Vector2f const& world) const
 {
     return mMap.worldToCoords(world - mOffset);
 }
 
+sf::Vector2f Layer::coordsToWorld(sf::Vector2i const& coords) const
+{
+    return mMap.coordsToWorld(coords) + mOffset;
+}
+
 void Layer::setTileId(sf::Vector2i coords, unsigned int id)
 {
-    if (0 <= coords.x && coords.x < mMap.getMapSize().x && 0 <= coords.y && coords.y < mMap.getMapSize().y)
+    sf::Vector2i size = mMap.getMapSize();
+    if (0 <= coords.x && coords.x < size.x && 0 <= coords.y && coords.y < size.y)
     {
-        sf::Vertex* tri = getVertex(coords);
-        if (id != 0 && tri != nullptr)
+        if (id != 0 && mTileset == nullptr)
         {
-            if (mTileset == nullptr)
+            mTileset = mMap.getTileset(id);
+            if (mTileset != nullptr)
             {
-                mTileset = mMap.getTileset(id);
                 update();
             }
-            if (mTileset != nullptr)
+        }
+        if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+        {
+            update();
+        }
+        std::size_t cell = coords.x + coords.y * size.x;
+        unsigned int previous = mTiles[cell];
+        mTiles[cell] = id;
+        updateCell(getVertex(coords), cell, previous);
+        if (previous != id)
+        {
+            for (std::size_t i = 0; i < mListeners.size(); i++)
             {
-                sf::Vector2i pos = mTileset->toPos(id);
-                sf::Vector2i size = mTileset->getTileSize();
-                tri[0].texCoords = sf::Vector2f(pos.x, pos.y);
-                tri[1].texCoords = sf::Vector2f(pos.x + size.x, pos.y);
-                tri[2].texCoords = sf::Vector2f(pos.x + size.x, pos.y + size.y);
-                tri[4].texCoords = sf::Vector2f(pos.x, pos.y + size.y);
-                tri[3].texCoords = tri[2].texCoords;
-                tri[5].texCoords = tri[0].texCoords;
+                mListeners[i]->onTileChanged(*this, coords, previous, id);
             }
         }
     }
 }
 
-unsigned int Layer::getTileId(sf::Vector2i coords)
+unsigned int Layer::getTileId(sf::Vector2i coords) const
+{
+    sf::Vector2i size = mMap.getMapSize();
+    std::size_t index = coords.x + coords.y * size.x;
+    if (0 <= coords.x && coords.x < size.x && 0 <= coords.y && coords.y < size.y && index < mTiles.size())
+    {
+        return mTiles[index];
+    }
+    return 0;
+}
+
+const std::vector<unsigned int>& Layer::getTileIds() const
+{
+    return mTiles;
+}
+
+Tileset* Layer::getTileset() const
+{
+    return mTileset;
+}
+
+std::size_t Layer::fill(sf::IntRect const& area, unsigned int id)
+{
+    sf::Vector2i size = mMap.getMapSize();
+    sf::IntRect bounds;
+    if (!area.intersects(sf::IntRect(0, 0, size.x, size.y), bounds))
+    {
+        return 0;
+    }
+    if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        update();
+    }
+    std::vector<std::size_t> cells;
+    std::vector<unsigned int> previous;
+    for (int y = bounds.top; y < bounds.top + bounds.height; y++)
+    {
+        std::size_t end = bounds.left + bounds.width + y * size.x;
+        for (std::size_t i = findTile(mTiles.data(), bounds.left + y * size.x, end, id, false); i < end; i = findTile(mTiles.data(), i + 1, end, id, false))
+        {
+            cells.push_back(i);
+            previous.push_back(mTiles[i]);
+            mTiles[i] = id;
+        }
+    }
+    updateCells(cells, previous);
+    return cells.size();
+}
+
+std::size_t Layer::replace(unsigned int previous, unsigned int id)
+{
+    sf::Vector2i size = mMap.getMapSize();
+    if (previous == id || size.x <= 0 || size.y <= 0)
+    {
+        return 0;
+    }
+    if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        update();
+    }
+    std::vector<std::size_t> cells;
+    for (std::size_t i = findTile(mTiles.data(), 0, mTiles.size(), previous, true); i < mTiles.size(); i = findTile(mTiles.data(), i + 1, mTiles.size(), previous, true))
+    {
+        cells.push_back(i);
+        mTiles[i] = id;
+    }
+    updateCells(cells, std::vector<unsigned int>(cells.size(), previous));
+    return cells.size();
+}
+
+std::size_t Layer::floodFill(sf::Vector2i const& coords, unsigned int id)
+{
+    sf::Vector2i size = mMap.getMapSize();
+    if (coords.x < 0 || coords.x >= size.x || coords.y < 0 || coords.y >= size.y)
+    {
+        return 0;
+    }
+    if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        update();
+    }
+    unsigned int target = mTiles[coords.x + coords.y * size.x];
+    if (target == id)
+    {
+        return 0;
+    }
+
+    // Cells are written when they are found, so the new id marks the visited ones
+    const MapGeometry& geometry = mMap.getGeometry();
+    std::vector<std::size_t> cells(1, coords.x + coords.y * size.x);
+    mTiles[cells[0]] = id;
+    for (std::size_t i = 0; i < cells.size(); i++)
+    {
+        sf::Vector2i current(static_cast<int>(cells[i] % size.x), static_cast<int>(cells[i] / size.x));
+        geometry.forEachNeighbour(current, false, [&](sf::Vector2i const& neighbour)
+        {
+            if (0 <= neighbour.x && neighbour.x < size.x && 0 <= neighbour.y && neighbour.y < size.y)
+            {
+                std::size_t cell = neighbour.x + neighbour.y * size.x;
+                if (mTiles[cell] == target)
+                {
+                    mTiles[cell] = id;
+                    cells.push_back(cell);
+                }
+            }
+        });
+    }
+    updateCells(cells, std::vector<unsigned int>(cells.size(), target));
+    return cells.size();
+}
+
+void Layer::copy(sf::IntRect const& area, std::vector<unsigned int>& tiles) const
+{
+    sf::Vector2i size = mMap.getMapSize();
+    tiles.assign(std::max(area.width, 0) * std::max(area.height, 0), 0);
+    sf::IntRect bounds;
+    if (mTiles.size() == static_cast<std::size_t>(size.x * size.y) && area.intersects(sf::IntRect(0, 0, size.x, size.y), bounds))
+    {
+        for (int y = bounds.top; y < bounds.top + bounds.height; y++)
+        {
+            std::copy(mTiles.begin() + bounds.left + y * size.x, mTiles.begin() + bounds.left + bounds.width + y * size.x,
+                      tiles.begin() + (bounds.left - area.left) + (y - area.top) * area.width);
+        }
+    }
+}
+
+std::size_t Layer::paste(sf::Vector2i const& coords, sf::Vector2i const& size, std::vector<unsigned int> const& tiles, bool skipEmpty)
+{
+    sf::Vector2i mapSize = mMap.getMapSize();
+    sf::IntRect bounds;
+    if (tiles.size() < static_cast<std::size_t>(std::max(size.x, 0) * std::max(size.y, 0))
+    || !sf::IntRect(coords, size).intersects(sf::IntRect(0, 0, mapSize.x, mapSize.y), bounds))
+    {
+        return 0;
+    }
+    if (mTiles.size() != static_cast<std::size_t>(mapSize.x * mapSize.y))
+    {
+        update();
+    }
+    std::vector<std::size_t> cells;
+    std::vector<unsigned int> previous;
+    for (int y = bounds.top; y < bounds.top + bounds.height; y++)
+    {
+        unsigned int* row = &mTiles[bounds.left + y * mapSize.x];
+        const unsigned int* source = &tiles[(bounds.left - coords.x) + (y - coords.y) * size.x];
+        // Rows which are already the same are skipped with one compare
+        if (!skipEmpty && std::equal(source, source + bounds.width, row))
+        {
+            continue;
+        }
+        for (int x = 0; x < bounds.width; x++)
+        {
+            if (row[x] != source[x] && (source[x] != 0 || !skipEmpty))
+            {
+                cells.push_back(bounds.left + x + y * mapSize.x);
+                previous.push_back(row[x]);
+                row[x] = source[x];
+            }
+        }
+    }
+    updateCells(cells, previous);
+    return cells.size();
+}
+
+std::size_t Layer::setTileIds(std::vector<sf::Vector2i> const& coords, std::vector<unsigned int> const& ids)
+{
+    sf::Vector2i size = mMap.getMapSize();
+    if (coords.empty() || coords.size() != ids.size())
+    {
+        return 0;
+    }
+    if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        update();
+    }
+    std::vector<std::size_t> cells;
+    std::vector<unsigned int> previous;
+    for (std::size_t i = 0; i < coords.size(); i++)
+    {
+        if (0 <= coords[i].x && coords[i].x < size.x && 0 <= coords[i].y && coords[i].y < size.y)
+        {
+            std::size_t cell = coords[i].x + coords[i].y * size.x;
+            if (mTiles[cell] != ids[i])
+            {
+                cells.push_back(cell);
+                previous.push_back(mTiles[cell]);
+                mTiles[cell] = ids[i];
+            }
+        }
+    }
+    updateCells(cells, previous);
+    return cells.size();
+}
+
+void Layer::setTileColor(sf::Vector2i coords, sf::Color const& color)
 {
     sf::Vector2i size = mMap.getMapSize();
     if (0 <= coords.x && coords.x < size.x && 0 <= coords.y && coords.y < size.y)
     {
+        if (mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+        {
+            update();
+        }
+        std::size_t cell = coords.x + coords.y * size.x;
+        if (mTints.size() != mTiles.size())
+        {
+            // Tints are only stored once a cell is tinted
+            mTints.assign(mTiles.size(), sf::Color::White);
+        }
+        mTints[cell] = color;
         sf::Vertex* tri = getVertex(coords);
-        if (tri[0].texCoords != tri[2].texCoords && mTileset != nullptr)
+        sf::Color vertexColor = getVertexColor(cell);
+        for (std::size_t i = 0; i < 6; i++)
+        {
+            tri[i].color = vertexColor;
+        }
+        if (!mLodPixels.empty())
         {
-            return mTileset->toId(sf::Vector2i(tri->texCoords.x, tri->texCoords.y));
+            setLodPixel(cell);
         }
     }
-    return 0;
+}
+
+sf::Color Layer::getTileColor(sf::Vector2i coords) const
+{
+    sf::Vector2i size = mMap.getMapSize();
+    std::size_t cell = coords.x + coords.y * size.x;
+    if (0 <= coords.x && coords.x < size.x && 0 <= coords.y && coords.y < size.y && cell < mTints.size())
+    {
+        return mTints[cell];
+    }
+    return sf::Color::White;
+}
+
+void Layer::setLodThreshold(float pixels)
+{
+    mLodThreshold = pixels;
+}
+
+float Layer::getLodThreshold() const
+{
+    return mLodThreshold;
+}
+
+const sf::Texture& Layer::getColorTexture() const
+{
+    ensureLodUpdated();
+    return mLodTexture;
+}
+
+void Layer::getShapes(sf::IntRect const& area, std::vector<ShapeInstance>& instances) const
+{
+    if (mTileset == nullptr)
+    {
+        return;
+    }
+    sf::Vector2i size = mMap.getMapSize();
+    sf::IntRect cells = (area.width > 0 && area.height > 0) ? area : sf::IntRect(0, 0, size.x, size.y);
+    sf::IntRect bounds;
+    if (!cells.intersects(sf::IntRect(0, 0, size.x, size.y), bounds) || mTiles.size() != static_cast<std::size_t>(size.x * size.y))
+    {
+        return;
+    }
+
+    // Shaped tiles are resolved once per gid, not once per cell
+    std::unordered_map<unsigned int, const Tileset::Tile*> tiles;
+    sf::Vector2f offset = mOffset + mMap.getMapOffset() + mTileset->getTileOffset();
+    sf::Vector2i coords;
+    for (coords.y = bounds.top; coords.y < bounds.top + bounds.height; coords.y++)
+    {
+        for (coords.x = bounds.left; coords.x < bounds.left + bounds.width; coords.x++)
+        {
+            unsigned int gid = mTiles[coords.x + coords.y * size.x];
+            if (gid == 0)
+            {
+                continue;
+            }
+            auto found = tiles.find(gid);
+            if (found == tiles.end())
+            {
+                const Tileset::Tile* tile = mTileset->getTileByGid(gid);
+                found = tiles.insert(std::make_pair(gid, (tile != nullptr && tile->shapes() > 0) ? tile : nullptr)).first;
+            }
+            const Tileset::Tile* tile = found->second;
+            if (tile != nullptr)
+            {
+                ShapeInstance instance;
+                instance.offset = mVertices[getVertexIndex(coords)].position + offset;
+                instance.coords = coords;
+                for (std::size_t i = 0; i < tile->shapes(); i++)
+                {
+                    instance.shape = &tile->getShape(i);
+                    instances.push_back(instance);
+                }
+            }
+        }
+    }
+}
+
+Layer::Listener::~Listener()
+{
+}
+
+void Layer::Listener::onBatchBegin(Layer& layer)
+{
+}
+
+void Layer::Listener::onBatchEnd(Layer& layer)
+{
+}
+
+void Layer::addListener(Listener* listener)
+{
+    if (listener != nullptr && std::find(mListeners.begin(), mListeners.end(), listener) == mListeners.end())
+    {
+        mListeners.push_back(listener);
+    }
+}
+
+void Layer::removeListener(Listener* listener)
+{
+    mListeners.erase(std::remove(mListeners.begin(), mListeners.end(), listener), mListeners.end());
 }
 
 void Layer::draw(sf::RenderTarget& target, sf::RenderStates states) const
@@ -260,14 +618,22 @@ void Layer::draw(sf::RenderTarget& target, sf::RenderStates states) const
             states.transform.translate(mTileset->getTileOffset());
             states.texture = &mTileset->getTexture();
         }
-        target.draw(mVertices, states);
+        if (useLod(target, states.transform))
+        {
+            ensureLodUpdated();
+            states.texture = &mLodTexture;
+            target.draw(mLodQuad, 6, sf::Triangles, states);
+        }
+        else
+        {
+            target.draw(mVertices, states);
+        }
     }
 }
 
 bool Layer::loadFromCode(std::string const& code)
 {
     sf::Vector2i size = mMap.getMapSize();
-    sf::Vector2i coords;
     std::string data;
     std::stringstream ss;
     ss << code;
@@ -282,15 +648,14 @@ bool Layer::loadFromCode(std::string const& code)
     {
         byteVector.push_back(*i);
     }
+    std::vector<unsigned int> tiles;
+    tiles.reserve(size.x * size.y);
     for (std::size_t i = 0; i < byteVector.size() - 3; i += 4)
     {
-        setTileId(coords, byteVector[i] | byteVector[i+1] << 8 | byteVector[i+2] << 16 | byteVector[i+3] << 24);
-        coords.x = (coords.x + 1) % size.x;
-        if (coords.x == 0)
-        {
-            coords.y++;
-        }
+        tiles.push_back(byteVector[i] | byteVector[i+1] << 8 | byteVector[i+2] << 16 | byteVector[i+3] << 24);
     }
+    tiles.resize(size.x * size.y, 0);
+    paste(sf::Vector2i(), size, tiles);
     return true;
 }
 
@@ -340,9 +705,8 @@ void Layer::setCompression(std::string const& compression)
 
 void Layer::update()
 {
-    std::string orientation = mMap.getOrientation();
+    const MapGeometry& geometry = mMap.getGeometry();
     sf::Vector2u size = static_cast<sf::Vector2u>(mMap.getMapSize());
-    sf::Vector2f tileSize = static_cast<sf::Vector2f>(mMap.getTileSize());
     sf::Vector2f texSize;
     if (mTileset != nullptr)
     {
@@ -350,84 +714,24 @@ void Layer::update()
     }
     else
     {
-        texSize = tileSize;
+        texSize = static_cast<sf::Vector2f>(mMap.getTileSize());
     }
-    std::string axis = mMap.getStaggerAxis();
-    unsigned int index = (mMap.getStaggerIndex() == "odd") ? 0 : 1;
 
     mVertices.resize(size.x * size.y * 6);
+    mTiles.resize(size.x * size.y, 0);
+    if (!mTints.empty())
+    {
+        mTints.resize(mTiles.size(), sf::Color::White);
+    }
+    const std::string& order = mMap.getRenderOrder();
+    mLeft = (order == "left-down" || order == "left-up");
+    mUp = (order == "right-up" || order == "left-up");
     for (std::size_t i = 0; i < size.x; ++i)
     {
         for (std::size_t j = 0; j < size.y; ++j)
         {
-            sf::Vector2f pos;
-            if (orientation == "orthogonal")
-            {
-                pos.x = i * tileSize.x;
-                pos.y = j * tileSize.y;
-            }
-            else if (orientation == "isometric")
-            {
-                pos.x = ((float)i-(float)j) * tileSize.x * 0.5f;
-                pos.y = (i+j) * tileSize.y * 0.5f;
-            }
-            else if (orientation == "staggered")
-            {
-                if (axis == "y")
-                {
-                    if ((j % 2) == index)
-                    {
-                        pos.x = i * tileSize.x;
-                    }
-                    else
-                    {
-                        pos.x = (i + 0.5f) * tileSize.x;
-                    }
-                    pos.y = j * tileSize.y * 0.5f;
-                }
-                else
-                {
-                    if ((i % 2) == index)
-                    {
-                        pos.y = j * tileSize.y;
-                    }
-                    else
-                    {
-                        pos.y = (j + 0.5f) * tileSize.y;
-                    }
-                    pos.x = i * tileSize.x * 0.5f;
-                }
-            }
-            else if (orientation == "hexagonal")
-            {
-                float hexSide = static_cast<float>(mMap.getHexSideLength());
-                if (axis == "y")
-                {
-                    if ((j % 2) == index)
-                    {
-                        pos.x = i * tileSize.x;
-                    }
-                    else
-                    {
-                        pos.x = (i + 0.5f) * tileSize.x;
-                    }
-                    pos.y = j * ((tileSize.y - hexSide) * 0.5f + hexSide);
-                }
-                else
-                {
-                    if ((i % 2) == index)
-                    {
-                        pos.y = j * tileSize.y;
-                    }
-                    else
-                    {
-                        pos.y = (j + 0.5f) * tileSize.y;
-                    }
-                    pos.x = i * ((tileSize.x - hexSide ) * 0.5f + hexSide);
-                }
-            }
-
-            sf::Vertex* tri = getVertex(sf::Vector2i(i, j));
+            sf::Vector2f pos = geometry.coordsToWorld(sf::Vector2i(i, j));
+            sf::Vertex* tri = &mVertices[getVertexIndex(sf::Vector2i(i, j))];
             if (tri != nullptr)
             {
                 tri[0].position = sf::Vector2f(pos.x, pos.y);
@@ -436,37 +740,233 @@ void Layer::update()
                 tri[4].position = sf::Vector2f(pos.x, pos.y + texSize.y);
                 tri[3].position = tri[2].position;
                 tri[5].position = tri[0].position;
-                sf::Color color = sf::Color(255,255,255,static_cast<unsigned char>(255.f * mOpacity));
+                sf::Color color = getVertexColor(i + j * size.x);
                 for (std::size_t i = 0; i < 6; i++)
                 {
                     tri[i].color = color;
                 }
+                // The cells may have moved in the vertices, with a new render order
+                updateCell(tri, i + j * size.x, mTiles[i + j * size.x]);
+            }
+        }
+    }
+
+    // Quad of the color image : exact for orthogonal and isometric maps, whose cell corners map affinely to the world,
+    // and the bounds of the map for staggered and hexagonal ones, where the half cell shifts are below the threshold anyway
+    sf::Vector2f corners[4];
+    sf::Vector2f cells = static_cast<sf::Vector2f>(size);
+    if (geometry.getOrientation() == MapGeometry::EOrthogonal || geometry.getOrientation() == MapGeometry::EIsometric)
+    {
+        sf::Vector2f origin;
+        if (geometry.getOrientation() == MapGeometry::EIsometric)
+        {
+            origin.x = geometry.getTileSize().x * 0.5f;
+        }
+        corners[0] = origin + geometry.coordsToWorld(sf::Vector2i(0, 0));
+        corners[1] = origin + geometry.coordsToWorld(sf::Vector2i(size.x, 0));
+        corners[2] = origin + geometry.coordsToWorld(sf::Vector2i(size));
+        corners[3] = origin + geometry.coordsToWorld(sf::Vector2i(0, size.y));
+    }
+    else if (size.x > 0 && size.y > 0)
+    {
+        sf::Vector2f min = geometry.coordsToWorld(sf::Vector2i(0, 0));
+        sf::Vector2f max = min + texSize;
+        for (unsigned int i = 0; i < size.x; i++)
+        {
+            for (unsigned int j = 0; j < size.y; j += (i == 0 || i + 1 == size.x) ? 1 : std::max(size.y - 1, 1u))
+            {
+                sf::Vector2f pos = geometry.coordsToWorld(sf::Vector2i(i, j));
+                min.x = std::min(min.x, pos.x);
+                min.y = std::min(min.y, pos.y);
+                max.x = std::max(max.x, pos.x + texSize.x);
+                max.y = std::max(max.y, pos.y + texSize.y);
             }
         }
+        corners[0] = min;
+        corners[1] = sf::Vector2f(max.x, min.y);
+        corners[2] = max;
+        corners[3] = sf::Vector2f(min.x, max.y);
     }
+    sf::Color color(255, 255, 255, static_cast<sf::Uint8>(255.f * mOpacity));
+    mLodQuad[0] = sf::Vertex(corners[0], color, sf::Vector2f(0.f, 0.f));
+    mLodQuad[1] = sf::Vertex(corners[1], color, sf::Vector2f(cells.x, 0.f));
+    mLodQuad[2] = sf::Vertex(corners[2], color, cells);
+    mLodQuad[3] = mLodQuad[2];
+    mLodQuad[4] = sf::Vertex(corners[3], color, sf::Vector2f(0.f, cells.y));
+    mLodQuad[5] = mLodQuad[0];
+    mLodPixels.clear();
 }
 
-sf::Vertex* Layer::getVertex(sf::Vector2i const& coords)
+void Layer::updateCell(sf::Vertex* tri, std::size_t cell, unsigned int previous)
 {
-    std::string order = mMap.getRenderOrder();
-    unsigned int tile;
-    if (order == "right-up")
+    unsigned int id = mTiles[cell];
+    if (id != 0 && mTileset != nullptr)
+    {
+        sf::Vector2i pos = mTileset->toPos(id);
+        sf::Vector2i texSize = mTileset->getTileSize();
+        tri[0].texCoords = sf::Vector2f(pos.x, pos.y);
+        tri[1].texCoords = sf::Vector2f(pos.x + texSize.x, pos.y);
+        tri[2].texCoords = sf::Vector2f(pos.x + texSize.x, pos.y + texSize.y);
+        tri[4].texCoords = sf::Vector2f(pos.x, pos.y + texSize.y);
+        tri[3].texCoords = tri[2].texCoords;
+        tri[5].texCoords = tri[0].texCoords;
+    }
+    if ((previous == 0) != (id == 0))
+    {
+        sf::Color color = getVertexColor(cell);
+        for (std::size_t i = 0; i < 6; i++)
+        {
+            tri[i].color = color;
+        }
+    }
+    if (previous != id && !mLodPixels.empty())
+    {
+        setLodPixel(cell);
+    }
+}
+
+void Layer::updateCells(std::vector<std::size_t> const& cells, std::vector<unsigned int> const& previous)
+{
+    if (cells.empty())
+    {
+        return;
+    }
+    sf::Vector2i size = mMap.getMapSize();
+    // Each id is looked up once, the first one found sets the tileset
+    unsigned int tried = 0;
+    for (std::size_t i = 0; i < cells.size() && mTileset == nullptr; i++)
+    {
+        if (mTiles[cells[i]] != 0 && mTiles[cells[i]] != tried)
+        {
+            tried = mTiles[cells[i]];
+            mTileset = mMap.getTileset(tried);
+            if (mTileset != nullptr)
+            {
+                update();
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < cells.size(); i++)
     {
-        tile = (coords.x + (mMap.getMapSize().y - coords.y - 1) * mMap.getMapSize().x);
+        sf::Vector2i coords(static_cast<int>(cells[i] % size.x), static_cast<int>(cells[i] / size.x));
+        updateCell(getVertex(coords), cells[i], previous[i]);
     }
-    else if (order == "left-up")
+
+    for (std::size_t j = 0; j < mListeners.size(); j++)
     {
-        tile = ((mMap.getMapSize().x - coords.x - 1) + (mMap.getMapSize().y - coords.y - 1) * mMap.getMapSize().x);
+        mListeners[j]->onBatchBegin(*this);
     }
-    else if (order == "left-down")
+    for (std::size_t i = 0; i < cells.size(); i++)
     {
-        tile = ((mMap.getMapSize().x - coords.x - 1) + mMap.getMapSize().y * mMap.getMapSize().x);
+        sf::Vector2i coords(static_cast<int>(cells[i] % size.x), static_cast<int>(cells[i] / size.x));
+        for (std::size_t j = 0; j < mListeners.size(); j++)
+        {
+            mListeners[j]->onTileChanged(*this, coords, previous[i], mTiles[cells[i]]);
+        }
+    }
+    for (std::size_t j = 0; j < mListeners.size(); j++)
+    {
+        mListeners[j]->onBatchEnd(*this);
+    }
+}
+
+sf::Color Layer::getVertexColor(std::size_t cell) const
+{
+    // Empty cells stay in the vertex array but are never visible
+    if (mTiles[cell] == 0)
+    {
+        return sf::Color::Transparent;
+    }
+    sf::Color color = (cell < mTints.size()) ? mTints[cell] : sf::Color::White;
+    color.a = static_cast<unsigned char>(color.a * mOpacity);
+    return color;
+}
+
+sf::Color Layer::getLodColor(std::size_t cell) const
+{
+    if (mTiles[cell] == 0 || mTileset == nullptr)
+    {
+        return sf::Color::Transparent;
+    }
+    sf::Color color = mTileset->getAverageColor(mTiles[cell]);
+    if (cell < mTints.size())
+    {
+        color = color * mTints[cell];
+    }
+    return color;
+}
+
+void Layer::setLodPixel(std::size_t cell) const
+{
+    sf::Color color = getLodColor(cell);
+    sf::Uint8* pixel = &mLodPixels[cell * 4];
+    pixel[0] = color.r;
+    pixel[1] = color.g;
+    pixel[2] = color.b;
+    pixel[3] = color.a;
+
+    int row = static_cast<int>(cell / mMap.getMapSize().x);
+    if (mLodDirtyBegin >= mLodDirtyEnd)
+    {
+        mLodDirtyBegin = row;
+        mLodDirtyEnd = row + 1;
     }
     else
     {
-        tile = (coords.x + coords.y * mMap.getMapSize().x);
+        mLodDirtyBegin = std::min(mLodDirtyBegin, row);
+        mLodDirtyEnd = std::max(mLodDirtyEnd, row + 1);
     }
-    return &mVertices[tile * 6];
+}
+
+void Layer::ensureLodUpdated() const
+{
+    sf::Vector2i size = mMap.getMapSize();
+    if (mLodPixels.empty() && !mTiles.empty())
+    {
+        mLodPixels.resize(mTiles.size() * 4);
+        for (std::size_t i = 0; i < mTiles.size(); i++)
+        {
+            setLodPixel(i);
+        }
+        if (static_cast<sf::Vector2i>(mLodTexture.getSize()) != size)
+        {
+            mLodTexture.create(size.x, size.y);
+        }
+    }
+
+    // Only the rows which changed are uploaded
+    if (mLodDirtyBegin < mLodDirtyEnd)
+    {
+        mLodTexture.update(&mLodPixels[mLodDirtyBegin * size.x * 4], size.x, mLodDirtyEnd - mLodDirtyBegin, 0, mLodDirtyBegin);
+        mLodDirtyBegin = 0;
+        mLodDirtyEnd = 0;
+    }
+}
+
+bool Layer::useLod(sf::RenderTarget const& target, sf::Transform const& transform) const
+{
+    if (mLodThreshold <= 0.f || mTiles.empty() || mTileset == nullptr || mTileset->getAverageColors().empty())
+    {
+        return false;
+    }
+    const sf::View& view = target.getView();
+    sf::Vector2f axis = transform.transformPoint(1.f, 0.f) - transform.transformPoint(0.f, 0.f);
+    float scale = target.getSize().x * view.getViewport().width / view.getSize().x * std::sqrt(axis.x * axis.x + axis.y * axis.y);
+    return mMap.getTileSize().x * scale < mLodThreshold;
+}
+
+sf::Vertex* Layer::getVertex(sf::Vector2i const& coords)
+{
+    return &mVertices[getVertexIndex(coords)];
+}
+
+std::size_t Layer::getVertexIndex(sf::Vector2i const& coords) const
+{
+    sf::Vector2i size = mMap.getMapSize();
+    std::size_t x = (mLeft) ? size.x - coords.x - 1 : coords.x;
+    std::size_t y = (mUp) ? size.y - coords.y - 1 : coords.y;
+    return (x + y * size.x) * 6;
 }
 
 } // namespace tmx
@@ -1,13 +1,13 @@
 #ifndef TMX_TILELAYER_HPP
 #define TMX_TILELAYER_HPP
 
+#include "Tileset.hpp"
 #include "Utils.hpp"
 
 namespace tmx
 {
 
 class Map;
-class Tileset;
 
 class Layer : public LayerBase
 {
@@ -16,13 +16,70 @@ class Layer : public LayerBase
 
         LayerType getLayerType() const;
 
+        Map& getMap() const;
+
         bool loadFromNode(pugi::xml_node const& layer);
         void saveToNode(pugi::xml_node& layer);
 
-        sf::Vector2i worldToCoords(sf::Vector2f const& world);
+        sf::Vector2i worldToCoords(sf::Vector2f const& world) const;
+        sf::Vector2f coordsToWorld(sf::Vector2i const& coords) const;
 
         void setTileId(sf::Vector2i coords, unsigned int id);
-        unsigned int getTileId(sf::Vector2i coords);
+        unsigned int getTileId(sf::Vector2i coords) const;
+        const std::vector<unsigned int>& getTileIds() const;
+        Tileset* getTileset() const;
+
+        // Bulk edits : the cells are written first, then the vertices of the changed ones are updated in one pass
+        // and the listeners get every changed cell between onBatchBegin and onBatchEnd, each returns the changed cell count
+        std::size_t fill(sf::IntRect const& area, unsigned int id);
+        // Every cell of the layer with the id previous
+        std::size_t replace(unsigned int previous, unsigned int id);
+        // The cells connected to coords with its id, through the sides of the map geometry
+        std::size_t floodFill(sf::Vector2i const& coords, unsigned int id);
+        // Row major cells of an area, 0 outside of the map, which can be pasted in any layer of any map
+        void copy(sf::IntRect const& area, std::vector<unsigned int>& tiles) const;
+        // Row major cells of the given size, clipped to the map, empty cells are skipped when asked
+        std::size_t paste(sf::Vector2i const& coords, sf::Vector2i const& size, std::vector<unsigned int> const& tiles, bool skipEmpty = false);
+        // Cells anywhere on the layer, each set to the id at the same index, the last one wins for a cell given twice
+        std::size_t setTileIds(std::vector<sf::Vector2i> const& coords, std::vector<unsigned int> const& ids);
+
+        // Tint multiplied with the cell texture, white by default
+        void setTileColor(sf::Vector2i coords, sf::Color const& color);
+        sf::Color getTileColor(sf::Vector2i coords) const;
+
+        // When the tiles are smaller than this on screen (in pixels), the layer is drawn as one quad
+        // textured with the average color of every cell, 0 always draws the tiles
+        void setLodThreshold(float pixels);
+        float getLodThreshold() const;
+
+        // One texel per cell with the average color of its tile, as drawn below the threshold (e.g. for a minimap)
+        const sf::Texture& getColorTexture() const;
+
+        class Listener
+        {
+            public:
+                virtual ~Listener();
+
+                virtual void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid) = 0;
+
+                // Around the changes of a bulk edit, nothing by default
+                virtual void onBatchBegin(Layer& layer);
+                virtual void onBatchEnd(Layer& layer);
+        };
+
+        void addListener(Listener* listener);
+        void removeListener(Listener* listener);
+
+        // A tile collision shape placed on the map, the shape itself is shared by every cell using the tile
+        struct ShapeInstance
+        {
+            const Tileset::Tile::Shape* shape;
+            sf::Vector2f offset;
+            sf::Vector2i coords;
+        };
+
+        // Shapes of the tiles in an area of cells (an empty area is the whole layer), appended to instances
+        void getShapes(sf::IntRect const& area, std::vector<ShapeInstance>& instances) const;
 
         void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
 
@@ -38,12 +95,35 @@ class Layer : public LayerBase
         void update();
 
     protected:
+        void updateCell(sf::Vertex* tri, std::size_t cell, unsigned int previous);
+        void updateCells(std::vector<std::size_t> const& cells, std::vector<unsigned int> const& previous);
+        sf::Color getVertexColor(std::size_t cell) const;
+        sf::Color getLodColor(std::size_t cell) const;
+        void setLodPixel(std::size_t cell) const;
+        void ensureLodUpdated() const;
+        bool useLod(sf::RenderTarget const& target, sf::Transform const& transform) const;
         sf::Vertex* getVertex(sf::Vector2i const& coords);
+        std::size_t getVertexIndex(sf::Vector2i const& coords) const;
 
     protected:
         Map& mMap;
         Tileset* mTileset;
         sf::VertexArray mVertices;
+        std::vector<unsigned int> mTiles;
+        std::vector<sf::Color> mTints;
+        std::vector<Listener*> mListeners;
+
+        // Color image built on the first use, then kept up to date cell by cell
+        float mLodThreshold;
+        sf::Vertex mLodQuad[6];
+        mutable std::vector<sf::Uint8> mLodPixels;
+        mutable sf::Texture mLodTexture;
+        mutable int mLodDirtyBegin;
+        mutable int mLodDirtyEnd;
+
+        // Render order of the vertices, from the map when they were last laid out by update()
+        bool mLeft;
+        bool mUp;
 
         std::string mEncoding;
         std::string mCompression;
@@ -0,0 +1,230 @@
+#include "LightMap.hpp"
+#include "Map.hpp"
+
+namespace tmx
+{
+
+LightMap::LightMap(Layer& layer, std::string const& emission, std::string const& opacity, unsigned char maxLevel)
+: mLayer(layer)
+, mMaxLevel((maxLevel > 0) ? maxLevel : 1)
+, mSize()
+, mEmissions()
+, mOpacities()
+, mLights()
+, mAddQueue()
+, mRemoveQueue()
+, mChanged()
+, mChangedCells()
+{
+    Map& map = mLayer.getMap();
+    for (std::size_t i = 0; i < map.getTilesetCount(); i++)
+    {
+        Tileset* tileset = map.getTilesetAt(i);
+        for (std::size_t j = 0; j < tileset->tiles(); j++)
+        {
+            Tileset::Tile& tile = tileset->getTile(j);
+            unsigned int gid = tileset->getFirstGid() + tile.getId();
+            if (tile.hasProperty(emission))
+            {
+                setEmission(gid, static_cast<unsigned char>(std::max(0, std::min(tile.getProperty<int>(emission), static_cast<int>(mMaxLevel)))));
+            }
+            if (tile.hasProperty(opacity))
+            {
+                setOpacity(gid, static_cast<unsigned char>(std::max(0, std::min(tile.getProperty<int>(opacity), 255))));
+            }
+        }
+    }
+    mLayer.addListener(this);
+    rebuild();
+}
+
+LightMap::~LightMap()
+{
+    mLayer.removeListener(this);
+}
+
+void LightMap::setEmission(unsigned int gid, unsigned char level)
+{
+    if (gid >= mEmissions.size())
+    {
+        mEmissions.resize(gid + 1, 0);
+    }
+    mEmissions[gid] = std::min(level, mMaxLevel);
+}
+
+void LightMap::setOpacity(unsigned int gid, unsigned char opacity)
+{
+    if (gid >= mOpacities.size())
+    {
+        mOpacities.resize(gid + 1, 0);
+    }
+    mOpacities[gid] = opacity;
+}
+
+void LightMap::rebuild()
+{
+    mSize = mLayer.getMap().getMapSize();
+    const std::size_t cells = static_cast<std::size_t>(mSize.x * mSize.y);
+    mLights.assign(cells, 0);
+    mChanged.assign(cells, 1);
+    mChangedCells.clear();
+    for (std::size_t cell = 0; cell < cells; cell++)
+    {
+        mChangedCells.push_back(static_cast<int>(cell));
+        mLights[cell] = getEmission(cell);
+        if (mLights[cell] > 0)
+        {
+            mAddQueue.push_back(static_cast<int>(cell));
+        }
+    }
+    spread();
+}
+
+unsigned char LightMap::getMaxLevel() const
+{
+    return mMaxLevel;
+}
+
+unsigned char LightMap::getLight(sf::Vector2i const& coords) const
+{
+    if (0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y)
+    {
+        return mLights[coords.x + coords.y * mSize.x];
+    }
+    return 0;
+}
+
+const std::vector<unsigned char>& LightMap::getLights() const
+{
+    return mLights;
+}
+
+void LightMap::apply(Layer& layer, unsigned char ambient, bool everything)
+{
+    if (everything)
+    {
+        mChangedCells.clear();
+        for (std::size_t cell = 0; cell < mLights.size(); cell++)
+        {
+            mChangedCells.push_back(static_cast<int>(cell));
+        }
+    }
+    for (std::size_t i = 0; i < mChangedCells.size(); i++)
+    {
+        int cell = mChangedCells[i];
+        unsigned char shade = static_cast<unsigned char>(ambient + (255 - ambient) * mLights[cell] / mMaxLevel);
+        layer.setTileColor(sf::Vector2i(cell % mSize.x, cell / mSize.x), sf::Color(shade, shade, shade));
+        mChanged[cell] = 0;
+    }
+    mChangedCells.clear();
+}
+
+void LightMap::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    if (mSize != mLayer.getMap().getMapSize())
+    {
+        rebuild();
+        return;
+    }
+    unsigned char previousEmission = (previous < mEmissions.size()) ? mEmissions[previous] : 0;
+    unsigned char previousOpacity = (previous < mOpacities.size()) ? mOpacities[previous] : 0;
+    unsigned char emission = (gid < mEmissions.size()) ? mEmissions[gid] : 0;
+    unsigned char opacity = (gid < mOpacities.size()) ? mOpacities[gid] : 0;
+    if (previousEmission == emission && previousOpacity == opacity)
+    {
+        return;
+    }
+
+    // The light of the cell is removed, the border of the darkened area then spreads back into it
+    std::size_t cell = coords.x + coords.y * mSize.x;
+    mRemoveQueue.push_back(std::make_pair(static_cast<int>(cell), mLights[cell]));
+    setLight(cell, 0);
+    const MapGeometry& geometry = mLayer.getMap().getGeometry();
+    for (std::size_t i = 0; i < mRemoveQueue.size(); i++)
+    {
+        int current = mRemoveQueue[i].first;
+        unsigned char level = mRemoveQueue[i].second;
+        sf::Vector2i p(current % mSize.x, current / mSize.x);
+        if (getEmission(current) > 0)
+        {
+            setLight(current, getEmission(current));
+            mAddQueue.push_back(current);
+        }
+        Span<sf::Vector2i> offsets = geometry.getNeighbourOffsets(p);
+        for (std::size_t k = 0; k < offsets.size(); k++)
+        {
+            sf::Vector2i n = p + offsets[k];
+            if (n.x < 0 || n.x >= mSize.x || n.y < 0 || n.y >= mSize.y)
+            {
+                continue;
+            }
+            int neighbour = n.x + n.y * mSize.x;
+            unsigned char light = mLights[neighbour];
+            if (light != 0 && light < level)
+            {
+                mRemoveQueue.push_back(std::make_pair(neighbour, light));
+                setLight(neighbour, 0);
+            }
+            else if (light >= level && light != 0)
+            {
+                mAddQueue.push_back(neighbour);
+            }
+        }
+    }
+    mRemoveQueue.clear();
+    spread();
+}
+
+unsigned char LightMap::getEmission(std::size_t cell) const
+{
+    unsigned int gid = mLayer.getTileId(sf::Vector2i(cell % mSize.x, cell / mSize.x));
+    return (gid < mEmissions.size()) ? mEmissions[gid] : 0;
+}
+
+int LightMap::getAttenuation(std::size_t cell) const
+{
+    unsigned int gid = mLayer.getTileId(sf::Vector2i(cell % mSize.x, cell / mSize.x));
+    return 1 + ((gid < mOpacities.size()) ? mOpacities[gid] : 0);
+}
+
+void LightMap::setLight(std::size_t cell, unsigned char level)
+{
+    if (mLights[cell] != level)
+    {
+        mLights[cell] = level;
+        if (mChanged[cell] == 0)
+        {
+            mChanged[cell] = 1;
+            mChangedCells.push_back(static_cast<int>(cell));
+        }
+    }
+}
+
+void LightMap::spread()
+{
+    const MapGeometry& geometry = mLayer.getMap().getGeometry();
+    for (std::size_t i = 0; i < mAddQueue.size(); i++)
+    {
+        int current = mAddQueue[i];
+        sf::Vector2i p(current % mSize.x, current / mSize.x);
+        Span<sf::Vector2i> offsets = geometry.getNeighbourOffsets(p);
+        for (std::size_t k = 0; k < offsets.size(); k++)
+        {
+            sf::Vector2i n = p + offsets[k];
+            if (n.x < 0 || n.x >= mSize.x || n.y < 0 || n.y >= mSize.y)
+            {
+                continue;
+            }
+            int neighbour = n.x + n.y * mSize.x;
+            int level = mLights[current] - getAttenuation(neighbour);
+            if (level > mLights[neighbour])
+            {
+                setLight(neighbour, static_cast<unsigned char>(level));
+                mAddQueue.push_back(neighbour);
+            }
+        }
+    }
+    mAddQueue.clear();
+}
+
+} // namespace tmx
@@ -0,0 +1,56 @@
+#ifndef TMX_LIGHTMAP_HPP
+#define TMX_LIGHTMAP_HPP
+
+#include "Layer.hpp"
+
+namespace tmx
+{
+
+// Flood fill lighting over a layer, tiles emit light and attenuate it through two integer properties
+// Entering a cell costs one level plus the opacity of its tile, light spreads through the sides of the cells
+// A tile change only removes and spreads again the light it affects, with breadth first queues
+// The light map listens to its layer and must not outlive it
+class LightMap : public Layer::Listener
+{
+    public:
+        LightMap(Layer& layer, std::string const& emission = "light", std::string const& opacity = "opacity", unsigned char maxLevel = 15);
+        ~LightMap();
+
+        // Overrides the values read from the tile properties, rebuild() applies them
+        void setEmission(unsigned int gid, unsigned char level);
+        void setOpacity(unsigned int gid, unsigned char opacity);
+
+        void rebuild();
+
+        unsigned char getMaxLevel() const;
+        unsigned char getLight(sf::Vector2i const& coords) const;
+        const std::vector<unsigned char>& getLights() const;
+
+        // Tints the cells of a layer, from ambient in the dark to white at the maximum level
+        // Only the cells whose light changed since the last call are written, unless everything is true
+        void apply(Layer& layer, unsigned char ambient = 0, bool everything = false);
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+
+    private:
+        unsigned char getEmission(std::size_t cell) const;
+        int getAttenuation(std::size_t cell) const;
+        void setLight(std::size_t cell, unsigned char level);
+        void spread();
+
+    private:
+        Layer& mLayer;
+        unsigned char mMaxLevel;
+        sf::Vector2i mSize;
+        std::vector<unsigned char> mEmissions;
+        std::vector<unsigned char> mOpacities;
+        std::vector<unsigned char> mLights;
+        std::vector<int> mAddQueue;
+        std::vector<std::pair<int, unsigned char>> mRemoveQueue;
+        std::vector<unsigned char> mChanged;
+        std::vector<int> mChangedCells;
+};
+
+} // namespace tmx
+
+#endif // TMX_LIGHTMAP_HPP
@@ -1,4 +1,5 @@
 #include "Map.hpp"
+#include "FogLayer.hpp"
 #include "Layer.hpp"
 #include "ObjectGroup.hpp"
 
@@ -6,6 +7,8 @@ namespace tmx
 {
 
 Map::Map()
+: mTypeNames(1, "")
+, mTypeHandles({{"", 0}})
 {
     clear();
 }
@@ -29,6 +32,7 @@ void Map::clear()
     mNextObjectId = 1;
     mPath = "";
     mRenderObjects = false;
+    updateGeometry();
     for (std::size_t i = 0; i < mTilesets.size(); i++)
     {
         delete mTilesets[i];
@@ -39,6 +43,7 @@ void Map::clear()
         delete mLayers[i];
     }
     mLayers.clear();
+    mObjects.clear();
 }
 
 bool Map::loadFromFile(std::string const& filename)
@@ -98,6 +103,7 @@ bool Map::loadFromFile(std::string const& filename)
         if (attr.name() == std::string("backgroundcolor")) mBackgroundColor = attr.as_string();
         if (attr.name() == std::string("nextobjectid")) mNextObjectId = attr.as_uint();
     }
+    updateGeometry();
 
     loadProperties(map);
 
@@ -139,6 +145,15 @@ bool Map::loadFromFile(std::string const& filename)
                 mLayers.push_back(lyr);
         }
     }
+    for (pugi::xml_node foglayer = map.child("foglayer"); foglayer; foglayer = foglayer.next_sibling("foglayer"))
+    {
+        FogLayer* lyr = new FogLayer(*this);
+        if (lyr->loadFromNode(foglayer))
+        {
+            if (std::find_if(mLayers.begin(),mLayers.end(),[&lyr](LayerBase* l)->bool{return (l->getName() == lyr->getName());}) == mLayers.end())
+                mLayers.push_back(lyr);
+        }
+    }
 
     return true;
 }
@@ -186,6 +201,7 @@ bool Map::saveToFile(std::string const& filename)
         {
             case tmx::EImageLayer: layer = map.append_child("imagelayer"); break;
             case tmx::EObjectGroup: layer = map.append_child("objectgroup"); break;
+            case tmx::EFogLayer: layer = map.append_child("foglayer"); break;
             default: layer = map.append_child("layer"); break;
         }
         mLayers[i]->saveToNode(layer);
@@ -228,9 +244,99 @@ void Map::removeLayer(std::string const& name)
     }
 }
 
-sf::Vector2i Map::worldToCoords(sf::Vector2f const& world)
+void Map::moveLayer(std::string const& name, std::size_t index)
+{
+    auto itr = std::find_if(mLayers.begin(),mLayers.end(),[&name](LayerBase* l)->bool{return (l->getName() == name);});
+    if (itr != mLayers.end())
+    {
+        LayerBase* layer = *itr;
+        mLayers.erase(itr);
+        mLayers.insert(mLayers.begin() + std::min(index, mLayers.size()), layer);
+    }
+}
+
+ObjectBase* Map::getObjectById(unsigned int id)
 {
-    return tmx::worldToCoords(mOrientation, world, mTileSize, mStaggerAxis, mStaggerIndex, mHexSideLength);
+    auto found = mObjects.find(id);
+    if (found != mObjects.end())
+    {
+        return found->second;
+    }
+    return nullptr;
+}
+
+void Map::indexObject(ObjectBase* object, unsigned int previousId)
+{
+    auto found = mObjects.find(previousId);
+    if (found != mObjects.end() && found->second == object)
+    {
+        mObjects.erase(found);
+    }
+    if (object->getId() != 0)
+    {
+        mObjects[object->getId()] = object;
+    }
+}
+
+void Map::unindexObject(ObjectBase* object)
+{
+    auto found = mObjects.find(object->getId());
+    if (found != mObjects.end() && found->second == object)
+    {
+        mObjects.erase(found);
+    }
+}
+
+unsigned int Map::getTypeHandle(std::string const& type)
+{
+    auto found = mTypeHandles.find(type);
+    if (found != mTypeHandles.end())
+    {
+        return found->second;
+    }
+    unsigned int handle = static_cast<unsigned int>(mTypeNames.size());
+    mTypeNames.push_back(type);
+    mTypeHandles[type] = handle;
+    return handle;
+}
+
+const std::string& Map::getTypeName(unsigned int handle) const
+{
+    if (handle < mTypeNames.size())
+    {
+        return mTypeNames[handle];
+    }
+    return mTypeNames[0];
+}
+
+sf::Vector2i Map::worldToCoords(sf::Vector2f const& world) const
+{
+    return mGeometry.worldToCoords(world);
+}
+
+void Map::worldToCoords(Span<sf::Vector2f> world, sf::Vector2i* coords) const
+{
+    mGeometry.worldToCoords(world, coords);
+}
+
+sf::Vector2f Map::coordsToWorld(sf::Vector2i const& coords) const
+{
+    return mGeometry.coordsToWorld(coords);
+}
+
+const MapGeometry& Map::getGeometry() const
+{
+    return mGeometry;
+}
+
+Span<sf::Vector2i> Map::getNeighbourOffsets(sf::Vector2i const& coords, bool corners) const
+{
+    return mGeometry.getNeighbourOffsets(coords, corners);
+}
+
+int Map::getDistance(sf::Vector2i const& a, sf::Vector2i const& b, bool corners) const
+{
+    return mGeometry.getDistance(a, b, corners);
 }
 
 void Map::renderBackground(sf::RenderTarget& target)
@@ -274,6 +380,15 @@ std::size_t Map::getTilesetCount() const
     return mTilesets.size();
 }
 
+Tileset* Map::getTilesetAt(std::size_t index)
+{
+    if (index < mTilesets.size())
+    {
+        return mTilesets[index];
+    }
+    return nullptr;
+}
+
 Tileset* Map::getTileset(unsigned int id)
 {
     for (std::size_t i = 0; i < mTilesets.size(); i++)
@@ -380,11 +495,23 @@ unsigned int Map::getNextObjectId() const
 void Map::setOrientation(std::string const& orientation)
 {
     mOrientation = orientation;
+    updateGeometry();
 }
 
 void Map::setRenderOrder(std::string const& renderOrder)
 {
-    mRenderOrder = renderOrder;
+    // The tile layers keep the order of their vertices, so they are laid out again
+    if (renderOrder != mRenderOrder)
+    {
+        mRenderOrder = renderOrder;
+        for (std::size_t i = 0; i < mLayers.size(); i++)
+        {
+            if (mLayers[i]->getLayerType() == ELayer)
+            {
+                static_cast<Layer*>(mLayers[i])->update();
+            }
+        }
+    }
 }
 
 void Map::setMapSize(sf::Vector2i const& mapSize)
@@ -395,21 +522,25 @@ void Map::setMapSize(sf::Vector2i const& mapSize)
 void Map::setTileSize(sf::Vector2i const& tileSize)
 {
     mTileSize = tileSize;
+    updateGeometry();
 }
 
 void Map::setHexSideLength(unsigned int hexSide)
 {
     mHexSideLength = hexSide;
+    updateGeometry();
 }
 
 void Map::setStaggerAxis(std::string const& axis)
 {
     mStaggerAxis = axis;
+    updateGeometry();
 }
 
 void Map::setStaggerIndex(std::string const& index)
 {
     mStaggerIndex = index;
+    updateGeometry();
 }
 
 void Map::setBackgroundColor(std::string const& color)
@@ -452,4 +583,9 @@ void Map::setMapOffset(sf::Vector2f const& offset)
     mMapOffset = offset;
 }
 
+void Map::updateGeometry()
+{
+    mGeometry.setup(mOrientation, mTileSize, mStaggerAxis, mStaggerIndex, mHexSideLength);
+}
+
 } // namespace tmx
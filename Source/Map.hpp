@@ -1,12 +1,16 @@
 #ifndef TMX_MAP_HPP
 #define TMX_MAP_HPP
 
+#include <deque>
+
+#include "MapGeometry.hpp"
 #include "Tileset.hpp"
 #include "Utils.hpp"
 
 namespace tmx
 {
 
+class ObjectBase;
 class Map : public detail::PropertiesHolder, public sf::Drawable
 {
     public:
@@ -26,14 +30,33 @@ class Map : public detail::PropertiesHolder, public sf::Drawable
         template <typename T>
         T* createLayer(std::string const& name);
         void removeLayer(std::string const& name);
+        // Draws the layer at this index, the layers from there on come after it
+        void moveLayer(std::string const& name, std::size_t index);
+
+        ObjectBase* getObjectById(unsigned int id);
+        template <typename T>
+        T* getObjectById(unsigned int id);
+        void indexObject(ObjectBase* object, unsigned int previousId);
+        void unindexObject(ObjectBase* object);
 
-        sf::Vector2i worldToCoords(sf::Vector2f const& world);
+        unsigned int getTypeHandle(std::string const& type);
+        const std::string& getTypeName(unsigned int handle) const;
+
+        sf::Vector2i worldToCoords(sf::Vector2f const& world) const;
+        void worldToCoords(Span<sf::Vector2f> world, sf::Vector2i* coords) const;
+        sf::Vector2f coordsToWorld(sf::Vector2i const& coords) const;
+        const MapGeometry& getGeometry() const;
+
+        // Neighbours and step distances of the map orientation, see MapGeometry
+        Span<sf::Vector2i> getNeighbourOffsets(sf::Vector2i const& coords, bool corners = false) const;
+        int getDistance(sf::Vector2i const& a, sf::Vector2i const& b, bool corners = false) const;
 
         void renderBackground(sf::RenderTarget& target);
         void draw(sf::RenderTarget& target, sf::RenderStates states) const;
         void render(std::size_t index, sf::RenderTarget& target, sf::RenderStates states) const;
 
         std::size_t getTilesetCount() const;
+        Tileset* getTilesetAt(std::size_t index);
         Tileset* getTileset(unsigned int gid);
         Tileset* getTileset(std::string const& name);
         Tileset* createTileset(std::string const& name);
@@ -68,6 +91,9 @@ class Map : public detail::PropertiesHolder, public sf::Drawable
         const sf::Vector2f& getMapOffset() const;
         void setMapOffset(sf::Vector2f const& offset);
 
+    private:
+        void updateGeometry();
+
     private:
         float mVersion;
         std::string mOrientation;
@@ -83,9 +109,13 @@ class Map : public detail::PropertiesHolder, public sf::Drawable
         std::string mPath;
         bool mRenderObjects;
         sf::Vector2f mMapOffset;
+        MapGeometry mGeometry;
 
         std::vector<Tileset*> mTilesets;
         std::vector<LayerBase*> mLayers;
+        std::unordered_map<unsigned int, ObjectBase*> mObjects;
+        std::deque<std::string> mTypeNames;
+        std::unordered_map<std::string, unsigned int> mTypeHandles;
 };
 
 template <typename T>
@@ -110,6 +140,12 @@ T* Map::createLayer(std::string const& name)
     return nullptr;
 }
 
+template <typename T>
+T* Map::getObjectById(unsigned int id)
+{
+    return static_cast<T*>(getObjectById(id));
+}
+
 } // namespace tmx
 
 #endif // TMX_MAP_HPP
@@ -0,0 +1,441 @@
+#include "MapGeometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(TMX_NO_SIMD)
+    #define TMX_GEOMETRY_SIMD
+    #include <immintrin.h>
+#endif
+
+namespace tmx
+{
+
+namespace
+{
+
+int floorToInt(float value)
+{
+    return static_cast<int>(std::floor(value));
+}
+
+#ifdef TMX_GEOMETRY_SIMD
+
+// The kernels repeat the scalar operations in the same order, so their roundings are the same
+struct Kernel
+{
+    MapGeometry::Orientation orientation;
+    bool staggerX;
+    int even;
+    sf::Vector2f tileSize;
+    float halfWidth;
+    float step;
+    float cap;
+    float shift;
+    float across;
+};
+
+typedef std::size_t (*KernelFunction)(Kernel const& k, const sf::Vector2f* world, sf::Vector2i* coords, std::size_t count);
+
+__attribute__((target("sse4.1")))
+std::size_t convertSse41(Kernel const& k, const sf::Vector2f* world, sf::Vector2i* coords, std::size_t count)
+{
+    const __m128 tw = _mm_set1_ps(k.tileSize.x);
+    const __m128 th = _mm_set1_ps(k.tileSize.y);
+    const __m128 halfWidth = _mm_set1_ps(k.halfWidth);
+    const __m128 step = _mm_set1_ps(k.step);
+    const __m128 cap = _mm_set1_ps(k.cap);
+    const __m128 shift = _mm_set1_ps(k.shift);
+    const __m128 across = _mm_set1_ps(k.across);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i even = _mm_set1_epi32(k.even);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // Two points per register, split into xs and ys
+        __m128 a = _mm_loadu_ps(&world[i].x);
+        __m128 b = _mm_loadu_ps(&world[i + 2].x);
+        __m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128i cx;
+        __m128i cy;
+        if (k.orientation == MapGeometry::EIsometric)
+        {
+            __m128 u = _mm_div_ps(_mm_sub_ps(x, halfWidth), tw);
+            __m128 v = _mm_div_ps(y, th);
+            cx = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(v, u)));
+            cy = _mm_cvttps_epi32(_mm_floor_ps(_mm_sub_ps(v, u)));
+        }
+        else if (k.orientation == MapGeometry::EStaggered || k.orientation == MapGeometry::EHexagonal)
+        {
+            if (k.staggerX)
+            {
+                std::swap(x, y);
+            }
+            __m128i row = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(y, step)));
+            __m128i shiftedInt = _mm_xor_si128(_mm_and_si128(row, one), even);
+            __m128 lx = _mm_sub_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(shiftedInt), shift));
+            __m128i column = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(lx, across)));
+            lx = _mm_sub_ps(lx, _mm_mul_ps(_mm_cvtepi32_ps(column), across));
+            __m128 ly = _mm_sub_ps(y, _mm_mul_ps(_mm_cvtepi32_ps(row), step));
+            __m128 edge = _mm_div_ps(_mm_mul_ps(cap, _mm_and_ps(_mm_sub_ps(lx, shift), absMask)), shift);
+            __m128i above = _mm_castps_si128(_mm_cmplt_ps(ly, edge));
+            __m128i right = _mm_castps_si128(_mm_cmpge_ps(lx, shift));
+            __m128i delta = _mm_sub_epi32(_mm_sub_epi32(shiftedInt, one), right);
+            column = _mm_add_epi32(column, _mm_and_si128(delta, above));
+            row = _mm_add_epi32(row, above);
+            cx = (k.staggerX) ? row : column;
+            cy = (k.staggerX) ? column : row;
+        }
+        else
+        {
+            cx = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(x, tw)));
+            cy = _mm_cvttps_epi32(_mm_floor_ps(_mm_div_ps(y, th)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&coords[i]), _mm_unpacklo_epi32(cx, cy));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&coords[i + 2]), _mm_unpackhi_epi32(cx, cy));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+std::size_t convertAvx2(Kernel const& k, const sf::Vector2f* world, sf::Vector2i* coords, std::size_t count)
+{
+    const __m256 tw = _mm256_set1_ps(k.tileSize.x);
+    const __m256 th = _mm256_set1_ps(k.tileSize.y);
+    const __m256 halfWidth = _mm256_set1_ps(k.halfWidth);
+    const __m256 step = _mm256_set1_ps(k.step);
+    const __m256 cap = _mm256_set1_ps(k.cap);
+    const __m256 shift = _mm256_set1_ps(k.shift);
+    const __m256 across = _mm256_set1_ps(k.across);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i even = _mm256_set1_epi32(k.even);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // The lanes hold points 0 1 4 5 and 2 3 6 7, the unpacks at the end restore the order
+        __m256 a = _mm256_loadu_ps(&world[i].x);
+        __m256 b = _mm256_loadu_ps(&world[i + 4].x);
+        __m256 x = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 y = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256i cx;
+        __m256i cy;
+        if (k.orientation == MapGeometry::EIsometric)
+        {
+            __m256 u = _mm256_div_ps(_mm256_sub_ps(x, halfWidth), tw);
+            __m256 v = _mm256_div_ps(y, th);
+            cx = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(v, u)));
+            cy = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_sub_ps(v, u)));
+        }
+        else if (k.orientation == MapGeometry::EStaggered || k.orientation == MapGeometry::EHexagonal)
+        {
+            if (k.staggerX)
+            {
+                std::swap(x, y);
+            }
+            __m256i row = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(y, step)));
+            __m256i shiftedInt = _mm256_xor_si256(_mm256_and_si256(row, one), even);
+            __m256 lx = _mm256_sub_ps(x, _mm256_mul_ps(_mm256_cvtepi32_ps(shiftedInt), shift));
+            __m256i column = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(lx, across)));
+            lx = _mm256_sub_ps(lx, _mm256_mul_ps(_mm256_cvtepi32_ps(column), across));
+            __m256 ly = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_cvtepi32_ps(row), step));
+            __m256 edge = _mm256_div_ps(_mm256_mul_ps(cap, _mm256_and_ps(_mm256_sub_ps(lx, shift), absMask)), shift);
+            __m256i above = _mm256_castps_si256(_mm256_cmp_ps(ly, edge, _CMP_LT_OQ));
+            __m256i right = _mm256_castps_si256(_mm256_cmp_ps(lx, shift, _CMP_GE_OQ));
+            __m256i delta = _mm256_sub_epi32(_mm256_sub_epi32(shiftedInt, one), right);
+            column = _mm256_add_epi32(column, _mm256_and_si256(delta, above));
+            row = _mm256_add_epi32(row, above);
+            cx = (k.staggerX) ? row : column;
+            cy = (k.staggerX) ? column : row;
+        }
+        else
+        {
+            cx = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(x, tw)));
+            cy = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_div_ps(y, th)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&coords[i]), _mm256_unpacklo_epi32(cx, cy));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&coords[i + 4]), _mm256_unpackhi_epi32(cx, cy));
+    }
+    return i;
+}
+
+KernelFunction selectKernel()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &convertAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return &convertSse41;
+    }
+    return nullptr;
+}
+
+#endif // TMX_GEOMETRY_SIMD
+
+} // namespace
+
+MapGeometry::MapGeometry()
+: mOrientation(EOrthogonal)
+, mTileSize()
+, mStaggerX(false)
+, mStaggerEven(0)
+, mStep(0.f)
+, mCap(0.f)
+, mShift(0.f)
+, mAcross(0.f)
+, mOffsets()
+, mSideCount(4)
+, mCornerCount(4)
+{
+    setup("orthogonal", sf::Vector2i());
+}
+
+MapGeometry::MapGeometry(std::string const& orientation, sf::Vector2i const& tileSize, std::string const& axis, std::string const& index, unsigned int hexSideLength)
+: MapGeometry()
+{
+    setup(orientation, tileSize, axis, index, hexSideLength);
+}
+
+void MapGeometry::setup(std::string const& orientation, sf::Vector2i const& tileSize, std::string const& axis, std::string const& index, unsigned int hexSideLength)
+{
+    if (orientation == "isometric")
+    {
+        mOrientation = EIsometric;
+    }
+    else if (orientation == "staggered")
+    {
+        mOrientation = EStaggered;
+    }
+    else if (orientation == "hexagonal")
+    {
+        mOrientation = EHexagonal;
+    }
+    else
+    {
+        mOrientation = EOrthogonal;
+    }
+    mTileSize = static_cast<sf::Vector2f>(tileSize);
+    mStaggerX = (axis == "x");
+    mStaggerEven = (index == "even") ? 1 : 0;
+
+    // A staggered map is a hexagonal one whose sides have no length
+    float side = (mOrientation == EHexagonal) ? static_cast<float>(hexSideLength) : 0.f;
+    float along = (mStaggerX) ? mTileSize.x : mTileSize.y;
+    mAcross = (mStaggerX) ? mTileSize.y : mTileSize.x;
+    mStep = (along + side) * 0.5f;
+    mCap = (along - side) * 0.5f;
+    mShift = mAcross * 0.5f;
+
+    // Neighbour tables, written across then along the stagger axis for shifted (1) and unshifted (0) cells
+    static const int squareOffsets[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+    for (int shifted = 0; shifted < 2; shifted++)
+    {
+        const int s = shifted;
+        const int staggeredOffsets[8][2] = {{s, -1}, {s, 1}, {s - 1, 1}, {s - 1, -1}, {1, 0}, {0, 2}, {-1, 0}, {0, -2}};
+        const int hexagonalOffsets[6][2] = {{1, 0}, {s, 1}, {s - 1, 1}, {-1, 0}, {s - 1, -1}, {s, -1}};
+        for (int k = 0; k < 8; k++)
+        {
+            const int* offset = squareOffsets[k];
+            if (mOrientation == EStaggered)
+            {
+                offset = staggeredOffsets[k];
+            }
+            else if (mOrientation == EHexagonal)
+            {
+                offset = hexagonalOffsets[k % 6];
+            }
+            mOffsets[shifted][k] = (mStaggerX && mOrientation != EOrthogonal && mOrientation != EIsometric) ? sf::Vector2i(offset[1], offset[0]) : sf::Vector2i(offset[0], offset[1]);
+        }
+    }
+    mSideCount = (mOrientation == EHexagonal) ? 6 : 4;
+    mCornerCount = (mOrientation == EHexagonal) ? 0 : 4;
+}
+
+MapGeometry::Orientation MapGeometry::getOrientation() const
+{
+    return mOrientation;
+}
+
+const sf::Vector2f& MapGeometry::getTileSize() const
+{
+    return mTileSize;
+}
+
+bool MapGeometry::isStaggerX() const
+{
+    return mStaggerX;
+}
+
+bool MapGeometry::isStaggerEven() const
+{
+    return mStaggerEven != 0;
+}
+
+sf::Vector2i MapGeometry::worldToCoords(sf::Vector2f const& world) const
+{
+    switch (mOrientation)
+    {
+        case EIsometric:
+        {
+            // Cell (0,0) has its top corner in the middle of its quad
+            float u = (world.x - mTileSize.x * 0.5f) / mTileSize.x;
+            float v = world.y / mTileSize.y;
+            return sf::Vector2i(floorToInt(v + u), floorToInt(v - u));
+        }
+
+        case EStaggered:
+        case EHexagonal:
+        {
+            if (mStaggerX)
+            {
+                sf::Vector2i coords = staggeredToCoords(world.y, world.x);
+                return sf::Vector2i(coords.y, coords.x);
+            }
+            return staggeredToCoords(world.x, world.y);
+        }
+
+        default:
+            return sf::Vector2i(floorToInt(world.x / mTileSize.x), floorToInt(world.y / mTileSize.y));
+    }
+}
+
+void MapGeometry::worldToCoords(const sf::Vector2f* world, sf::Vector2i* coords, std::size_t count) const
+{
+    std::size_t done = 0;
+#ifdef TMX_GEOMETRY_SIMD
+    static const KernelFunction kernel = selectKernel();
+    if (kernel != nullptr)
+    {
+        Kernel k;
+        k.orientation = mOrientation;
+        k.staggerX = mStaggerX;
+        k.even = mStaggerEven;
+        k.tileSize = mTileSize;
+        k.halfWidth = mTileSize.x * 0.5f;
+        k.step = mStep;
+        k.cap = mCap;
+        k.shift = mShift;
+        k.across = mAcross;
+        done = kernel(k, world, coords, count);
+    }
+#endif
+    for (std::size_t i = done; i < count; i++)
+    {
+        coords[i] = worldToCoords(world[i]);
+    }
+}
+
+void MapGeometry::worldToCoords(Span<sf::Vector2f> world, sf::Vector2i* coords) const
+{
+    worldToCoords(world.data(), coords, world.size());
+}
+
+sf::Vector2f MapGeometry::coordsToWorld(sf::Vector2i const& coords) const
+{
+    switch (mOrientation)
+    {
+        case EIsometric:
+            return sf::Vector2f((coords.x - coords.y) * mTileSize.x * 0.5f, (coords.x + coords.y) * mTileSize.y * 0.5f);
+
+        case EStaggered:
+        case EHexagonal:
+        {
+            int row = (mStaggerX) ? coords.x : coords.y;
+            int column = (mStaggerX) ? coords.y : coords.x;
+            float shifted = static_cast<float>((row & 1) ^ mStaggerEven);
+            float across = column * mAcross + shifted * mShift;
+            float along = row * mStep;
+            return (mStaggerX) ? sf::Vector2f(along, across) : sf::Vector2f(across, along);
+        }
+
+        default:
+            return sf::Vector2f(coords.x * mTileSize.x, coords.y * mTileSize.y);
+    }
+}
+
+sf::Vector2f MapGeometry::getCellCenter(sf::Vector2i const& coords) const
+{
+    return coordsToWorld(coords) + mTileSize * 0.5f;
+}
+
+float MapGeometry::getRowStep() const
+{
+    return mStep;
+}
+
+float MapGeometry::getCapHeight() const
+{
+    return mCap;
+}
+
+std::size_t MapGeometry::getSideCount() const
+{
+    return mSideCount;
+}
+
+std::size_t MapGeometry::getCornerCount() const
+{
+    return mCornerCount;
+}
+
+sf::Vector2i MapGeometry::toLattice(sf::Vector2i const& coords) const
+{
+    if (mOrientation != EStaggered && mOrientation != EHexagonal)
+    {
+        return coords;
+    }
+
+    // Doubled position across the rows, with the same parity as the row
+    int across = (mStaggerX) ? coords.y : coords.x;
+    int along = (mStaggerX) ? coords.x : coords.y;
+    int doubled = 2 * across + getParity(coords) - mStaggerEven;
+    if (mOrientation == EHexagonal)
+    {
+        return sf::Vector2i((doubled - along) / 2, along);
+    }
+    return sf::Vector2i((doubled + along) / 2, (along - doubled) / 2);
+}
+
+int MapGeometry::getDistance(sf::Vector2i const& a, sf::Vector2i const& b, bool corners) const
+{
+    sf::Vector2i delta = toLattice(b) - toLattice(a);
+    int dx = std::abs(delta.x);
+    int dy = std::abs(delta.y);
+    if (mOrientation == EHexagonal)
+    {
+        // Cube distance
+        return (dx + dy + std::abs(delta.x + delta.y)) / 2;
+    }
+    return (corners) ? std::max(dx, dy) : dx + dy;
+}
+
+sf::Vector2i MapGeometry::staggeredToCoords(float x, float y) const
+{
+    // x runs across the rows and y along the stagger axis
+    // The band of a row below its cap only belongs to that row, the cap is split by the two upper edges of the cell
+    int row = floorToInt(y / mStep);
+    float shifted = static_cast<float>((row & 1) ^ mStaggerEven);
+    float lx = x - shifted * mShift;
+    int column = floorToInt(lx / mAcross);
+    lx -= column * mAcross;
+    float ly = y - row * mStep;
+
+    float edge = mCap * std::fabs(lx - mShift) / mShift;
+    int above = (ly < edge) ? 1 : 0;
+    int right = (lx >= mShift) ? 1 : 0;
+
+    // Upper neighbours are (column + shifted - 1, row - 1) and (column + shifted, row - 1)
+    int shift = static_cast<int>(shifted);
+    column += above * (shift - 1 + right);
+    row -= above;
+    return sf::Vector2i(column, row);
+}
+
+} // namespace tmx
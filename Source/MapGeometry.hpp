@@ -0,0 +1,105 @@
+#ifndef TMX_MAPGEOMETRY_HPP
+#define TMX_MAPGEOMETRY_HPP
+
+#include "Utils.hpp"
+
+namespace tmx
+{
+
+// World <-> cell transforms of a map, precomputed from its orientation so each query is only arithmetic
+// World positions are relative to the map origin, cell quads are tile sized
+class MapGeometry
+{
+    public:
+        enum Orientation
+        {
+            EOrthogonal,
+            EIsometric,
+            EStaggered,
+            EHexagonal
+        };
+
+        MapGeometry();
+        MapGeometry(std::string const& orientation, sf::Vector2i const& tileSize, std::string const& axis = "y", std::string const& index = "odd", unsigned int hexSideLength = 0);
+
+        void setup(std::string const& orientation, sf::Vector2i const& tileSize, std::string const& axis = "y", std::string const& index = "odd", unsigned int hexSideLength = 0);
+
+        Orientation getOrientation() const;
+        const sf::Vector2f& getTileSize() const;
+        bool isStaggerX() const;
+        bool isStaggerEven() const;
+
+        sf::Vector2i worldToCoords(sf::Vector2f const& world) const;
+
+        // Many positions at once, with SSE4.1 or AVX2 kernels chosen at runtime
+        // The results are the same as the ones of the single position version, bit for bit
+        void worldToCoords(const sf::Vector2f* world, sf::Vector2i* coords, std::size_t count) const;
+        void worldToCoords(Span<sf::Vector2f> world, sf::Vector2i* coords) const;
+
+        // Top left corner of the quad of a cell, as drawn by layers
+        sf::Vector2f coordsToWorld(sf::Vector2i const& coords) const;
+        sf::Vector2f getCellCenter(sf::Vector2i const& coords) const;
+
+        // Distance between two rows (or columns on the x stagger axis), and the height of the overlap between them
+        float getRowStep() const;
+        float getCapHeight() const;
+
+        // Offsets to the neighbours of a cell : its sides (4, or 6 on hexagonal maps) then its corners (4, none on hexagonal maps)
+        // Corner k lies between the sides k and k + 1, the tables only depend on the parity of the staggered coordinate
+        Span<sf::Vector2i> getNeighbourOffsets(sf::Vector2i const& coords, bool corners = false) const;
+        std::size_t getSideCount() const;
+        std::size_t getCornerCount() const;
+
+        template <typename F>
+        void forEachNeighbour(sf::Vector2i const& coords, bool corners, F function) const;
+
+        // Coordinates along the step axes : unchanged for square cells, diamond axes for staggered cells, axial for hexagonal cells
+        sf::Vector2i toLattice(sf::Vector2i const& coords) const;
+
+        // Number of steps between two cells, through sides only or through sides and corners
+        int getDistance(sf::Vector2i const& a, sf::Vector2i const& b, bool corners = false) const;
+
+    private:
+        sf::Vector2i staggeredToCoords(float x, float y) const;
+        int getParity(sf::Vector2i const& coords) const;
+
+    private:
+        Orientation mOrientation;
+        sf::Vector2f mTileSize;
+        bool mStaggerX;
+        int mStaggerEven;
+
+        // Stagger axis first, in the swapped frame when the axis is x
+        float mStep;
+        float mCap;
+        float mShift;
+        float mAcross;
+
+        sf::Vector2i mOffsets[2][8];
+        std::size_t mSideCount;
+        std::size_t mCornerCount;
+};
+
+inline int MapGeometry::getParity(sf::Vector2i const& coords) const
+{
+    return (((mStaggerX) ? coords.x : coords.y) & 1) ^ mStaggerEven;
+}
+
+inline Span<sf::Vector2i> MapGeometry::getNeighbourOffsets(sf::Vector2i const& coords, bool corners) const
+{
+    return Span<sf::Vector2i>(mOffsets[getParity(coords)], (corners) ? mSideCount + mCornerCount : mSideCount);
+}
+
+template <typename F>
+void MapGeometry::forEachNeighbour(sf::Vector2i const& coords, bool corners, F function) const
+{
+    Span<sf::Vector2i> offsets = getNeighbourOffsets(coords, corners);
+    for (std::size_t i = 0; i < offsets.size(); i++)
+    {
+        function(coords + offsets[i]);
+    }
+}
+
+} // namespace tmx
+
+#endif // TMX_MAPGEOMETRY_HPP
@@ -0,0 +1,991 @@
+#include "MapPatch.hpp"
+#include "Layer.hpp"
+#include "ObjectGroup.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace tmx
+{
+
+namespace detail
+{
+
+// Cells are compared and verified by square chunks of this size
+const int PatchChunkSize = 16;
+
+// First byte of a patch
+enum PatchFormat
+{
+    EPatchRaw,
+    EPatchZlib
+};
+
+// Flags of a layer in a patch
+enum PatchLayerFlag
+{
+    EPatchCreated = 1,
+    EPatchVisible = 2,
+    EPatchOpacity = 4
+};
+
+// Little endian varints, floats as their 4 bytes, and strings prefixed by their length
+class PatchWriter
+{
+    public:
+        void writeByte(unsigned char value)
+        {
+            mData.push_back(static_cast<char>(value));
+        }
+
+        void writeVarint(sf::Uint64 value)
+        {
+            while (value >= 0x80)
+            {
+                writeByte(static_cast<unsigned char>(value | 0x80));
+                value >>= 7;
+            }
+            writeByte(static_cast<unsigned char>(value));
+        }
+
+        void writeUint32(sf::Uint32 value)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                writeByte(static_cast<unsigned char>(value >> (i * 8)));
+            }
+        }
+
+        void writeFloat(float value)
+        {
+            sf::Uint32 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            writeUint32(bits);
+        }
+
+        void writeString(std::string const& value)
+        {
+            writeVarint(value.size());
+            mData.append(value);
+        }
+
+        std::string& getData()
+        {
+            return mData;
+        }
+
+    private:
+        std::string mData;
+};
+
+// Reads what PatchWriter wrote, every read past the end invalidates the reader and returns 0
+class PatchReader
+{
+    public:
+        PatchReader(std::string const& data)
+        : mData(data)
+        , mPosition(0)
+        , mValid(true)
+        {
+        }
+
+        unsigned char readByte()
+        {
+            if (mPosition >= mData.size())
+            {
+                mValid = false;
+                return 0;
+            }
+            return static_cast<unsigned char>(mData[mPosition++]);
+        }
+
+        sf::Uint64 readVarint()
+        {
+            sf::Uint64 value = 0;
+            for (int shift = 0; shift < 64 && mValid; shift += 7)
+            {
+                unsigned char byte = readByte();
+                value |= static_cast<sf::Uint64>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+            mValid = false;
+            return 0;
+        }
+
+        sf::Uint32 readUint32()
+        {
+            sf::Uint32 value = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                value |= static_cast<sf::Uint32>(readByte()) << (i * 8);
+            }
+            return value;
+        }
+
+        float readFloat()
+        {
+            sf::Uint32 bits = readUint32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        std::string readString()
+        {
+            sf::Uint64 size = readVarint();
+            if (!mValid || size > mData.size() - mPosition)
+            {
+                mValid = false;
+                return "";
+            }
+            std::string value = mData.substr(mPosition, static_cast<std::size_t>(size));
+            mPosition += static_cast<std::size_t>(size);
+            return value;
+        }
+
+        // Counts are bounded by the remaining bytes, so a corrupted patch never reserves huge arrays
+        std::size_t readCount()
+        {
+            sf::Uint64 count = readVarint();
+            if (count > mData.size() - mPosition)
+            {
+                mValid = false;
+                return 0;
+            }
+            return static_cast<std::size_t>(count);
+        }
+
+        bool isValid() const
+        {
+            return mValid;
+        }
+
+        bool isFinished() const
+        {
+            return mPosition == mData.size();
+        }
+
+    private:
+        std::string const& mData;
+        std::size_t mPosition;
+        bool mValid;
+};
+
+struct PropertyChanges
+{
+    std::vector<std::pair<std::string, std::string>> set;
+    std::vector<std::string> removed;
+};
+
+struct LayerChanges
+{
+    std::string name;
+    LayerType type;
+    unsigned char flags;
+    float opacity;
+    PropertyChanges properties;
+
+    // Tile layers : hashes of the chunks before the patch, then the new cells
+    std::vector<std::pair<std::size_t, sf::Uint32>> bases;
+    std::vector<std::pair<std::size_t, unsigned int>> cells;
+
+    // Object groups : removed ids, then the added and modified objects
+    std::vector<unsigned int> removed;
+    std::vector<std::string> objects;
+};
+
+struct MapChanges
+{
+    sf::Vector2i fromSize;
+    sf::Vector2i toSize;
+    PropertyChanges properties;
+    std::vector<std::string> removedLayers;
+    std::vector<std::string> order; // Names of the patchable layers in drawing order, empty when it stays the same
+    std::vector<LayerChanges> layers;
+};
+
+LayerBase* findLayer(Map& map, std::string const& name)
+{
+    for (std::size_t i = 0; i < map.getLayerCount(); i++)
+    {
+        if (map.getLayer(i)->getName() == name)
+        {
+            return map.getLayer(i);
+        }
+    }
+    return nullptr;
+}
+
+bool isPatchable(LayerBase const* layer)
+{
+    return layer != nullptr && (layer->getLayerType() == ELayer || layer->getLayerType() == EObjectGroup);
+}
+
+std::vector<std::string> getLayerOrder(Map& map)
+{
+    std::vector<std::string> order;
+    for (std::size_t i = 0; i < map.getLayerCount(); i++)
+    {
+        if (isPatchable(map.getLayer(i)))
+        {
+            order.push_back(map.getLayer(i)->getName());
+        }
+    }
+    return order;
+}
+
+// FNV-1a over the cells of a chunk, cells past the tiles count as empty
+sf::Uint32 hashChunk(std::vector<unsigned int> const& tiles, sf::Vector2i const& size, sf::Vector2i const& chunk)
+{
+    sf::Uint32 hash = 2166136261u;
+    int right = std::min((chunk.x + 1) * PatchChunkSize, size.x);
+    int bottom = std::min((chunk.y + 1) * PatchChunkSize, size.y);
+    for (int y = chunk.y * PatchChunkSize; y < bottom; y++)
+    {
+        for (int x = chunk.x * PatchChunkSize; x < right; x++)
+        {
+            std::size_t cell = x + y * size.x;
+            unsigned int gid = (cell < tiles.size()) ? tiles[cell] : 0;
+            for (int i = 0; i < 4; i++)
+            {
+                hash = (hash ^ ((gid >> (i * 8)) & 0xff)) * 16777619u;
+            }
+        }
+    }
+    return hash;
+}
+
+// Exact comparison of a chunk, so a hash collision can't drop a change, missing cells are empty
+bool sameChunk(std::vector<unsigned int> const& a, std::vector<unsigned int> const& b, sf::Vector2i const& size, sf::Vector2i const& chunk)
+{
+    int right = std::min((chunk.x + 1) * PatchChunkSize, size.x);
+    int bottom = std::min((chunk.y + 1) * PatchChunkSize, size.y);
+    for (int y = chunk.y * PatchChunkSize; y < bottom; y++)
+    {
+        std::size_t begin = chunk.x * PatchChunkSize + y * size.x;
+        std::size_t end = right + y * size.x;
+        if (end <= a.size() && end <= b.size())
+        {
+            if (!std::equal(a.begin() + begin, a.begin() + end, b.begin() + begin))
+            {
+                return false;
+            }
+            continue;
+        }
+        for (std::size_t cell = begin; cell < end; cell++)
+        {
+            if (((cell < a.size()) ? a[cell] : 0) != ((cell < b.size()) ? b[cell] : 0))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void diffProperties(PropertiesHolder const* from, PropertiesHolder const& to, PropertyChanges& changes)
+{
+    for (auto itr = to.getProperties().begin(); itr != to.getProperties().end(); itr++)
+    {
+        auto found = (from != nullptr) ? from->getProperties().find(itr->first) : to.getProperties().end();
+        if (from == nullptr || found == from->getProperties().end() || found->second != itr->second)
+        {
+            changes.set.push_back(*itr);
+        }
+    }
+    if (from != nullptr)
+    {
+        for (auto itr = from->getProperties().begin(); itr != from->getProperties().end(); itr++)
+        {
+            if (!to.hasProperty(itr->first))
+            {
+                changes.removed.push_back(itr->first);
+            }
+        }
+    }
+    // Same patch for the same maps, whatever the order of the hash maps
+    std::sort(changes.set.begin(), changes.set.end());
+    std::sort(changes.removed.begin(), changes.removed.end());
+}
+
+void writeProperties(PatchWriter& writer, PropertyChanges const& changes)
+{
+    writer.writeVarint(changes.set.size());
+    for (std::size_t i = 0; i < changes.set.size(); i++)
+    {
+        writer.writeString(changes.set[i].first);
+        writer.writeString(changes.set[i].second);
+    }
+    writer.writeVarint(changes.removed.size());
+    for (std::size_t i = 0; i < changes.removed.size(); i++)
+    {
+        writer.writeString(changes.removed[i]);
+    }
+}
+
+void readProperties(PatchReader& reader, PropertyChanges& changes)
+{
+    changes.set.resize(reader.readCount());
+    for (std::size_t i = 0; i < changes.set.size(); i++)
+    {
+        changes.set[i].first = reader.readString();
+        changes.set[i].second = reader.readString();
+    }
+    changes.removed.resize(reader.readCount());
+    for (std::size_t i = 0; i < changes.removed.size(); i++)
+    {
+        changes.removed[i] = reader.readString();
+    }
+}
+
+void applyProperties(PropertiesHolder& holder, PropertyChanges const& changes)
+{
+    for (std::size_t i = 0; i < changes.set.size(); i++)
+    {
+        holder.setProperty(changes.set[i].first, changes.set[i].second);
+    }
+    for (std::size_t i = 0; i < changes.removed.size(); i++)
+    {
+        holder.removeProperty(changes.removed[i]);
+    }
+}
+
+// Changed cells of every chunk which differs, as runs of skipped cells then run length encoded gids
+// Without a previous layer, every non empty cell is written
+void diffCells(Layer* from, Layer& to, sf::Vector2i const& size, bool verify, PatchWriter& writer)
+{
+    static const std::vector<unsigned int> empty;
+    const std::vector<unsigned int>& before = (from != nullptr) ? from->getTileIds() : empty;
+    const std::vector<unsigned int>& after = to.getTileIds();
+    sf::Vector2i chunks((size.x + PatchChunkSize - 1) / PatchChunkSize, (size.y + PatchChunkSize - 1) / PatchChunkSize);
+
+    std::vector<std::size_t> changed;
+    for (int i = 0; i < chunks.x * chunks.y; i++)
+    {
+        sf::Vector2i chunk(i % chunks.x, i / chunks.x);
+        if (!sameChunk(before, after, size, chunk))
+        {
+            changed.push_back(i);
+        }
+    }
+
+    writer.writeVarint(changed.size());
+    std::size_t previous = 0;
+    std::vector<unsigned int> gids;
+    for (std::size_t c = 0; c < changed.size(); c++)
+    {
+        sf::Vector2i chunk(changed[c] % chunks.x, changed[c] / chunks.x);
+        writer.writeVarint(changed[c] - previous);
+        previous = changed[c];
+        if (verify)
+        {
+            writer.writeUint32(hashChunk(before, size, chunk));
+        }
+
+        // Runs of changed cells, in the row major order of the chunk
+        std::vector<std::pair<std::size_t, std::size_t>> runs;
+        gids.clear();
+        std::size_t skip = 0;
+        int right = std::min((chunk.x + 1) * PatchChunkSize, size.x);
+        int bottom = std::min((chunk.y + 1) * PatchChunkSize, size.y);
+        for (int y = chunk.y * PatchChunkSize; y < bottom; y++)
+        {
+            for (int x = chunk.x * PatchChunkSize; x < right; x++)
+            {
+                std::size_t cell = x + y * size.x;
+                unsigned int gid = (cell < after.size()) ? after[cell] : 0;
+                unsigned int old = (cell < before.size()) ? before[cell] : 0;
+                if (gid == old)
+                {
+                    skip++;
+                }
+                else if (skip == 0 && !runs.empty())
+                {
+                    runs.back().second++;
+                    gids.push_back(gid);
+                }
+                else
+                {
+                    runs.push_back(std::make_pair(skip, 1));
+                    gids.push_back(gid);
+                    skip = 0;
+                }
+            }
+        }
+
+        writer.writeVarint(runs.size());
+        std::size_t g = 0;
+        for (std::size_t r = 0; r < runs.size(); r++)
+        {
+            writer.writeVarint(runs[r].first);
+            writer.writeVarint(runs[r].second);
+            std::size_t end = g + runs[r].second;
+            while (g < end)
+            {
+                std::size_t repeat = 1;
+                while (g + repeat < end && gids[g + repeat] == gids[g])
+                {
+                    repeat++;
+                }
+                writer.writeVarint(repeat);
+                writer.writeVarint(gids[g]);
+                g += repeat;
+            }
+        }
+    }
+}
+
+bool readCells(PatchReader& reader, sf::Vector2i const& size, bool verify, LayerChanges& changes)
+{
+    sf::Vector2i chunks((size.x + PatchChunkSize - 1) / PatchChunkSize, (size.y + PatchChunkSize - 1) / PatchChunkSize);
+    std::size_t count = reader.readCount();
+    std::size_t index = 0;
+    for (std::size_t c = 0; c < count && reader.isValid(); c++)
+    {
+        index += static_cast<std::size_t>(reader.readVarint());
+        if (index >= static_cast<std::size_t>(chunks.x * chunks.y))
+        {
+            return false;
+        }
+        sf::Vector2i chunk(index % chunks.x, index / chunks.x);
+        if (verify)
+        {
+            changes.bases.push_back(std::make_pair(index, reader.readUint32()));
+        }
+
+        int left = chunk.x * PatchChunkSize;
+        int width = std::min(left + PatchChunkSize, size.x) - left;
+        int top = chunk.y * PatchChunkSize;
+        std::size_t cells = width * (std::min(top + PatchChunkSize, size.y) - top);
+        std::size_t position = 0;
+        std::size_t runs = reader.readCount();
+        for (std::size_t r = 0; r < runs && reader.isValid(); r++)
+        {
+            position += static_cast<std::size_t>(reader.readVarint());
+            std::size_t end = position + static_cast<std::size_t>(reader.readVarint());
+            if (end > cells)
+            {
+                return false;
+            }
+            while (position < end && reader.isValid())
+            {
+                std::size_t repeat = static_cast<std::size_t>(reader.readVarint());
+                unsigned int gid = static_cast<unsigned int>(reader.readVarint());
+                if (repeat == 0 || position + repeat > end)
+                {
+                    return false;
+                }
+                for (; repeat > 0; repeat--, position++)
+                {
+                    std::size_t cell = left + position % width + (top + position / width) * size.x;
+                    changes.cells.push_back(std::make_pair(cell, gid));
+                }
+            }
+        }
+    }
+    return reader.isValid();
+}
+
+void saveObjects(ObjectGroup* group, std::map<unsigned int, std::string>& objects)
+{
+    if (group != nullptr)
+    {
+        for (std::size_t i = 0; i < group->getObjectCount(); i++)
+        {
+            ObjectBase* object = group->getObject(i);
+            if (object->getId() != 0)
+            {
+                objects[object->getId()] = ObjectGroup::saveObject(*object);
+            }
+        }
+    }
+}
+
+bool readChanges(std::string const& patch, MapChanges& changes)
+{
+    if (patch.empty())
+    {
+        return false;
+    }
+    std::string data = patch.substr(1);
+    if (patch[0] == EPatchZlib)
+    {
+        if (!decompressString(data))
+        {
+            return false;
+        }
+    }
+    else if (patch[0] != EPatchRaw)
+    {
+        return false;
+    }
+
+    PatchReader reader(data);
+    changes.fromSize.x = static_cast<int>(reader.readVarint());
+    changes.fromSize.y = static_cast<int>(reader.readVarint());
+    changes.toSize.x = static_cast<int>(reader.readVarint());
+    changes.toSize.y = static_cast<int>(reader.readVarint());
+    bool resized = changes.fromSize != changes.toSize;
+    readProperties(reader, changes.properties);
+    changes.removedLayers.resize(reader.readCount());
+    for (std::size_t i = 0; i < changes.removedLayers.size(); i++)
+    {
+        changes.removedLayers[i] = reader.readString();
+    }
+    changes.order.resize(reader.readCount());
+    for (std::size_t i = 0; i < changes.order.size(); i++)
+    {
+        changes.order[i] = reader.readString();
+    }
+    changes.layers.resize(reader.readCount());
+    for (std::size_t i = 0; i < changes.layers.size() && reader.isValid(); i++)
+    {
+        LayerChanges& layer = changes.layers[i];
+        layer.name = reader.readString();
+        layer.type = (reader.readByte() == EObjectGroup) ? EObjectGroup : ELayer;
+        layer.flags = reader.readByte();
+        layer.opacity = (layer.flags & EPatchOpacity) ? reader.readFloat() : 1.f;
+        readProperties(reader, layer.properties);
+        if (layer.type == ELayer)
+        {
+            if (!readCells(reader, changes.toSize, !resized && !(layer.flags & EPatchCreated), layer))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            layer.removed.resize(reader.readCount());
+            unsigned int id = 0;
+            for (std::size_t j = 0; j < layer.removed.size(); j++)
+            {
+                id += static_cast<unsigned int>(reader.readVarint());
+                layer.removed[j] = id;
+            }
+            layer.objects.resize(reader.readCount());
+            for (std::size_t j = 0; j < layer.objects.size(); j++)
+            {
+                layer.objects[j] = reader.readString();
+            }
+        }
+    }
+    return reader.isValid() && reader.isFinished();
+}
+
+// Everything is checked before the first change, so a patch is applied entirely or not at all
+bool checkChanges(Map& map, MapChanges const& changes)
+{
+    if (map.getMapSize() != changes.fromSize)
+    {
+        return false;
+    }
+    bool resized = changes.fromSize != changes.toSize;
+    for (std::size_t i = 0; i < changes.removedLayers.size(); i++)
+    {
+        if (!isPatchable(findLayer(map, changes.removedLayers[i])))
+        {
+            return false;
+        }
+    }
+
+    // The objects of the removed groups leave the map before any object is added
+    std::vector<unsigned int> removed;
+    for (std::size_t i = 0; i < changes.removedLayers.size(); i++)
+    {
+        LayerBase* layer = findLayer(map, changes.removedLayers[i]);
+        if (layer->getLayerType() == EObjectGroup)
+        {
+            ObjectGroup* group = static_cast<ObjectGroup*>(layer);
+            for (std::size_t j = 0; j < group->getObjectCount(); j++)
+            {
+                removed.push_back(group->getObject(j)->getId());
+            }
+        }
+    }
+    for (std::size_t i = 0; i < changes.layers.size(); i++)
+    {
+        LayerChanges const& layer = changes.layers[i];
+        LayerBase* current = findLayer(map, layer.name);
+        if ((layer.flags & EPatchCreated) != 0)
+        {
+            if (current != nullptr && std::find(changes.removedLayers.begin(), changes.removedLayers.end(), layer.name) == changes.removedLayers.end())
+            {
+                return false;
+            }
+            continue;
+        }
+        if (current == nullptr || current->getLayerType() != layer.type)
+        {
+            return false;
+        }
+        if (layer.type == ELayer && !resized)
+        {
+            const std::vector<unsigned int>& tiles = static_cast<Layer*>(current)->getTileIds();
+            sf::Vector2i chunks((changes.toSize.x + PatchChunkSize - 1) / PatchChunkSize, 0);
+            for (std::size_t j = 0; j < layer.bases.size(); j++)
+            {
+                sf::Vector2i chunk(layer.bases[j].first % chunks.x, layer.bases[j].first / chunks.x);
+                if (hashChunk(tiles, changes.toSize, chunk) != layer.bases[j].second)
+                {
+                    return false;
+                }
+            }
+        }
+        for (std::size_t j = 0; j < layer.removed.size(); j++)
+        {
+            if (static_cast<ObjectGroup*>(current)->getObjectById(layer.removed[j]) == nullptr)
+            {
+                return false;
+            }
+            removed.push_back(layer.removed[j]);
+        }
+    }
+
+    // The new order holds every patchable layer left on the map once, and the created ones
+    if (!changes.order.empty())
+    {
+        std::vector<std::string> order = getLayerOrder(map);
+        std::vector<std::string> removedLayers = changes.removedLayers;
+        std::sort(removedLayers.begin(), removedLayers.end());
+        order.erase(std::remove_if(order.begin(), order.end(), [&removedLayers](std::string const& name)
+        {
+            return std::binary_search(removedLayers.begin(), removedLayers.end(), name);
+        }), order.end());
+        for (std::size_t i = 0; i < changes.layers.size(); i++)
+        {
+            if ((changes.layers[i].flags & EPatchCreated) != 0)
+            {
+                order.push_back(changes.layers[i].name);
+            }
+        }
+        std::vector<std::string> expected = changes.order;
+        std::sort(order.begin(), order.end());
+        std::sort(expected.begin(), expected.end());
+        if (order != expected)
+        {
+            return false;
+        }
+    }
+
+    // Added objects must not collide with the ones staying on the map
+    std::sort(removed.begin(), removed.end());
+    for (std::size_t i = 0; i < changes.layers.size(); i++)
+    {
+        for (std::size_t j = 0; j < changes.layers[i].objects.size(); j++)
+        {
+            pugi::xml_document doc;
+            if (!doc.load_string(changes.layers[i].objects[j].c_str()))
+            {
+                return false;
+            }
+            unsigned int id = doc.first_child().attribute("id").as_uint();
+            if (map.getObjectById(id) != nullptr && !std::binary_search(removed.begin(), removed.end(), id))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+std::string createPatch(Map& from, Map& to)
+{
+    detail::PatchWriter writer;
+    sf::Vector2i fromSize = from.getMapSize();
+    sf::Vector2i toSize = to.getMapSize();
+    bool resized = fromSize != toSize;
+    bool changed = resized;
+
+    writer.writeVarint(fromSize.x);
+    writer.writeVarint(fromSize.y);
+    writer.writeVarint(toSize.x);
+    writer.writeVarint(toSize.y);
+
+    detail::PropertyChanges properties;
+    detail::diffProperties(&from, to, properties);
+    detail::writeProperties(writer, properties);
+    changed = changed || !properties.set.empty() || !properties.removed.empty();
+
+    std::vector<std::string> removedLayers;
+    for (std::size_t i = 0; i < from.getLayerCount(); i++)
+    {
+        LayerBase* layer = from.getLayer(i);
+        LayerBase* other = detail::findLayer(to, layer->getName());
+        if (detail::isPatchable(layer) && (other == nullptr || other->getLayerType() != layer->getLayerType()))
+        {
+            removedLayers.push_back(layer->getName());
+        }
+    }
+    writer.writeVarint(removedLayers.size());
+    for (std::size_t i = 0; i < removedLayers.size(); i++)
+    {
+        writer.writeString(removedLayers[i]);
+    }
+    changed = changed || !removedLayers.empty();
+
+    // The order is written when it changed, created and removed layers change it too
+    std::vector<std::string> fromOrder = detail::getLayerOrder(from);
+    std::vector<std::string> toOrder = detail::getLayerOrder(to);
+    fromOrder.erase(std::remove_if(fromOrder.begin(), fromOrder.end(), [&removedLayers](std::string const& name)
+    {
+        return std::find(removedLayers.begin(), removedLayers.end(), name) != removedLayers.end();
+    }), fromOrder.end());
+    if (fromOrder == toOrder)
+    {
+        toOrder.clear();
+    }
+    writer.writeVarint(toOrder.size());
+    for (std::size_t i = 0; i < toOrder.size(); i++)
+    {
+        writer.writeString(toOrder[i]);
+    }
+    changed = changed || !toOrder.empty();
+
+    // Each layer is written to its own buffer, and only kept when something changed
+    std::vector<std::string> layers;
+    for (std::size_t i = 0; i < to.getLayerCount(); i++)
+    {
+        LayerBase* layer = to.getLayer(i);
+        LayerBase* previous = detail::findLayer(from, layer->getName());
+        if (!detail::isPatchable(layer))
+        {
+            continue;
+        }
+        if (previous != nullptr && previous->getLayerType() != layer->getLayerType())
+        {
+            previous = nullptr;
+        }
+
+        detail::PatchWriter body;
+        bool modified = previous == nullptr || resized;
+        if (layer->getLayerType() == ELayer)
+        {
+            detail::diffCells((resized) ? nullptr : static_cast<Layer*>(previous), *static_cast<Layer*>(layer), toSize, previous != nullptr && !resized, body);
+            modified = modified || body.getData() != std::string(1, '\0');
+        }
+        else
+        {
+            std::map<unsigned int, std::string> before;
+            std::map<unsigned int, std::string> after;
+            detail::saveObjects(static_cast<ObjectGroup*>(previous), before);
+            detail::saveObjects(static_cast<ObjectGroup*>(layer), after);
+
+            std::vector<unsigned int> removed;
+            std::vector<std::string> objects;
+            for (auto itr = before.begin(); itr != before.end(); itr++)
+            {
+                auto found = after.find(itr->first);
+                if (found == after.end() || found->second != itr->second)
+                {
+                    removed.push_back(itr->first);
+                }
+            }
+            for (auto itr = after.begin(); itr != after.end(); itr++)
+            {
+                auto found = before.find(itr->first);
+                if (found == before.end() || found->second != itr->second)
+                {
+                    objects.push_back(itr->second);
+                }
+            }
+            body.writeVarint(removed.size());
+            unsigned int id = 0;
+            for (std::size_t j = 0; j < removed.size(); j++)
+            {
+                body.writeVarint(removed[j] - id);
+                id = removed[j];
+            }
+            body.writeVarint(objects.size());
+            for (std::size_t j = 0; j < objects.size(); j++)
+            {
+                body.writeString(objects[j]);
+            }
+            modified = modified || !removed.empty() || !objects.empty();
+        }
+
+        detail::PropertyChanges layerProperties;
+        detail::diffProperties(previous, *layer, layerProperties);
+        modified = modified || !layerProperties.set.empty() || !layerProperties.removed.empty();
+        modified = modified || previous->isVisible() != layer->isVisible() || previous->getOpacity() != layer->getOpacity();
+        if (!modified)
+        {
+            continue;
+        }
+
+        detail::PatchWriter header;
+        header.writeString(layer->getName());
+        header.writeByte(static_cast<unsigned char>(layer->getLayerType()));
+        unsigned char flags = 0;
+        flags |= (previous == nullptr) ? detail::EPatchCreated : 0;
+        flags |= (layer->isVisible()) ? detail::EPatchVisible : 0;
+        flags |= (layer->getOpacity() != 1.f) ? detail::EPatchOpacity : 0;
+        header.writeByte(flags);
+        if (flags & detail::EPatchOpacity)
+        {
+            header.writeFloat(layer->getOpacity());
+        }
+        detail::writeProperties(header, layerProperties);
+        layers.push_back(header.getData() + body.getData());
+    }
+    writer.writeVarint(layers.size());
+    for (std::size_t i = 0; i < layers.size(); i++)
+    {
+        writer.getData().append(layers[i]);
+    }
+    changed = changed || !layers.empty();
+
+    if (!changed)
+    {
+        return "";
+    }
+
+    // Small patches are often larger once compressed
+    std::string compressed = writer.getData();
+    if (compressString(compressed) && compressed.size() < writer.getData().size())
+    {
+        return std::string(1, static_cast<char>(detail::EPatchZlib)) + compressed;
+    }
+    return std::string(1, static_cast<char>(detail::EPatchRaw)) + writer.getData();
+}
+
+bool applyPatch(Map& map, std::string const& patch)
+{
+    detail::MapChanges changes;
+    if (!detail::readChanges(patch, changes) || !detail::checkChanges(map, changes))
+    {
+        detail::log("Unable to apply a patch, it is corrupted or the map is not in the state it was created from");
+        return false;
+    }
+    bool resized = changes.fromSize != changes.toSize;
+
+    detail::applyProperties(map, changes.properties);
+    for (std::size_t i = 0; i < changes.removedLayers.size(); i++)
+    {
+        map.removeLayer(changes.removedLayers[i]);
+    }
+    if (resized)
+    {
+        map.setMapSize(changes.toSize);
+    }
+
+    // Removed objects first, as objects moving to another group are removed from one and added to the other
+    for (std::size_t i = 0; i < changes.layers.size(); i++)
+    {
+        detail::LayerChanges const& layer = changes.layers[i];
+        if (!layer.removed.empty())
+        {
+            ObjectGroup* group = static_cast<ObjectGroup*>(detail::findLayer(map, layer.name));
+            for (std::size_t j = 0; j < layer.removed.size(); j++)
+            {
+                group->removeObject(layer.removed[j]);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < changes.layers.size(); i++)
+    {
+        detail::LayerChanges const& layer = changes.layers[i];
+        LayerBase* current = detail::findLayer(map, layer.name);
+        if (current == nullptr)
+        {
+            if (layer.type == ELayer)
+            {
+                current = map.createLayer<Layer>(layer.name);
+            }
+            else
+            {
+                current = map.createLayer<ObjectGroup>(layer.name);
+            }
+
+            // Right after the patchable layer drawn before it in the new order, or first without one
+            std::size_t index = 0;
+            auto itr = std::find(changes.order.begin(), changes.order.end(), layer.name);
+            for (std::size_t j = 0; itr != changes.order.begin() && itr != changes.order.end() && j < map.getLayerCount(); j++)
+            {
+                if (map.getLayer(j)->getName() == *(itr - 1))
+                {
+                    index = j + 1;
+                }
+            }
+            map.moveLayer(layer.name, index);
+        }
+        detail::applyProperties(*current, layer.properties);
+        current->setVisible((layer.flags & detail::EPatchVisible) != 0);
+        bool opacity = current->getOpacity() != layer.opacity;
+        current->setOpacity(layer.opacity);
+
+        if (layer.type == ELayer)
+        {
+            // The changed cells are pasted at once over the area holding them, so the layer is updated in one pass
+            // A resized layer is written again whole, from empty cells
+            Layer* tiles = static_cast<Layer*>(current);
+            sf::IntRect area(0, 0, changes.toSize.x, changes.toSize.y);
+            std::vector<unsigned int> gids;
+            if (!resized && !layer.cells.empty())
+            {
+                sf::Vector2i min(changes.toSize.x, changes.toSize.y);
+                sf::Vector2i max(0, 0);
+                for (std::size_t j = 0; j < layer.cells.size(); j++)
+                {
+                    sf::Vector2i coords(layer.cells[j].first % changes.toSize.x, layer.cells[j].first / changes.toSize.x);
+                    min = sf::Vector2i(std::min(min.x, coords.x), std::min(min.y, coords.y));
+                    max = sf::Vector2i(std::max(max.x, coords.x), std::max(max.y, coords.y));
+                }
+                area = sf::IntRect(min, max - min + sf::Vector2i(1, 1));
+                tiles->copy(area, gids);
+            }
+            else
+            {
+                gids.assign(area.width * area.height, 0);
+            }
+            for (std::size_t j = 0; j < layer.cells.size(); j++)
+            {
+                std::size_t cell = layer.cells[j].first;
+                gids[(cell % changes.toSize.x - area.left) + (cell / changes.toSize.x - area.top) * area.width] = layer.cells[j].second;
+            }
+            if (resized || !layer.cells.empty())
+            {
+                tiles->paste(sf::Vector2i(area.left, area.top), sf::Vector2i(area.width, area.height), gids);
+            }
+        }
+        else
+        {
+            ObjectGroup* group = static_cast<ObjectGroup*>(current);
+            for (std::size_t j = 0; j < layer.objects.size(); j++)
+            {
+                pugi::xml_document doc;
+                doc.load_string(layer.objects[j].c_str());
+                group->loadObject(doc.first_child());
+            }
+        }
+        if (opacity || resized)
+        {
+            current->update();
+        }
+    }
+
+    // The patchable layers take the places they hold in turn in the new order, the other layers keep theirs
+    if (!changes.order.empty())
+    {
+        std::vector<std::string> names;
+        std::size_t next = 0;
+        for (std::size_t i = 0; i < map.getLayerCount(); i++)
+        {
+            bool patchable = detail::isPatchable(map.getLayer(i));
+            names.push_back((patchable) ? changes.order[next++] : map.getLayer(i)->getName());
+        }
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            map.moveLayer(names[i], i);
+        }
+    }
+    return true;
+}
+
+} // namespace tmx
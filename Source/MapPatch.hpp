@@ -0,0 +1,24 @@
+#ifndef TMX_MAPPATCH_HPP
+#define TMX_MAPPATCH_HPP
+
+#include "Map.hpp"
+
+namespace tmx
+{
+
+// Binary patches between two states of a map : cells of the tile layers, objects of the object groups,
+// custom properties of the map and its layers, and the visibility and opacity of the layers
+// Cells are compared by chunks of 16x16, only the chunks whose hash differs are written, as runs of varints
+// Objects are written whole when they changed, and the patch is compressed with zlib when it gets smaller
+// The drawing order of the layers is written when it changed, a created layer goes right after the one before it
+// Other layer types are left untouched, in their place
+
+// Patch turning from into to, empty when both maps are the same
+std::string createPatch(Map& from, Map& to);
+
+// Applies a patch to a map in the state it was created from, or does nothing and returns false
+bool applyPatch(Map& map, std::string const& patch);
+
+} // namespace tmx
+
+#endif // TMX_MAPPATCH_HPP
@@ -8,7 +8,6 @@ namespace tmx
 
 Object::Object(ObjectGroup& group)
 : ObjectBase(group)
-, mShape()
 {
 }
 
@@ -17,81 +16,70 @@ ObjectType Object::getObjectType() const
     return tmx::ESimple;
 }
 
-void Object::update()
+const sf::Texture* Object::getTexture() const
 {
-    mShape.setSize(mSize);
-    if (mGid != 0)
+    if (getGid() != 0)
     {
-        Tileset* tileset = mGroup.getMap().getTileset(mGid);
-        if (tileset == nullptr)
+        Tileset* tileset = mGroup.getMap().getTileset(getGid());
+        if (tileset != nullptr)
         {
-            return;
+            return &tileset->getTexture();
         }
-        mShape.setTexture(&tileset->getTexture());
-        mShape.setTextureRect(tileset->toRect(mGid));
+    }
+    return nullptr;
+}
 
-        std::string orientation = mGroup.getMap().getOrientation();
-        if (orientation == "orthogonal")
+sf::FloatRect Object::getLocalBounds() const
+{
+    if (getGid() != 0)
+    {
+        // Tile objects are aligned on their bottom
+        if (mGroup.getMap().getOrientation() == "orthogonal")
         {
-            mShape.setOrigin(sf::Vector2f(0.f, mSize.x));
+            return sf::FloatRect(0.f, -getSize().y, getSize().x, getSize().y);
         }
         else
         {
-            mShape.setOrigin(mSize.x * 0.5f, mSize.y);
-        }
-        mShape.setRotation(mRotation);
-        mShape.setPosition(mPosition + getLayerOffset());
-
-        // TODO : O - Flip
-        /*
-        sf::Vector2f scale = sf::Vector2f(1.f, 1.f);
-        if (mFlippedHorizontally)
-        {
-            scale.x = -1.f;
-            mShape.move(mSize.x, 0.f);
+            return sf::FloatRect(-getSize().x * 0.5f, -getSize().y, getSize().x, getSize().y);
         }
-        if (mFlippedVertically)
-        {
-            scale.y = -1.f;
-            mShape.move(0.f, mSize.y);
-        }
-        mShape.setScale(scale);
-        */
-
-        mShape.setOutlineThickness(0.f);
-    }
-    else
-    {
-        mShape.setRotation(mRotation);
-        mShape.setOutlineThickness(2.f);
-        mShape.setPosition(mPosition + getLayerOffset() + getMapOffset());
     }
+    return sf::FloatRect(sf::Vector2f(), getSize());
 }
 
-void Object::setColor(sf::Color const& color)
+void Object::buildVertices(std::vector<sf::Vertex>& vertices) const
 {
-    if (mGid == 0)
+    sf::FloatRect rect = getLocalBounds();
+    sf::Vector2f a(rect.left, rect.top);
+    sf::Vector2f b(rect.left + rect.width, rect.top);
+    sf::Vector2f c(rect.left + rect.width, rect.top + rect.height);
+    sf::Vector2f d(rect.left, rect.top + rect.height);
+    if (getGid() != 0)
     {
-        sf::Color c = color;
-        c.a = 32;
-        mShape.setOutlineColor(color);
-        mShape.setFillColor(c);
+        Tileset* tileset = mGroup.getMap().getTileset(getGid());
+        if (tileset == nullptr)
+        {
+            return;
+        }
+        sf::FloatRect tex = static_cast<sf::FloatRect>(tileset->toRect(getGid()));
+        sf::Color color = sf::Color(255, 255, 255, mColor.a);
+
+        // TODO : O - Flip
+        appendQuad(vertices, a, b, c, d, color);
+        sf::Vertex* quad = &vertices[vertices.size() - 6];
+        quad[0].texCoords = sf::Vector2f(tex.left, tex.top);
+        quad[1].texCoords = sf::Vector2f(tex.left + tex.width, tex.top);
+        quad[2].texCoords = sf::Vector2f(tex.left + tex.width, tex.top + tex.height);
+        quad[3].texCoords = quad[2].texCoords;
+        quad[4].texCoords = sf::Vector2f(tex.left, tex.top + tex.height);
+        quad[5].texCoords = quad[0].texCoords;
     }
     else
     {
-        sf::Color c = color;
-        c.r = 255;
-        c.g = 255;
-        c.b = 255;
-        mShape.setFillColor(c);
-    }
-}
-
-void Object::draw(sf::RenderTarget& target, sf::RenderStates states) const
-{
-    if (mVisible)
-    {
-        target.draw(mShape, states);
+        sf::Color fill = mColor;
+        fill.a = 32;
+        appendQuad(vertices, a, b, c, d, fill);
+        std::vector<sf::Vector2f> points = {a, b, c, d};
+        appendOutline(vertices, points, true, mColor);
     }
 }
 
@@ -15,14 +15,11 @@ class Object : public ObjectBase
 
         ObjectType getObjectType() const;
 
-        void update();
+        const sf::Texture* getTexture() const;
 
-        void setColor(sf::Color const& color);
-
-        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
-
-    private:
-        sf::RectangleShape mShape;
+    protected:
+        sf::FloatRect getLocalBounds() const;
+        void buildVertices(std::vector<sf::Vertex>& vertices) const;
 };
 
 }
@@ -1,22 +1,19 @@
 #include "ObjectBase.h"
 #include "ObjectGroup.hpp"
+#include "Map.hpp"
 
 namespace tmx
 {
 
+const float ObjectBase::OutlineThickness = 2.f;
+
 ObjectBase::ObjectBase(ObjectGroup& group)
 : mGroup(group)
-, mId(0)
-, mGid(0)
+, mSlot(group.getStorage().add(this))
 , mName("")
-, mType("")
-, mPosition({0.f, 0.f})
-, mSize({0.f, 0.f})
-, mRotation(0.f)
-, mVisible(true)
-, mFlippedHorizontally(false)
-, mFlippedVertically(false)
-, mFlippedDiagonally(false)
+, mColor(sf::Color::White)
+, mVertices()
+, mNeedsUpdate(true)
 {
 }
 
@@ -26,16 +23,22 @@ void ObjectBase::loadFromNode(pugi::xml_node const& object)
     {
         return;
     }
+    detail::ObjectStorage& storage = getStorage();
     for (pugi::xml_attribute attr = object.first_attribute(); attr; attr = attr.next_attribute())
     {
         if (attr.name() == std::string("id"))
         {
-            mId = attr.as_uint();
+            storage.ids[mSlot] = attr.as_uint();
         }
         if (attr.name() == std::string("gid"))
         {
-            mGid = attr.as_uint();
-            detail::readFlip(mGid, mFlippedHorizontally, mFlippedVertically, mFlippedDiagonally);
+            unsigned int gid = attr.as_uint();
+            bool horizontal, vertical, diagonal;
+            detail::readFlip(gid, horizontal, vertical, diagonal);
+            storage.gids[mSlot] = gid;
+            storage.setFlag(mSlot, EFlippedHorizontally, horizontal);
+            storage.setFlag(mSlot, EFlippedVertically, vertical);
+            storage.setFlag(mSlot, EFlippedDiagonally, diagonal);
         }
         if (attr.name() == std::string("name"))
         {
@@ -43,35 +46,33 @@ void ObjectBase::loadFromNode(pugi::xml_node const& object)
         }
         if (attr.name() == std::string("type"))
         {
-            mType = attr.as_string();
+            storage.types[mSlot] = mGroup.getMap().getTypeHandle(attr.as_string());
         }
         if (attr.name() == std::string("x"))
         {
-            mPosition.x = attr.as_float();
+            storage.positions[mSlot].x = attr.as_float();
         }
         if (attr.name() == std::string("y"))
         {
-            mPosition.y = attr.as_float();
+            storage.positions[mSlot].y = attr.as_float();
         }
         if (attr.name() == std::string("width"))
         {
-            mSize.x = attr.as_float();
+            storage.sizes[mSlot].x = attr.as_float();
         }
         if (attr.name() == std::string("height"))
         {
-            mSize.y = attr.as_float();
+            storage.sizes[mSlot].y = attr.as_float();
         }
         if (attr.name() == std::string("rotation"))
         {
-            mRotation = attr.as_float();
+            storage.rotations[mSlot] = attr.as_float();
         }
         if (attr.name() == std::string("visible"))
         {
-            mVisible = detail::fromString<bool>(attr.as_string());
+            storage.setFlag(mSlot, EVisible, detail::fromString<bool>(attr.as_string()));
         }
     }
-    update();
-    mGroup.sort(mGroup.getDrawOrder());
     loadProperties(object);
 }
 
@@ -81,35 +82,36 @@ void ObjectBase::saveToNode(pugi::xml_node& object)
     {
         return;
     }
-    if (mId != 0)
+    if (getId() != 0)
     {
-        object.append_attribute("id") = mId;
+        object.append_attribute("id") = getId();
     }
-    if (mGid != 0)
+    if (getGid() != 0)
     {
-        object.append_attribute("gid") = mGid;
-        // TODO : O - Save Flip
+        unsigned int gid = getGid();
+        detail::writeFlip(gid, isFlippedHorizontally(), isFlippedVertically(), isFlippedDiagonally());
+        object.append_attribute("gid") = gid;
     }
     if (mName != "")
     {
         object.append_attribute("name") = mName.c_str();
     }
-    if (mType != "")
+    if (getType() != "")
     {
-        object.append_attribute("type") = mType.c_str();
+        object.append_attribute("type") = getType().c_str();
     }
-    object.append_attribute("x") = mPosition.x;
-    object.append_attribute("y") = mPosition.y;
-    if (mSize != sf::Vector2f())
+    object.append_attribute("x") = getPosition().x;
+    object.append_attribute("y") = getPosition().y;
+    if (getSize() != sf::Vector2f())
     {
-        object.append_attribute("width") = mSize.x;
-        object.append_attribute("height") = mSize.y;
+        object.append_attribute("width") = getSize().x;
+        object.append_attribute("height") = getSize().y;
     }
-    if (mRotation != 0.f)
+    if (getRotation() != 0.f)
     {
-        object.append_attribute("rotation") = mRotation;
+        object.append_attribute("rotation") = getRotation();
     }
-    if (!mVisible)
+    if (!isVisible())
     {
         object.append_attribute("visible") = "false";
     }
@@ -118,12 +120,12 @@ void ObjectBase::saveToNode(pugi::xml_node& object)
 
 unsigned int ObjectBase::getId() const
 {
-    return mId;
+    return getStorage().ids[mSlot];
 }
 
 unsigned int ObjectBase::getGid() const
 {
-    return mGid;
+    return getStorage().gids[mSlot];
 }
 
 const std::string& ObjectBase::getName() const
@@ -133,76 +135,134 @@ const std::string& ObjectBase::getName() const
 
 const std::string& ObjectBase::getType() const
 {
-    return mType;
+    return mGroup.getMap().getTypeName(getStorage().types[mSlot]);
 }
 
 const sf::Vector2f& ObjectBase::getPosition() const
 {
-    return mPosition;
+    return getStorage().positions[mSlot];
 }
 
 const sf::Vector2f& ObjectBase::getSize() const
 {
-    return mSize;
+    return getStorage().sizes[mSlot];
 }
 
 float ObjectBase::getRotation() const
 {
-    return mRotation;
+    return getStorage().rotations[mSlot];
 }
 
 bool ObjectBase::isVisible() const
 {
-    return mVisible;
+    return getStorage().hasFlag(mSlot, EVisible);
+}
+
+bool ObjectBase::isFlippedHorizontally() const
+{
+    return getStorage().hasFlag(mSlot, EFlippedHorizontally);
+}
+
+bool ObjectBase::isFlippedVertically() const
+{
+    return getStorage().hasFlag(mSlot, EFlippedVertically);
+}
+
+bool ObjectBase::isFlippedDiagonally() const
+{
+    return getStorage().hasFlag(mSlot, EFlippedDiagonally);
+}
+
+std::size_t ObjectBase::getSlot() const
+{
+    return mSlot;
 }
 
 void ObjectBase::setId(unsigned int id)
 {
-    mId = id;
-    mGroup.sort(mGroup.getDrawOrder());
+    ObjectBase* other = (id != 0) ? mGroup.getMap().getObjectById(id) : nullptr;
+    if (other != nullptr && other != this)
+    {
+        detail::log("Object id " + detail::toString(id) + " is already used");
+        return;
+    }
+    unsigned int previousId = getId();
+    mGroup.notifyChanging(*this);
+    getStorage().ids[mSlot] = id;
+    mGroup.indexObject(this, previousId);
+    mGroup.updateObjectOrder(this);
+
+    // Seen as the object created under its new id and the one with the previous id removed,
+    // the new id comes first so a listener handling each change alone sees the whole rename
+    mGroup.notifyChanged(id);
+    mGroup.notifyChanged(previousId);
 }
 
 void ObjectBase::setGid(unsigned int gid)
 {
-    mGid = gid;
+    mGroup.notifyChanging(*this);
+    getStorage().gids[mSlot] = gid;
     update();
-    mGroup.sort(mGroup.getDrawOrder());
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setName(std::string const& name)
 {
+    mGroup.notifyChanging(*this);
     mName = name;
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setType(std::string const& type)
 {
-    mType = type;
+    mGroup.notifyChanging(*this);
+    getStorage().types[mSlot] = mGroup.getMap().getTypeHandle(type);
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setPosition(sf::Vector2f const& position)
 {
-    mPosition = position;
+    mGroup.notifyChanging(*this);
+    getStorage().positions[mSlot] = position;
     update();
-    mGroup.sort(mGroup.getDrawOrder());
+    mGroup.updateObjectOrder(this);
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setSize(sf::Vector2f const& size)
 {
-    mSize = size;
+    mGroup.notifyChanging(*this);
+    getStorage().sizes[mSlot] = size;
     update();
-    mGroup.sort(mGroup.getDrawOrder());
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setRotation(float rotation)
 {
-    mRotation = rotation;
+    mGroup.notifyChanging(*this);
+    getStorage().rotations[mSlot] = rotation;
     update();
-    mGroup.sort(mGroup.getDrawOrder());
+    mGroup.notifyChanged(getId());
 }
 
 void ObjectBase::setVisible(bool visible)
 {
-    mVisible = visible;
+    mGroup.notifyChanging(*this);
+    getStorage().setFlag(mSlot, EVisible, visible);
+    mGroup.invalidate();
+    mGroup.notifyChanged(getId());
+}
+
+void ObjectBase::setColor(sf::Color const& color)
+{
+    mColor = color;
+    mNeedsUpdate = true;
+    mGroup.invalidate();
+}
+
+const sf::Color& ObjectBase::getColor() const
+{
+    return mColor;
 }
 
 const sf::Vector2f& ObjectBase::getLayerOffset() const
@@ -225,8 +285,112 @@ void ObjectBase::setMapOffset(sf::Vector2f const& offset)
     mGroup.getMap().setMapOffset(offset);
 }
 
+sf::Transform ObjectBase::getTransform() const
+{
+    sf::Transform transform;
+    transform.translate(getPosition() + getLayerOffset() + getMapOffset());
+    transform.rotate(getRotation());
+    return transform;
+}
+
+const sf::FloatRect& ObjectBase::getBounds() const
+{
+    return getStorage().bounds[mSlot];
+}
+
+const std::vector<sf::Vertex>& ObjectBase::getVertices() const
+{
+    ensureVerticesUpdated();
+    return mVertices;
+}
+
+const sf::Texture* ObjectBase::getTexture() const
+{
+    return nullptr;
+}
+
+void ObjectBase::invalidateVertices() const
+{
+    mNeedsUpdate = true;
+}
+
+void ObjectBase::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    if (isVisible())
+    {
+        ensureVerticesUpdated();
+        if (!mVertices.empty())
+        {
+            states.texture = getTexture();
+            target.draw(mVertices.data(), mVertices.size(), sf::Triangles, states);
+        }
+    }
+}
+
 void ObjectBase::update()
 {
+    sf::FloatRect local = getLocalBounds();
+    const float margin = OutlineThickness * 0.5f;
+    local.left -= margin;
+    local.top -= margin;
+    local.width += 2.f * margin;
+    local.height += 2.f * margin;
+    getStorage().bounds[mSlot] = getTransform().transformRect(local);
+    mNeedsUpdate = true;
+    mGroup.invalidate();
+}
+
+detail::ObjectStorage& ObjectBase::getStorage() const
+{
+    return mGroup.getStorage();
+}
+
+void ObjectBase::ensureVerticesUpdated() const
+{
+    if (!mNeedsUpdate)
+    {
+        return;
+    }
+    mVertices.clear();
+    buildVertices(mVertices);
+    sf::Transform transform = getTransform();
+    for (std::size_t i = 0; i < mVertices.size(); i++)
+    {
+        mVertices[i].position = transform.transformPoint(mVertices[i].position);
+    }
+    mNeedsUpdate = false;
+}
+
+void ObjectBase::appendQuad(std::vector<sf::Vertex>& vertices, sf::Vector2f const& a, sf::Vector2f const& b, sf::Vector2f const& c, sf::Vector2f const& d, sf::Color const& color)
+{
+    vertices.push_back(sf::Vertex(a, color));
+    vertices.push_back(sf::Vertex(b, color));
+    vertices.push_back(sf::Vertex(c, color));
+    vertices.push_back(sf::Vertex(c, color));
+    vertices.push_back(sf::Vertex(d, color));
+    vertices.push_back(sf::Vertex(a, color));
+}
+
+void ObjectBase::appendOutline(std::vector<sf::Vertex>& vertices, std::vector<sf::Vector2f> const& points, bool closed, sf::Color const& color)
+{
+    if (points.size() < 2)
+    {
+        return;
+    }
+    const std::size_t count = (closed) ? points.size() : points.size() - 1;
+    vertices.reserve(vertices.size() + count * 6);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        sf::Vector2f a = points[i];
+        sf::Vector2f b = points[(i + 1) % points.size()];
+        sf::Vector2f diff = b - a;
+        float length = std::sqrt(diff.x * diff.x + diff.y * diff.y);
+        if (length > 0.f)
+        {
+            sf::Vector2f normal = sf::Vector2f(-diff.y, diff.x) * (OutlineThickness * 0.5f / length);
+            appendQuad(vertices, a + normal, b + normal, b - normal, a - normal, color);
+        }
+    }
 }
 
 }
@@ -7,6 +7,11 @@ namespace tmx
 {
 
 class ObjectGroup;
+namespace detail
+{
+struct ObjectStorage;
+}
+
 class ObjectBase : public detail::PropertiesHolder, public sf::Drawable
 {
     public:
@@ -17,7 +22,8 @@ class ObjectBase : public detail::PropertiesHolder, public sf::Drawable
         virtual void loadFromNode(pugi::xml_node const& object);
         virtual void saveToNode(pugi::xml_node& object);
 
-        virtual void setColor(sf::Color const& color) = 0;
+        void setColor(sf::Color const& color);
+        const sf::Color& getColor() const;
 
         unsigned int getId() const;
         unsigned int getGid() const;
@@ -27,6 +33,10 @@ class ObjectBase : public detail::PropertiesHolder, public sf::Drawable
         const sf::Vector2f& getSize() const;
         float getRotation() const;
         bool isVisible() const;
+        bool isFlippedHorizontally() const;
+        bool isFlippedVertically() const;
+        bool isFlippedDiagonally() const;
+        std::size_t getSlot() const;
 
         void setId(unsigned int id);
         void setGid(unsigned int gid);
@@ -43,24 +53,38 @@ class ObjectBase : public detail::PropertiesHolder, public sf::Drawable
         const sf::Vector2f& getMapOffset() const;
         void setMapOffset(sf::Vector2f const& offset);
 
-        virtual void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const = 0;
+        sf::Transform getTransform() const;
+        const sf::FloatRect& getBounds() const;
+        const std::vector<sf::Vertex>& getVertices() const;
+        virtual const sf::Texture* getTexture() const;
+        void invalidateVertices() const;
+
+        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
 
         virtual void update();
 
     protected:
+        virtual sf::FloatRect getLocalBounds() const = 0;
+        virtual void buildVertices(std::vector<sf::Vertex>& vertices) const = 0;
+        void ensureVerticesUpdated() const;
+
+        static void appendQuad(std::vector<sf::Vertex>& vertices, sf::Vector2f const& a, sf::Vector2f const& b, sf::Vector2f const& c, sf::Vector2f const& d, sf::Color const& color);
+        static void appendOutline(std::vector<sf::Vertex>& vertices, std::vector<sf::Vector2f> const& points, bool closed, sf::Color const& color);
+
+        static const float OutlineThickness;
+
+        detail::ObjectStorage& getStorage() const;
+
+    protected:
+        friend struct detail::ObjectStorage;
+
         ObjectGroup& mGroup;
-        unsigned int mId;
-        unsigned int mGid;
+        std::size_t mSlot; // Index of the object data in the group storage
         std::string mName;
-        std::string mType;
-        sf::Vector2f mPosition;
-        sf::Vector2f mSize;
-        float mRotation;
-        bool mVisible;
-
-        bool mFlippedHorizontally;
-        bool mFlippedVertically;
-        bool mFlippedDiagonally;
+
+        sf::Color mColor;
+        mutable std::vector<sf::Vertex> mVertices;
+        mutable bool mNeedsUpdate;
 };
 
 }
@@ -8,14 +8,78 @@
 namespace tmx
 {
 
+namespace
+{
+
+struct DrawOrder
+{
+    DrawOrder(std::string const& order, detail::ObjectStorage const& storage) : byIndex(order == "index"), storage(storage) {}
+
+    double key(std::size_t slot) const
+    {
+        return (byIndex) ? static_cast<double>(storage.ids[slot]) : storage.positions[slot].y;
+    }
+
+    bool operator()(ObjectBase const* a, ObjectBase const* b) const
+    {
+        if (a == nullptr || b == nullptr)
+        {
+            return false;
+        }
+        if (byIndex)
+        {
+            return (storage.ids[a->getSlot()] < storage.ids[b->getSlot()]);
+        }
+        return (storage.positions[a->getSlot()].y < storage.positions[b->getSlot()].y);
+    }
+
+    bool byIndex;
+    detail::ObjectStorage const& storage;
+};
+
+bool contains(sf::FloatRect const& outer, sf::FloatRect const& inner)
+{
+    return outer.left <= inner.left && outer.top <= inner.top
+        && inner.left + inner.width <= outer.left + outer.width
+        && inner.top + inner.height <= outer.top + outer.height;
+}
+
+} // namespace
+
 ObjectGroup::ObjectGroup(Map& map)
 : mMap(map)
 , mColor("#a0a0a4")
 , mDrawOrder("topdown")
 , mObjects()
+, mPending()
+, mRemoved(0)
+, mIndex()
+, mStorage()
+, mPool(std::max({sizeof(Object), sizeof(Ellipse), sizeof(Polygon), sizeof(Polyline)}))
+, mListeners()
+, mBatches()
+, mCulling()
+, mBatchArea()
+, mBatchDirty(true)
+, mPixelScale(1.f)
 {
 }
 
+ObjectGroup::~ObjectGroup()
+{
+    ensureOrdered();
+    for (std::size_t i = 0; i < mObjects.size(); i++)
+    {
+        if (mObjects[i].object != nullptr)
+        {
+            mMap.unindexObject(mObjects[i].object);
+            destroyObject(mObjects[i].object);
+        }
+    }
+    mObjects.clear();
+    mIndex.clear();
+}
+
 LayerType ObjectGroup::getLayerType() const
 {
     return tmx::EObjectGroup;
@@ -42,27 +106,23 @@ bool ObjectGroup::loadFromNode(pugi::xml_node const& layer)
     {
         return false;
     }
+    std::size_t count = 0;
     for (pugi::xml_node object = layer.child("object"); object; object = object.next_sibling("object"))
     {
-        if (object.child("ellipse"))
-        {
-            mObjects.push_back(new Ellipse(*this));
-        }
-        else if (object.child("polygon"))
-        {
-            mObjects.push_back(new Polygon(*this));
-        }
-        else if (object.child("polyline"))
-        {
-            mObjects.push_back(new Polyline(*this));
-        }
-        else
+        count++;
+    }
+    mPending.reserve(mPending.size() + count);
+    for (pugi::xml_node object = layer.child("object"); object; object = object.next_sibling("object"))
+    {
+        ObjectBase* obj = readObject(object);
+        if (obj != nullptr)
         {
-            mObjects.push_back(new Object(*this));
+            pushPending(obj, 0.0);
+            indexObject(obj, 0);
         }
-        mObjects.back()->loadFromNode(object);
     }
-    update();
+    update(); // Objects are only sorted once, after all of them are loaded
+
     return true;
 }
 
@@ -81,21 +141,28 @@ void ObjectGroup::saveToNode(pugi::xml_node& layer)
         layer.append_attribute("draworder") = mDrawOrder.c_str();
     }
     LayerBase::saveToNode(layer);
-    sort("index");
+    ensureOrdered();
+    std::vector<ObjectBase*> objects(mObjects.size());
     for (std::size_t i = 0; i < mObjects.size(); i++)
+    {
+        objects[i] = mObjects[i].object;
+    }
+    std::stable_sort(objects.begin(), objects.end(), DrawOrder("index", mStorage));
+    for (std::size_t i = 0; i < objects.size(); i++)
     {
         pugi::xml_node object = layer.append_child("object");
-        mObjects[i]->saveToNode(object);
+        objects[i]->saveToNode(object);
     }
 }
 
 void ObjectGroup::update()
 {
     sf::Color color = getColor();
+    ensureOrdered();
     for (std::size_t i = 0; i < mObjects.size(); i++)
     {
-        mObjects[i]->setColor(color); // Apply color and opacity
-        mObjects[i]->update();
+        mObjects[i].object->setColor(color); // Apply color and opacity
+        mObjects[i].object->update();
     }
     sort(mDrawOrder);
 }
@@ -104,9 +171,28 @@ void ObjectGroup::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
     if (mVisible)
     {
-        for (std::size_t i = 0; i < mObjects.size(); i++)
+        // Visible area in the coordinates of the objects
+        const sf::View& view = target.getView();
+        sf::Vector2f size = view.getSize();
+        if (view.getRotation() != 0.f)
         {
-            target.draw(*mObjects.at(i), states);
+            float diagonal = std::sqrt(size.x * size.x + size.y * size.y);
+            size = sf::Vector2f(diagonal, diagonal);
+        }
+        sf::FloatRect area(view.getCenter() - size * 0.5f, size);
+        area = states.transform.getInverse().transformRect(area);
+        float pixelScale = (view.getSize().x != 0.f) ? target.getSize().x * view.getViewport().width / view.getSize().x : 1.f;
+
+        ensureBatchUpdated(area, pixelScale);
+
+        // Runs of objects in draw order, the batches left over from a previous update are empty
+        for (std::size_t i = 0; i < mBatches.size(); i++)
+        {
+            if (!mBatches[i].vertices.empty())
+            {
+                states.texture = mBatches[i].texture;
+                target.draw(mBatches[i].vertices.data(), mBatches[i].vertices.size(), sf::Triangles, states);
+            }
         }
     }
 }
@@ -122,9 +208,10 @@ void ObjectGroup::setColor(sf::Color const& color)
 {
     setOpacity((float)color.a / 255.f);
     mColor = detail::toString<sf::Color>(color);
+    ensureOrdered();
     for (std::size_t i = 0; i < mObjects.size(); i++)
     {
-        mObjects[i]->setColor(color);
+        mObjects[i].object->setColor(color);
     }
 }
 
@@ -144,48 +231,259 @@ void ObjectGroup::setDrawOrder(std::string const& order)
 
 void ObjectGroup::sort(std::string const& order)
 {
-    if (order == "index")
+    // The keys are kept with the objects instead of chasing each object for its key at every comparison
+    // Objects waiting to be merged are sorted with the others
+    DrawOrder drawOrder(order, mStorage);
+    mObjects.insert(mObjects.end(), mPending.begin(), mPending.end());
+    mPending.clear();
+    mObjects.erase(std::remove_if(mObjects.begin(), mObjects.end(), [](DrawEntry const& e)
     {
-        std::sort(mObjects.begin(),mObjects.end(),[](ObjectBase* a, ObjectBase* b)
-        {
-            if (a == nullptr || b == nullptr)
-            {
-                return false;
-            }
-            return (a->getId() < b->getId());
-        });
+        return e.object == nullptr;
+    }), mObjects.end());
+    mRemoved = 0;
+    for (std::size_t i = 0; i < mObjects.size(); i++)
+    {
+        mObjects[i].key = drawOrder.key(mObjects[i].object->getSlot());
+    }
+    std::stable_sort(mObjects.begin(), mObjects.end(), [](DrawEntry const& a, DrawEntry const& b)
+    {
+        return a.key < b.key;
+    });
+    setOrders();
+    mBatchDirty = true;
+}
+
+void ObjectGroup::insertObject(ObjectBase* object)
+{
+    pushPending(object, DrawOrder(mDrawOrder, mStorage).key(object->getSlot()));
+    mBatchDirty = true;
+}
+
+void ObjectGroup::updateObjectOrder(ObjectBase* object)
+{
+    DrawEntry* entry = findEntry(object);
+    if (entry == nullptr)
+    {
+        return;
+    }
+    double key = DrawOrder(mDrawOrder, mStorage).key(object->getSlot());
+    std::size_t index = mStorage.orders[object->getSlot()];
+    if (index >= mObjects.size())
+    {
+        entry->key = key;
+    }
+    else if ((index > 0 && key < mObjects[index - 1].key) || (index + 1 < mObjects.size() && mObjects[index + 1].key < key))
+    {
+        // Out of order : it leaves its place and waits to be merged again, as if it was inserted
+        entry->object = nullptr;
+        mRemoved++;
+        pushPending(object, key);
     }
     else
     {
-        std::sort(mObjects.begin(),mObjects.end(),[](ObjectBase* a, ObjectBase* b)
-        {
-            if (a == nullptr || b == nullptr)
-            {
-                return false;
-            }
-            return (a->getPosition().y < b->getPosition().y);
-        });
+        entry->key = key;
     }
+    mBatchDirty = true;
 }
 
 std::size_t ObjectGroup::getObjectCount() const
 {
-    return mObjects.size();
+    return mObjects.size() + mPending.size() - mRemoved;
 }
 
 ObjectBase* ObjectGroup::getObject(std::size_t index)
 {
-    return mObjects[index];
+    ensureOrdered();
+    return mObjects[index].object;
 }
 
 ObjectType ObjectGroup::getObjectType(std::size_t index)
 {
-    return mObjects[index]->getObjectType();
+    return getObject(index)->getObjectType();
+}
+
+ObjectBase* ObjectGroup::loadObject(pugi::xml_node const& object)
+{
+    ObjectBase* obj = readObject(object);
+    if (obj != nullptr)
+    {
+        obj->setColor(getColor());
+        obj->update();
+        indexObject(obj, 0);
+        insertObject(obj);
+        if (obj->getId() >= mMap.getNextObjectId())
+        {
+            mMap.setNextObjectId(obj->getId() + 1);
+        }
+        notifyChanged(obj->getId());
+    }
+    return obj;
+}
+
+std::string ObjectGroup::saveObject(ObjectBase& object)
+{
+    pugi::xml_document doc;
+    pugi::xml_node node = doc.append_child("object");
+    object.saveToNode(node);
+    std::ostringstream oss;
+    doc.save(oss, "", pugi::format_raw | pugi::format_no_declaration);
+    return oss.str();
+}
+
+ObjectGroup::Listener::~Listener()
+{
+}
+
+void ObjectGroup::addListener(Listener* listener)
+{
+    if (listener != nullptr && std::find(mListeners.begin(), mListeners.end(), listener) == mListeners.end())
+    {
+        mListeners.push_back(listener);
+    }
+}
+
+void ObjectGroup::removeListener(Listener* listener)
+{
+    mListeners.erase(std::remove(mListeners.begin(), mListeners.end(), listener), mListeners.end());
+}
+
+void ObjectGroup::notifyChanging(ObjectBase& object)
+{
+    for (std::size_t i = 0; i < mListeners.size(); i++)
+    {
+        mListeners[i]->onObjectChanging(*this, object);
+    }
+}
+
+void ObjectGroup::notifyChanged(unsigned int id)
+{
+    for (std::size_t i = 0; i < mListeners.size(); i++)
+    {
+        mListeners[i]->onObjectChanged(*this, id);
+    }
 }
 
 void ObjectGroup::removeObject(unsigned int id)
 {
-    mObjects.erase(std::remove_if(mObjects.begin(),mObjects.end(),[&id](ObjectBase* o)->bool{return o->getId() == id;}), mObjects.end());
+    auto found = mIndex.find(id);
+    if (found == mIndex.end())
+    {
+        return;
+    }
+    ObjectBase* object = found->second;
+    notifyChanging(*object);
+    mIndex.erase(found);
+    mMap.unindexObject(object);
+
+    // The entry is left empty in the draw order, which is merged again once half of it is empty
+    DrawEntry* entry = findEntry(object);
+    if (entry != nullptr)
+    {
+        entry->object = nullptr;
+        mRemoved++;
+    }
+    destroyObject(object);
+    if (mRemoved * 2 > mObjects.size() + mPending.size())
+    {
+        ensureOrdered();
+    }
+    mBatchDirty = true;
+    notifyChanged(id);
+}
+
+ObjectBase* ObjectGroup::getObjectById(unsigned int id)
+{
+    auto found = mIndex.find(id);
+    if (found != mIndex.end())
+    {
+        return found->second;
+    }
+    return nullptr;
+}
+
+void ObjectGroup::indexObject(ObjectBase* object, unsigned int previousId)
+{
+    auto found = mIndex.find(previousId);
+    if (found != mIndex.end() && found->second == object)
+    {
+        mIndex.erase(found);
+    }
+    if (object->getId() != 0)
+    {
+        mIndex[object->getId()] = object;
+    }
+    mMap.indexObject(object, previousId);
+}
+
+void ObjectGroup::invalidate()
+{
+    mBatchDirty = true;
+}
+
+float ObjectGroup::getPixelScale() const
+{
+    return mPixelScale;
+}
+
+detail::ObjectStorage& ObjectGroup::getStorage()
+{
+    return mStorage;
+}
+
+const detail::ObjectStorage& ObjectGroup::getStorage() const
+{
+    return mStorage;
+}
+
+ObjectBase* ObjectGroup::readObject(pugi::xml_node const& object)
+{
+    ObjectBase* obj;
+    if (object.child("ellipse"))
+    {
+        obj = new (allocateObject(sizeof(Ellipse))) Ellipse(*this);
+    }
+    else if (object.child("polygon"))
+    {
+        obj = new (allocateObject(sizeof(Polygon))) Polygon(*this);
+    }
+    else if (object.child("polyline"))
+    {
+        obj = new (allocateObject(sizeof(Polyline))) Polyline(*this);
+    }
+    else
+    {
+        obj = new (allocateObject(sizeof(Object))) Object(*this);
+    }
+    mStorage.objectTypes[obj->getSlot()] = obj->getObjectType();
+    obj->loadFromNode(object);
+    if (obj->getId() != 0 && mMap.getObjectById(obj->getId()) != nullptr)
+    {
+        detail::log("Duplicated object id : " + detail::toString(obj->getId()));
+        destroyObject(obj);
+        return nullptr;
+    }
+    return obj;
+}
+
+void* ObjectGroup::allocateObject(std::size_t size)
+{
+    if (size > mPool.getSlotSize())
+    {
+        detail::log("Object type too large for the object pool");
+        return nullptr;
+    }
+    return mPool.allocate();
+}
+
+void ObjectGroup::destroyObject(ObjectBase* object)
+{
+    if (object != nullptr)
+    {
+        void* memory = dynamic_cast<void*>(object);
+        mStorage.remove(object->getSlot());
+        object->~ObjectBase();
+        mPool.deallocate(memory);
+    }
 }
 
 Map& ObjectGroup::getMap()
@@ -193,4 +491,206 @@ Map& ObjectGroup::getMap()
     return mMap;
 }
 
+void ObjectGroup::ensureBatchUpdated(sf::FloatRect const& area, float pixelScale) const
+{
+    // Ellipses adapt their point count to the zoom, they are rebuilt when it changes by a factor of 2
+    if (pixelScale > 0.f && (pixelScale > mPixelScale * 2.f || pixelScale < mPixelScale * 0.5f))
+    {
+        mPixelScale = pixelScale;
+        for (std::size_t slot = 0; slot < mStorage.size(); slot++)
+        {
+            if (mStorage.objectTypes[slot] == EEllipse)
+            {
+                mStorage.handles[slot]->invalidateVertices();
+            }
+        }
+        mBatchDirty = true;
+    }
+
+    if (!mBatchDirty && contains(mBatchArea, area))
+    {
+        return;
+    }
+
+    // Keep a margin around the view so small moves don't rebuild the batches
+    mBatchArea = sf::FloatRect(area.left - area.width * 0.5f, area.top - area.height * 0.5f, area.width * 2.f, area.height * 2.f);
+    mBatchDirty = false;
+    ensureOrdered();
+
+    for (std::size_t i = 0; i < mBatches.size(); i++)
+    {
+        mBatches[i].vertices.clear();
+    }
+
+    // Culling runs over the contiguous storage, the draw order pass then only reads the result
+    const std::size_t count = mStorage.size();
+    mCulling.resize(count);
+    for (std::size_t slot = 0; slot < count; slot++)
+    {
+        const sf::FloatRect& bounds = mStorage.bounds[slot];
+        mCulling[slot] = (mStorage.flags[slot] & EVisible)
+                      && bounds.left <= mBatchArea.left + mBatchArea.width && mBatchArea.left <= bounds.left + bounds.width
+                      && bounds.top <= mBatchArea.top + mBatchArea.height && mBatchArea.top <= bounds.top + bounds.height;
+    }
+
+    std::size_t used = 0;
+    for (std::size_t i = 0; i < mObjects.size(); i++)
+    {
+        const ObjectBase* object = mObjects[i].object;
+        if (!mCulling[object->getSlot()])
+        {
+            continue;
+        }
+        // Consecutive objects with the same texture share a batch, so the draw order is kept
+        const sf::Texture* texture = object->getTexture();
+        if (used == 0 || mBatches[used - 1].texture != texture)
+        {
+            if (used == mBatches.size())
+            {
+                mBatches.push_back(Batch());
+            }
+            mBatches[used].texture = texture;
+            used++;
+        }
+        std::size_t batch = used - 1;
+        const std::vector<sf::Vertex>& vertices = object->getVertices();
+        mBatches[batch].vertices.insert(mBatches[batch].vertices.end(), vertices.begin(), vertices.end());
+    }
+}
+
+void ObjectGroup::ensureOrdered() const
+{
+    if (mPending.empty() && mRemoved == 0)
+    {
+        return;
+    }
+    auto empty = [](DrawEntry const& e)
+    {
+        return e.object == nullptr;
+    };
+    auto less = [](DrawEntry const& a, DrawEntry const& b)
+    {
+        return a.key < b.key;
+    };
+    mObjects.erase(std::remove_if(mObjects.begin(), mObjects.end(), empty), mObjects.end());
+    mPending.erase(std::remove_if(mPending.begin(), mPending.end(), empty), mPending.end());
+
+    // Equal keys keep the sorted objects first, then the others in the order they came, as inserting each after them would
+    std::stable_sort(mPending.begin(), mPending.end(), less);
+    std::vector<DrawEntry> objects(mObjects.size() + mPending.size());
+    std::merge(mObjects.begin(), mObjects.end(), mPending.begin(), mPending.end(), objects.begin(), less);
+    mObjects.swap(objects);
+    mPending.clear();
+    mRemoved = 0;
+    setOrders();
+}
+
+void ObjectGroup::setOrders() const
+{
+    for (std::size_t i = 0; i < mObjects.size(); i++)
+    {
+        mStorage.orders[mObjects[i].object->getSlot()] = i;
+    }
+}
+
+ObjectGroup::DrawEntry* ObjectGroup::findEntry(ObjectBase const* object)
+{
+    // Orders past the sorted objects are in the pending ones
+    std::size_t index = mStorage.orders[object->getSlot()];
+    DrawEntry* entry = nullptr;
+    if (index < mObjects.size())
+    {
+        entry = &mObjects[index];
+    }
+    else if (index != detail::ObjectStorage::NoOrder && index - mObjects.size() < mPending.size())
+    {
+        entry = &mPending[index - mObjects.size()];
+    }
+    return (entry != nullptr && entry->object == object) ? entry : nullptr;
+}
+
+void ObjectGroup::pushPending(ObjectBase* object, double key)
+{
+    DrawEntry entry = {key, object};
+    mPending.push_back(entry);
+    mStorage.orders[object->getSlot()] = mObjects.size() + mPending.size() - 1;
+}
+
+namespace detail
+{
+
+const std::size_t ObjectStorage::NoOrder;
+
+std::size_t ObjectStorage::add(ObjectBase* object)
+{
+    ids.push_back(0);
+    gids.push_back(0);
+    positions.push_back(sf::Vector2f());
+    sizes.push_back(sf::Vector2f());
+    rotations.push_back(0.f);
+    flags.push_back(EVisible);
+    objectTypes.push_back(ESimple);
+    types.push_back(0);
+    bounds.push_back(sf::FloatRect());
+    handles.push_back(object);
+    orders.push_back(NoOrder);
+    return handles.size() - 1;
+}
+
+void ObjectStorage::remove(std::size_t slot)
+{
+    // Swap with the last slot and pop, the moved object is told its new slot
+    std::size_t last = handles.size() - 1;
+    if (slot != last)
+    {
+        ids[slot] = ids[last];
+        gids[slot] = gids[last];
+        positions[slot] = positions[last];
+        sizes[slot] = sizes[last];
+        rotations[slot] = rotations[last];
+        flags[slot] = flags[last];
+        objectTypes[slot] = objectTypes[last];
+        types[slot] = types[last];
+        bounds[slot] = bounds[last];
+        handles[slot] = handles[last];
+        orders[slot] = orders[last];
+        handles[slot]->mSlot = slot;
+    }
+    ids.pop_back();
+    gids.pop_back();
+    positions.pop_back();
+    sizes.pop_back();
+    rotations.pop_back();
+    flags.pop_back();
+    objectTypes.pop_back();
+    types.pop_back();
+    bounds.pop_back();
+    handles.pop_back();
+    orders.pop_back();
+}
+
+std::size_t ObjectStorage::size() const
+{
+    return handles.size();
+}
+
+bool ObjectStorage::hasFlag(std::size_t slot, ObjectFlag flag) const
+{
+    return (flags[slot] & flag) != 0;
+}
+
+void ObjectStorage::setFlag(std::size_t slot, ObjectFlag flag, bool value)
+{
+    if (value)
+    {
+        flags[slot] |= flag;
+    }
+    else
+    {
+        flags[slot] &= ~flag;
+    }
+}
+
+} // namespace detail
+
 } // namespace tmx
@@ -9,10 +9,42 @@ namespace tmx
 {
 
 class Map;
+
+namespace detail
+{
+
+// Object data stored as contiguous arrays, indexed by ObjectBase::getSlot()
+struct ObjectStorage
+{
+    std::size_t add(ObjectBase* object);
+    void remove(std::size_t slot);
+    std::size_t size() const;
+
+    bool hasFlag(std::size_t slot, ObjectFlag flag) const;
+    void setFlag(std::size_t slot, ObjectFlag flag, bool value);
+
+    std::vector<unsigned int> ids;
+    std::vector<unsigned int> gids;
+    std::vector<sf::Vector2f> positions;
+    std::vector<sf::Vector2f> sizes;
+    std::vector<float> rotations;
+    std::vector<unsigned char> flags;
+    std::vector<ObjectType> objectTypes;
+    std::vector<unsigned int> types; // Handles from Map::getTypeHandle
+    std::vector<sf::FloatRect> bounds;
+    std::vector<ObjectBase*> handles;
+    mutable std::vector<std::size_t> orders; // Place in the draw order of the group, NoOrder before the object is inserted
+
+    static const std::size_t NoOrder = static_cast<std::size_t>(-1);
+};
+
+} // namespace detail
+
 class ObjectGroup : public LayerBase
 {
     public:
         ObjectGroup(Map& map);
+        ~ObjectGroup();
 
         LayerType getLayerType() const;
 
@@ -30,6 +62,8 @@ class ObjectGroup : public LayerBase
         void setDrawOrder(std::string const& order);
 
         void sort(std::string const& order = "topdown");
+        void insertObject(ObjectBase* object);
+        void updateObjectOrder(ObjectBase* object);
 
         std::size_t getObjectCount() const;
         ObjectBase* getObject(std::size_t index);
@@ -40,39 +74,126 @@ class ObjectGroup : public LayerBase
         T* createObject(unsigned int id);
         void removeObject(unsigned int id);
 
+        // Creates an object from a node written by ObjectBase::saveToNode, nullptr if its id is already used
+        ObjectBase* loadObject(pugi::xml_node const& object);
+        // The node of an object as a raw xml string, which loadObject can read back
+        static std::string saveObject(ObjectBase& object);
+
+        class Listener
+        {
+            public:
+                virtual ~Listener();
+
+                // Before any change of an object, removal included, while it still has its previous state
+                virtual void onObjectChanging(ObjectGroup& group, ObjectBase& object) = 0;
+
+                // After the change, or the creation of the object, which is gone when it was removed
+                virtual void onObjectChanged(ObjectGroup& group, unsigned int id) = 0;
+        };
+
+        void addListener(Listener* listener);
+        void removeListener(Listener* listener);
+
+        // Called by the mutators of the objects, a new id is notified as a creation under it and a removal of the previous one
+        void notifyChanging(ObjectBase& object);
+        void notifyChanged(unsigned int id);
+
+        ObjectBase* getObjectById(unsigned int id);
+        template <typename T>
+        T* getObjectById(unsigned int id);
+        void indexObject(ObjectBase* object, unsigned int previousId);
+
+        void invalidate();
+
+        float getPixelScale() const;
+
+        detail::ObjectStorage& getStorage();
+        const detail::ObjectStorage& getStorage() const;
+
         Map& getMap();
 
+    protected:
+        ObjectBase* readObject(pugi::xml_node const& object);
+        void* allocateObject(std::size_t size);
+        void destroyObject(ObjectBase* object);
+
+        void ensureBatchUpdated(sf::FloatRect const& area, float pixelScale) const;
+
+        // Merges the inserted and moved objects into the draw order, and drops the removed ones
+        void ensureOrdered() const;
+        void setOrders() const;
+
+        // An object in the draw order with the key it is sorted by, a removed or moved object leaves a null entry
+        // until the order is merged again
+        struct DrawEntry
+        {
+            double key;
+            ObjectBase* object;
+        };
+        DrawEntry* findEntry(ObjectBase const* object);
+        void pushPending(ObjectBase* object, double key);
+
     protected:
         Map& mMap;
         std::string mColor;
         std::string mDrawOrder;
-        std::vector<ObjectBase*> mObjects;
+        // Sorted objects then the ones inserted or moved since the last merge, in the order they came
+        mutable std::vector<DrawEntry> mObjects;
+        mutable std::vector<DrawEntry> mPending;
+        mutable std::size_t mRemoved;
+        std::unordered_map<unsigned int, ObjectBase*> mIndex;
+        detail::ObjectStorage mStorage;
+        detail::Pool mPool;
+        std::vector<Listener*> mListeners;
+
+        struct Batch
+        {
+            const sf::Texture* texture;
+            std::vector<sf::Vertex> vertices;
+        };
+        mutable std::vector<Batch> mBatches;
+        mutable std::vector<unsigned char> mCulling;
+        mutable sf::FloatRect mBatchArea;
+        mutable bool mBatchDirty;
+        mutable float mPixelScale;
 };
 
 template <typename T>
 T* ObjectGroup::getObject(std::size_t index)
 {
-    return static_cast<T*>(mObjects[index]);
+    return static_cast<T*>(getObject(index));
 }
 
 template <typename T>
 T* ObjectGroup::createObject(unsigned int id)
 {
-    if (id != 0)
+    if (id != 0 && mMap.getObjectById(id) == nullptr)
     {
-        if (std::find_if(mObjects.begin(),mObjects.end(),[&id](ObjectBase* obj) -> bool { return (obj->getId() >= id);}) == mObjects.end())
+        void* memory = allocateObject(sizeof(T));
+        if (memory != nullptr)
         {
-            T* p = new T(*this);
+            T* p = new (memory) T(*this);
+            mStorage.objectTypes[p->getSlot()] = p->getObjectType();
             p->setId(id);
             p->setColor(getColor());
-            mObjects.push_back(p);
-            sort(mDrawOrder);
+            insertObject(p);
+            if (id >= mMap.getNextObjectId())
+            {
+                mMap.setNextObjectId(id + 1);
+            }
+            notifyChanged(id);
             return p;
         }
     }
     return nullptr;
 }
 
+template <typename T>
+T* ObjectGroup::getObjectById(unsigned int id)
+{
+    return static_cast<T*>(getObjectById(id));
+}
+
 } // namespace tmx
 
 #endif // TMX_OBJECTGROUP_HPP
@@ -0,0 +1,465 @@
+#include "Pathfinder.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace tmx
+{
+
+namespace
+{
+
+const float Diagonal = 1.41421356f;
+
+detail::SearchState& getSearch()
+{
+    static thread_local detail::SearchState search;
+    return search;
+}
+
+int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+} // namespace
+
+Pathfinder::Pathfinder(CostGrid const& grid, bool diagonal)
+: mGrid(grid)
+, mDiagonal(diagonal)
+, mGeometry(grid.getMap().getGeometry())
+, mSquare(mGeometry.getOrientation() == MapGeometry::EOrthogonal || mGeometry.getOrientation() == MapGeometry::EIsometric)
+{
+}
+
+bool Pathfinder::findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path) const
+{
+    path.clear();
+    if (!mGrid.isWalkable(start) || !mGrid.isWalkable(goal))
+    {
+        return false;
+    }
+    if (start == goal)
+    {
+        path.push_back(start);
+        return true;
+    }
+    const int width = mGrid.getSize().x;
+    int from = start.x + start.y * width;
+    int to = goal.x + goal.y * width;
+    if (mSquare && mDiagonal && mGrid.isUniform())
+    {
+        return findJumpPoints(from, to, path);
+    }
+    return findAStar(from, to, path, sf::IntRect(0, 0, mGrid.getSize().x, mGrid.getSize().y));
+}
+
+bool Pathfinder::findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path, sf::IntRect const& bounds) const
+{
+    path.clear();
+    if (!mGrid.isWalkable(start) || !mGrid.isWalkable(goal) || !bounds.contains(start) || !bounds.contains(goal))
+    {
+        return false;
+    }
+    if (start == goal)
+    {
+        path.push_back(start);
+        return true;
+    }
+    const int width = mGrid.getSize().x;
+    return findAStar(start.x + start.y * width, goal.x + goal.y * width, path, bounds);
+}
+
+void Pathfinder::findCosts(sf::Vector2i const& origin, std::vector<sf::Vector2i> const& targets, std::vector<float>& costs, sf::IntRect const& bounds, bool reversed) const
+{
+    costs.assign(targets.size(), std::numeric_limits<float>::infinity());
+    if (!mGrid.isWalkable(origin) || !bounds.contains(origin))
+    {
+        return;
+    }
+    const int width = mGrid.getSize().x;
+    const std::vector<unsigned char>& cells = mGrid.getCosts();
+    detail::SearchState& search = getSearch();
+    search.reset(cells.size());
+
+    // The search stops once every target is closed, targets are found in the sorted list
+    std::vector<int> wanted(targets.size());
+    for (std::size_t i = 0; i < targets.size(); i++)
+    {
+        wanted[i] = targets[i].x + targets[i].y * width;
+    }
+    std::vector<int> sorted(wanted);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::size_t remaining = sorted.size();
+    search.push(origin.x + origin.y * width, -1, 0.f, 0.f);
+    int neighbours[8];
+    float steps[8];
+    int cell;
+    while (remaining > 0 && (cell = search.pop()) >= 0)
+    {
+        if (std::binary_search(sorted.begin(), sorted.end(), cell))
+        {
+            remaining--;
+        }
+        std::size_t count = getNeighbours(cell, neighbours, steps);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int next = neighbours[i];
+            if (bounds.contains(next % width, next / width))
+            {
+                // Going backward, the step enters the cell being expanded
+                float step = steps[i] * ((reversed) ? cells[cell] : cells[next]);
+                search.relax(next, cell, search.costs[cell] + step, 0.f);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < wanted.size(); i++)
+    {
+        if (search.isClosed(wanted[i]))
+        {
+            costs[i] = search.costs[wanted[i]];
+        }
+    }
+}
+
+void Pathfinder::findPaths(std::vector<Query>& queries) const
+{
+    detail::ThreadPool::getDefault().parallelFor(queries.size(), [this, &queries](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            queries[i].found = findPath(queries[i].start, queries[i].goal, queries[i].path);
+        }
+    });
+}
+
+float Pathfinder::getPathCost(std::vector<sf::Vector2i> const& path) const
+{
+    const int width = mGrid.getSize().x;
+    float cost = 0.f;
+    int neighbours[8];
+    float steps[8];
+    for (std::size_t i = 1; i < path.size(); i++)
+    {
+        int from = path[i - 1].x + path[i - 1].y * width;
+        int to = path[i].x + path[i].y * width;
+        std::size_t count = getNeighbours(from, neighbours, steps);
+        std::size_t j = 0;
+        while (j < count && neighbours[j] != to)
+        {
+            j++;
+        }
+        if (j == count)
+        {
+            return -1.f;
+        }
+        cost += steps[j] * mGrid.getCosts()[to];
+    }
+    return cost;
+}
+
+float Pathfinder::getEstimate(sf::Vector2i const& from, sf::Vector2i const& to) const
+{
+    const int width = mGrid.getSize().x;
+    return heuristic(from.x + from.y * width, to.x + to.y * width);
+}
+
+bool Pathfinder::allowsDiagonal() const
+{
+    return mDiagonal;
+}
+
+void Pathfinder::setDiagonal(bool diagonal)
+{
+    mDiagonal = diagonal;
+}
+
+const CostGrid& Pathfinder::getGrid() const
+{
+    return mGrid;
+}
+
+std::size_t Pathfinder::getNeighbours(int cell, int* neighbours, float* steps) const
+{
+    // Sides, then the corners lying between two walkable sides
+    const int width = mGrid.getSize().x;
+    const sf::Vector2i coords(cell % width, cell / width);
+    Span<sf::Vector2i> offsets = mGeometry.getNeighbourOffsets(coords, mDiagonal);
+    const std::size_t sides = mGeometry.getSideCount();
+    bool walkable[8];
+    for (std::size_t k = 0; k < offsets.size(); k++)
+    {
+        walkable[k] = mGrid.isWalkable(coords + offsets[k]);
+    }
+    std::size_t count = 0;
+    for (std::size_t k = 0; k < offsets.size(); k++)
+    {
+        std::size_t corner = k - sides;
+        if (walkable[k] && (k < sides || (walkable[corner] && walkable[(corner + 1) % sides])))
+        {
+            neighbours[count] = cell + offsets[k].x + offsets[k].y * width;
+            steps[count] = (k < sides) ? 1.f : Diagonal;
+            count++;
+        }
+    }
+    return count;
+}
+
+float Pathfinder::heuristic(int from, int to) const
+{
+    const int width = mGrid.getSize().x;
+    sf::Vector2i a(from % width, from / width);
+    sf::Vector2i b(to % width, to / width);
+    if (mGeometry.getOrientation() == MapGeometry::EHexagonal)
+    {
+        return static_cast<float>(mGeometry.getDistance(a, b));
+    }
+    sf::Vector2i delta = mGeometry.toLattice(b) - mGeometry.toLattice(a);
+    float du = static_cast<float>(std::abs(delta.x));
+    float dv = static_cast<float>(std::abs(delta.y));
+    if (mDiagonal)
+    {
+        return du + dv + (Diagonal - 2.f) * std::min(du, dv);
+    }
+    return du + dv;
+}
+
+bool Pathfinder::isWalkable(int x, int y) const
+{
+    return mGrid.isWalkable(sf::Vector2i(x, y));
+}
+
+bool Pathfinder::findAStar(int start, int goal, std::vector<sf::Vector2i>& path, sf::IntRect const& bounds) const
+{
+    const int width = mGrid.getSize().x;
+    const std::vector<unsigned char>& costs = mGrid.getCosts();
+    detail::SearchState& search = getSearch();
+    search.reset(costs.size());
+    search.push(start, -1, 0.f, heuristic(start, goal));
+    int neighbours[8];
+    float steps[8];
+    int cell;
+    while ((cell = search.pop()) >= 0)
+    {
+        if (cell == goal)
+        {
+            for (int c = goal; c >= 0; c = search.parents[c])
+            {
+                path.push_back(sf::Vector2i(c % width, c / width));
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+        std::size_t count = getNeighbours(cell, neighbours, steps);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int next = neighbours[i];
+            float cost = search.costs[cell] + steps[i] * costs[next];
+            if (!search.isClosed(next) && bounds.contains(next % width, next / width))
+            {
+                search.relax(next, cell, cost, heuristic(next, goal));
+            }
+        }
+    }
+    return false;
+}
+
+bool Pathfinder::findJumpPoints(int start, int goal, std::vector<sf::Vector2i>& path) const
+{
+    const int width = mGrid.getSize().x;
+    detail::SearchState& search = getSearch();
+    search.reset(mGrid.getCosts().size());
+    search.push(start, -1, 0.f, heuristic(start, goal));
+    int directions[8];
+    int cell;
+    while ((cell = search.pop()) >= 0)
+    {
+        if (cell == goal)
+        {
+            // Jump points are joined by straight or diagonal lines
+            std::vector<int> points;
+            for (int c = goal; c >= 0; c = search.parents[c])
+            {
+                points.push_back(c);
+            }
+            sf::Vector2i current(start % width, start / width);
+            path.push_back(current);
+            for (std::size_t i = points.size() - 1; i-- > 0;)
+            {
+                sf::Vector2i target(points[i] % width, points[i] / width);
+                sf::Vector2i step(sign(target.x - current.x), sign(target.y - current.y));
+                while (current != target)
+                {
+                    current += step;
+                    path.push_back(current);
+                }
+            }
+            return true;
+        }
+        const int x = cell % width;
+        const int y = cell / width;
+        std::size_t count = getJumpDirections(cell, search.parents[cell], directions);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int dx = directions[i] % 3 - 1;
+            int dy = directions[i] / 3 - 1;
+            int point = jump(x + dx, y + dy, dx, dy, goal);
+            if (point >= 0 && !search.isClosed(point))
+            {
+                search.relax(point, cell, search.costs[cell] + heuristic(cell, point), heuristic(point, goal));
+            }
+        }
+    }
+    return false;
+}
+
+std::size_t Pathfinder::getJumpDirections(int cell, int parent, int* directions) const
+{
+    // Directions are encoded as (dx + 1) + (dy + 1) * 3
+    const int width = mGrid.getSize().x;
+    const int x = cell % width;
+    const int y = cell / width;
+    std::size_t count = 0;
+    auto add = [&](int dx, int dy)
+    {
+        directions[count++] = (dx + 1) + (dy + 1) * 3;
+    };
+
+    if (parent < 0)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx != 0 || dy != 0) && (dx == 0 || isWalkable(x + dx, y)) && (dy == 0 || isWalkable(x, y + dy)))
+                {
+                    add(dx, dy);
+                }
+            }
+        }
+        return count;
+    }
+
+    // Pruned neighbours, diagonal moves never cut corners
+    const int dx = sign(x - parent % width);
+    const int dy = sign(y - parent / width);
+    if (dx != 0 && dy != 0)
+    {
+        bool vertical = isWalkable(x, y + dy);
+        bool horizontal = isWalkable(x + dx, y);
+        if (vertical)
+        {
+            add(0, dy);
+        }
+        if (horizontal)
+        {
+            add(dx, 0);
+        }
+        if (vertical && horizontal)
+        {
+            add(dx, dy);
+        }
+    }
+    else if (dx != 0)
+    {
+        bool next = isWalkable(x + dx, y);
+        bool down = isWalkable(x, y + 1);
+        bool up = isWalkable(x, y - 1);
+        if (next)
+        {
+            add(dx, 0);
+            if (down)
+            {
+                add(dx, 1);
+            }
+            if (up)
+            {
+                add(dx, -1);
+            }
+        }
+        if (down)
+        {
+            add(0, 1);
+        }
+        if (up)
+        {
+            add(0, -1);
+        }
+    }
+    else
+    {
+        bool next = isWalkable(x, y + dy);
+        bool right = isWalkable(x + 1, y);
+        bool left = isWalkable(x - 1, y);
+        if (next)
+        {
+            add(0, dy);
+            if (right)
+            {
+                add(1, dy);
+            }
+            if (left)
+            {
+                add(-1, dy);
+            }
+        }
+        if (right)
+        {
+            add(1, 0);
+        }
+        if (left)
+        {
+            add(-1, 0);
+        }
+    }
+    return count;
+}
+
+int Pathfinder::jump(int x, int y, int dx, int dy, int goal) const
+{
+    const int width = mGrid.getSize().x;
+    while (true)
+    {
+        if (!isWalkable(x, y))
+        {
+            return -1;
+        }
+        const int cell = x + y * width;
+        if (cell == goal)
+        {
+            return cell;
+        }
+        if (dx != 0 && dy != 0)
+        {
+            if (jump(x + dx, y, dx, 0, goal) >= 0 || jump(x, y + dy, 0, dy, goal) >= 0)
+            {
+                return cell;
+            }
+            if (!isWalkable(x + dx, y) || !isWalkable(x, y + dy))
+            {
+                return -1;
+            }
+        }
+        else if (dx != 0)
+        {
+            if ((isWalkable(x, y - 1) && !isWalkable(x - dx, y - 1)) || (isWalkable(x, y + 1) && !isWalkable(x - dx, y + 1)))
+            {
+                return cell;
+            }
+        }
+        else
+        {
+            if ((isWalkable(x - 1, y) && !isWalkable(x - 1, y - dy)) || (isWalkable(x + 1, y) && !isWalkable(x + 1, y - dy)))
+            {
+                return cell;
+            }
+        }
+        x += dx;
+        y += dy;
+    }
+}
+
+} // namespace tmx
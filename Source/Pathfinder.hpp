@@ -0,0 +1,151 @@
+#ifndef TMX_PATHFINDER_HPP
+#define TMX_PATHFINDER_HPP
+
+#include <algorithm>
+#include <functional>
+
+#include "CostGrid.hpp"
+#include "MapGeometry.hpp"
+
+namespace tmx
+{
+
+namespace detail
+{
+
+// Search state reused by every search of a thread, stamps avoid clearing it between searches
+struct SearchState
+{
+    std::vector<float> costs;
+    std::vector<int> parents;
+    std::vector<unsigned int> stamps;
+    std::vector<std::pair<float, int>> open;
+    unsigned int stamp;
+
+    void reset(std::size_t cells);
+    bool isClosed(int cell) const;
+    void push(int cell, int parent, float cost, float estimate);
+    bool relax(int cell, int parent, float cost, float estimate);
+    int pop();
+};
+
+} // namespace detail
+
+// Shortest paths on a cost grid, entering a cell costs its cost times the step length
+// Orthogonal and isometric maps with uniform costs use Jump Point Search, the other cases A*
+// Staggered and hexagonal maps step to the neighbours given by their stagger axis and index
+// Diagonal steps never cut a blocked corner, searches only read the grid and can run in parallel
+class Pathfinder
+{
+    public:
+        Pathfinder(CostGrid const& grid, bool diagonal = true);
+
+        // The path goes from start to goal, both included
+        bool findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path) const;
+
+        // A* restricted to the cells of bounds
+        bool findPath(sf::Vector2i const& start, sf::Vector2i const& goal, std::vector<sf::Vector2i>& path, sf::IntRect const& bounds) const;
+
+        // Path costs from origin to each target (to origin from each target when reversed) inside bounds, infinity when unreachable
+        void findCosts(sf::Vector2i const& origin, std::vector<sf::Vector2i> const& targets, std::vector<float>& costs, sf::IntRect const& bounds, bool reversed = false) const;
+
+        struct Query
+        {
+            sf::Vector2i start;
+            sf::Vector2i goal;
+            std::vector<sf::Vector2i> path;
+            bool found;
+        };
+
+        // Solves every query on the default thread pool
+        void findPaths(std::vector<Query>& queries) const;
+
+        float getPathCost(std::vector<sf::Vector2i> const& path) const;
+
+        // Lower bound of the cost between two cells
+        float getEstimate(sf::Vector2i const& from, sf::Vector2i const& to) const;
+
+        bool allowsDiagonal() const;
+        void setDiagonal(bool diagonal);
+
+        const CostGrid& getGrid() const;
+
+        // Walkable neighbours of a cell index with their step lengths, at most 8
+        std::size_t getNeighbours(int cell, int* neighbours, float* steps) const;
+
+    private:
+        float heuristic(int from, int to) const;
+        bool isWalkable(int x, int y) const;
+        bool findAStar(int start, int goal, std::vector<sf::Vector2i>& path, sf::IntRect const& bounds) const;
+        bool findJumpPoints(int start, int goal, std::vector<sf::Vector2i>& path) const;
+        std::size_t getJumpDirections(int cell, int parent, int* directions) const;
+        int jump(int x, int y, int dx, int dy, int goal) const;
+
+    private:
+        const CostGrid& mGrid;
+        bool mDiagonal;
+        MapGeometry mGeometry;
+        bool mSquare;
+};
+
+namespace detail
+{
+
+inline void SearchState::reset(std::size_t cells)
+{
+    if (stamps.size() != cells || stamp >= 0xfffffffdu)
+    {
+        costs.assign(cells, 0.f);
+        parents.assign(cells, -1);
+        stamps.assign(cells, 0);
+        stamp = 0;
+    }
+    stamp += 2; // stamp : open, stamp + 1 : closed
+    open.clear();
+}
+
+inline bool SearchState::isClosed(int cell) const
+{
+    return stamps[cell] == stamp + 1;
+}
+
+inline void SearchState::push(int cell, int parent, float cost, float estimate)
+{
+    costs[cell] = cost;
+    parents[cell] = parent;
+    stamps[cell] = stamp;
+    open.push_back(std::make_pair(cost + estimate, cell));
+    std::push_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+}
+
+inline bool SearchState::relax(int cell, int parent, float cost, float estimate)
+{
+    if (isClosed(cell) || (stamps[cell] == stamp && costs[cell] <= cost))
+    {
+        return false;
+    }
+    push(cell, parent, cost, estimate);
+    return true;
+}
+
+inline int SearchState::pop()
+{
+    while (!open.empty())
+    {
+        std::pop_heap(open.begin(), open.end(), std::greater<std::pair<float, int>>());
+        int cell = open.back().second;
+        open.pop_back();
+        if (!isClosed(cell))
+        {
+            stamps[cell] = stamp + 1;
+            return cell;
+        }
+    }
+    return -1;
+}
+
+} // namespace detail
+
+} // namespace tmx
+
+#endif // TMX_PATHFINDER_HPP
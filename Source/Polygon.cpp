@@ -1,11 +1,15 @@
 #include "Polygon.h"
+#include "ObjectGroup.hpp"
+#include "Triangulator.hpp"
 
 namespace tmx
 {
 
 Polygon::Polygon(ObjectGroup& group)
 : ObjectBase(group)
-, mShape()
+, mPoints()
+, mTriangles()
+, mNeedsTriangulation(true)
 {
 }
 
@@ -32,18 +36,12 @@ void Polygon::loadFromNode(pugi::xml_node const& object)
         return;
     }
     std::string point;
-    std::vector<sf::Vector2f> points;
     std::stringstream ss(attr.value());
     while (std::getline(ss, point, ' '))
     {
-        points.push_back(detail::fromString<sf::Vector2f>(point));
+        mPoints.push_back(detail::fromString<sf::Vector2f>(point));
     }
-    mShape.setPointCount(points.size());
-    for (std::size_t i = 0; i < points.size(); i++)
-    {
-        mShape.setPoint(i, points[i]);
-    }
-    update();
+    mNeedsTriangulation = true;
 }
 
 void Polygon::saveToNode(pugi::xml_node& object)
@@ -54,9 +52,9 @@ void Polygon::saveToNode(pugi::xml_node& object)
     }
     ObjectBase::saveToNode(object);
     std::string points;
-    for (std::size_t i = 0; i < mShape.getPointCount(); i++)
+    for (std::size_t i = 0; i < mPoints.size(); i++)
     {
-        points += detail::toString(mShape.getPoint(i)) + " ";
+        points += detail::toString(mPoints[i]) + " ";
     }
     if (points.size() > 0)
     {
@@ -65,65 +63,103 @@ void Polygon::saveToNode(pugi::xml_node& object)
     object.append_child("polygon").append_attribute("points") = points.c_str();
 }
 
-void Polygon::update()
-{
-    mShape.setOutlineThickness(2.f);
-    mShape.setPosition(mPosition + getLayerOffset() + getMapOffset());
-    mShape.setRotation(mRotation);
-}
-
 void Polygon::addPoint(sf::Vector2f const& point)
 {
-    mShape.setPointCount(mShape.getPointCount() + 1);
-    mShape.setPoint(mShape.getPointCount() - 1, point);
+    mGroup.notifyChanging(*this);
+    mPoints.push_back(point);
+    mNeedsTriangulation = true;
+    update();
+    mGroup.notifyChanged(getId());
 }
 
 void Polygon::addPoint(sf::Vector2f const& point, std::size_t index)
 {
-    mShape.setPointCount(mShape.getPointCount() + 1);
-    for (std::size_t i = mShape.getPointCount() - 1; i >= index; i--)
-    {
-        mShape.setPoint(i, mShape.getPoint(i-1));
-    }
-    mShape.setPoint(index, point);
+    mGroup.notifyChanging(*this);
+    mPoints.insert(mPoints.begin() + index, point);
+    mNeedsTriangulation = true;
+    update();
+    mGroup.notifyChanged(getId());
 }
 
 sf::Vector2f Polygon::getPoint(std::size_t index) const
 {
-    return mShape.getPoint(index);
+    return mPoints[index];
 }
 
 void Polygon::setPoint(std::size_t index, sf::Vector2f const& point)
 {
-    mShape.setPoint(index, point);
+    mGroup.notifyChanging(*this);
+    mPoints[index] = point;
+    mNeedsTriangulation = true;
+    update();
+    mGroup.notifyChanged(getId());
 }
 
 void Polygon::removePoint(std::size_t index)
 {
-    for (std::size_t i = index; i < mShape.getPointCount()-1; i++)
+    if (index < mPoints.size())
     {
-        mShape.setPoint(i, mShape.getPoint(i+1));
+        mGroup.notifyChanging(*this);
+        mPoints.erase(mPoints.begin() + index);
+        mNeedsTriangulation = true;
+        update();
+        mGroup.notifyChanged(getId());
     }
-    if (index < mShape.getPointCount())
+}
+
+std::size_t Polygon::getPointCount() const
+{
+    return mPoints.size();
+}
+
+const std::vector<sf::Vector2f>& Polygon::getTriangles() const
+{
+    ensureTriangulated();
+    return mTriangles;
+}
+
+sf::FloatRect Polygon::getLocalBounds() const
+{
+    if (mPoints.empty())
+    {
+        return sf::FloatRect();
+    }
+    sf::Vector2f min = mPoints[0];
+    sf::Vector2f max = mPoints[0];
+    for (std::size_t i = 1; i < mPoints.size(); i++)
     {
-        mShape.setPointCount(mShape.getPointCount()-1);
+        min.x = std::min(min.x, mPoints[i].x);
+        min.y = std::min(min.y, mPoints[i].y);
+        max.x = std::max(max.x, mPoints[i].x);
+        max.y = std::max(max.y, mPoints[i].y);
     }
+    return sf::FloatRect(min, max - min);
 }
 
-void Polygon::setColor(sf::Color const& color)
+void Polygon::buildVertices(std::vector<sf::Vertex>& vertices) const
 {
-    sf::Color c = color;
-    c.a = 32;
-    mShape.setOutlineColor(color);
-    mShape.setFillColor(c);
+    ensureTriangulated();
+    sf::Color fill = mColor;
+    fill.a = 32;
+    vertices.reserve(mTriangles.size() + mPoints.size() * 6);
+    for (std::size_t i = 0; i < mTriangles.size(); i++)
+    {
+        vertices.push_back(sf::Vertex(mTriangles[i], fill));
+    }
+    appendOutline(vertices, mPoints, true, mColor);
 }
 
-void Polygon::draw(sf::RenderTarget& target, sf::RenderStates states) const
+void Polygon::ensureTriangulated() const
 {
-    if (mVisible)
+    if (!mNeedsTriangulation)
     {
-        target.draw(mShape, states);
+        return;
     }
+    // One triangulator per thread, its buffers are reused by every polygon
+    static thread_local detail::Triangulator triangulator;
+    mTriangles.clear();
+    triangulator.triangulate(mPoints, mTriangles);
+    mNeedsTriangulation = false;
 }
 
 }
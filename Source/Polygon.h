@@ -17,8 +17,6 @@ class Polygon : public ObjectBase
         void loadFromNode(pugi::xml_node const& object);
         void saveToNode(pugi::xml_node& object);
 
-        void update();
-
         void addPoint(sf::Vector2f const& point);
         void addPoint(sf::Vector2f const& point, std::size_t index);
         sf::Vector2f getPoint(std::size_t index) const;
@@ -26,12 +24,18 @@ class Polygon : public ObjectBase
         void removePoint(std::size_t index);
         std::size_t getPointCount() const;
 
-        void setColor(sf::Color const& color);
+        const std::vector<sf::Vector2f>& getTriangles() const;
+
+    protected:
+        sf::FloatRect getLocalBounds() const;
+        void buildVertices(std::vector<sf::Vertex>& vertices) const;
 
-        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
+        void ensureTriangulated() const;
 
     private:
-        thor::ConcaveShape mShape;
+        std::vector<sf::Vector2f> mPoints;
+        mutable std::vector<sf::Vector2f> mTriangles;
+        mutable bool mNeedsTriangulation;
 };
 
 }
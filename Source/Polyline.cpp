@@ -1,4 +1,5 @@
 #include "Polyline.h"
+#include "ObjectGroup.hpp"
 
 namespace tmx
 {
@@ -33,7 +34,6 @@ void Polyline::loadFromNode(pugi::xml_node const& object)
     {
         mPoints.push_back(detail::fromString<sf::Vector2f>(point));
     }
-    update();
 }
 
 void Polyline::saveToNode(pugi::xml_node& object)
@@ -47,33 +47,20 @@ void Polyline::saveToNode(pugi::xml_node& object)
     object.append_child("polyline").append_attribute("points") = points.c_str();
 }
 
-void Polyline::update()
-{
-    if (mPoints.size() > 1)
-    {
-        mShapes.resize(mPoints.size()-1);
-        for (std::size_t i = 0; i < mShapes.size(); i++)
-        {
-            sf::Vector2f pos = mPoints[i];
-            sf::Vector2f diff = mPoints[i+1] - pos;
-            mShapes[i].setPosition(pos + mPosition + getLayerOffset() + getMapOffset());
-            mShapes[i].setSize(sf::Vector2f(std::sqrt(diff.x * diff.x + diff.y * diff.y), 0.f));
-            mShapes[i].setRotation(std::atan2(diff.y,diff.x) * 180.f / 3.141592654f);
-            mShapes[i].setOutlineThickness(1.f);
-        }
-    }
-}
-
 void Polyline::addPoint(sf::Vector2f const& point)
 {
+    mGroup.notifyChanging(*this);
     mPoints.push_back(point);
     update();
+    mGroup.notifyChanged(getId());
 }
 
 void Polyline::addPoint(sf::Vector2f const& point, std::size_t index)
 {
+    mGroup.notifyChanging(*this);
     mPoints.insert(mPoints.begin() + index, point);
     update();
+    mGroup.notifyChanged(getId());
 }
 
 sf::Vector2f Polyline::getPoint(std::size_t index) const
@@ -83,37 +70,46 @@ sf::Vector2f Polyline::getPoint(std::size_t index) const
 
 void Polyline::setPoint(std::size_t index, sf::Vector2f const& point)
 {
+    mGroup.notifyChanging(*this);
     mPoints[index] = point;
     update();
+    mGroup.notifyChanged(getId());
 }
 
 void Polyline::removePoint(std::size_t index)
 {
+    mGroup.notifyChanging(*this);
     mPoints.erase(mPoints.begin() + index);
     update();
+    mGroup.notifyChanged(getId());
 }
 
-void Polyline::setColor(sf::Color const& color)
+std::size_t Polyline::getPointCount() const
 {
-    sf::Color c = color;
-    c.a = 32;
-    for (std::size_t i = 0; i < mShapes.size(); i++)
-    {
-        mShapes[i].setOutlineColor(color);
-        mShapes[i].setFillColor(c);
-    }
+    return mPoints.size();
 }
 
-void Polyline::draw(sf::RenderTarget& target, sf::RenderStates states) const
+sf::FloatRect Polyline::getLocalBounds() const
 {
-    if (mVisible)
+    if (mPoints.empty())
+    {
+        return sf::FloatRect();
+    }
+    sf::Vector2f min = mPoints[0];
+    sf::Vector2f max = mPoints[0];
+    for (std::size_t i = 1; i < mPoints.size(); i++)
     {
-        states.transform.rotate(mRotation);
-        for (std::size_t i = 0; i < mShapes.size(); i++)
-        {
-            target.draw(mShapes[i], states);
-        }
+        min.x = std::min(min.x, mPoints[i].x);
+        min.y = std::min(min.y, mPoints[i].y);
+        max.x = std::max(max.x, mPoints[i].x);
+        max.y = std::max(max.y, mPoints[i].y);
     }
+    return sf::FloatRect(min, max - min);
+}
+
+void Polyline::buildVertices(std::vector<sf::Vertex>& vertices) const
+{
+    appendOutline(vertices, mPoints, false, mColor);
 }
 
 }
@@ -16,7 +16,6 @@ class Polyline : public ObjectBase
 
         void loadFromNode(pugi::xml_node const& object);
         void saveToNode(pugi::xml_node& object);
-        void update();
 
         void addPoint(sf::Vector2f const& point);
         void addPoint(sf::Vector2f const& point, std::size_t index);
@@ -25,12 +24,11 @@ class Polyline : public ObjectBase
         void removePoint(std::size_t index);
         std::size_t getPointCount() const;
 
-        void setColor(sf::Color const& color);
-
-        void draw(sf::RenderTarget& target, sf::RenderStates states = sf::RenderStates()) const;
+    protected:
+        sf::FloatRect getLocalBounds() const;
+        void buildVertices(std::vector<sf::Vertex>& vertices) const;
 
     private:
-        std::vector<sf::RectangleShape> mShapes;
         std::vector<sf::Vector2f> mPoints;
 };
 
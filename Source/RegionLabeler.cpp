@@ -0,0 +1,191 @@
+#include "RegionLabeler.hpp"
+#include "Map.hpp"
+#include "ThreadPool.hpp"
+
+namespace tmx
+{
+
+RegionLabeler::RegionLabeler(unsigned int bandHeight)
+: mBandHeight((bandHeight > 0) ? bandHeight : 1)
+, mSize()
+, mParents()
+, mLabels()
+, mRegions()
+, mMask()
+{
+}
+
+std::size_t RegionLabeler::compute(BitGrid const& mask, MapGeometry const& geometry, bool corners)
+{
+    mSize = mask.getSize();
+    const int width = mSize.x;
+    const std::size_t cells = static_cast<std::size_t>(mSize.x * mSize.y);
+    const int bandHeight = static_cast<int>(mBandHeight);
+    const std::size_t bands = (mSize.y + bandHeight - 1) / bandHeight;
+    mParents.resize(cells);
+    mLabels.resize(cells);
+    mRegions.clear();
+
+    // Unions inside each band only touch the cells of the band
+    detail::ThreadPool::getDefault().parallelFor(bands, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t band = begin; band < end; band++)
+        {
+            int top = static_cast<int>(band) * bandHeight;
+            int bottom = std::min(top + bandHeight, mSize.y);
+            for (int y = top; y < bottom; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    mParents[x + y * width] = x + y * width;
+                }
+            }
+            for (int y = top; y < bottom; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    sf::Vector2i coords(x, y);
+                    if (!mask.test(coords))
+                    {
+                        continue;
+                    }
+                    Span<sf::Vector2i> offsets = geometry.getNeighbourOffsets(coords, corners);
+                    for (std::size_t k = 0; k < offsets.size(); k++)
+                    {
+                        sf::Vector2i n = coords + offsets[k];
+                        if (top <= n.y && n.y < bottom && 0 <= n.x && n.x < width && mask.test(n))
+                        {
+                            unite(x + y * width, n.x + n.y * width);
+                        }
+                    }
+                }
+            }
+        }
+    }, 1);
+
+    // Neighbours reach at most two rows up, across the border with the previous band
+    for (std::size_t band = 1; band < bands; band++)
+    {
+        int top = static_cast<int>(band) * bandHeight;
+        for (int y = top; y < std::min(top + 2, mSize.y); y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                sf::Vector2i coords(x, y);
+                if (!mask.test(coords))
+                {
+                    continue;
+                }
+                Span<sf::Vector2i> offsets = geometry.getNeighbourOffsets(coords, corners);
+                for (std::size_t k = 0; k < offsets.size(); k++)
+                {
+                    sf::Vector2i n = coords + offsets[k];
+                    if (0 <= n.y && n.y < top && 0 <= n.x && n.x < width && mask.test(n))
+                    {
+                        unite(x + y * width, n.x + n.y * width);
+                    }
+                }
+            }
+        }
+    }
+
+    // Roots are the first cell of their region, so they are labelled before the rest of it
+    for (int y = 0; y < mSize.y; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int cell = x + y * width;
+            if (!mask.test(sf::Vector2i(x, y)))
+            {
+                mLabels[cell] = -1;
+                continue;
+            }
+            int root = find(cell);
+            if (root == cell)
+            {
+                mLabels[cell] = static_cast<int>(mRegions.size());
+                Region region;
+                region.area = 0;
+                region.bounds = sf::IntRect(x, y, 1, 1);
+                region.seed = sf::Vector2i(x, y);
+                mRegions.push_back(region);
+            }
+            else
+            {
+                mLabels[cell] = mLabels[root];
+            }
+            Region& region = mRegions[mLabels[cell]];
+            region.area++;
+            int left = std::min(region.bounds.left, x);
+            int right = std::max(region.bounds.left + region.bounds.width, x + 1);
+            region.bounds.left = left;
+            region.bounds.width = right - left;
+            region.bounds.height = y + 1 - region.bounds.top;
+        }
+    }
+    return mRegions.size();
+}
+
+std::size_t RegionLabeler::compute(Layer const& layer, TileSelector const& selector, bool corners)
+{
+    selector.selectCells(layer, mMask);
+    return compute(mMask, layer.getMap().getGeometry(), corners);
+}
+
+int RegionLabeler::getLabel(sf::Vector2i const& coords) const
+{
+    if (0 <= coords.x && coords.x < mSize.x && 0 <= coords.y && coords.y < mSize.y)
+    {
+        return mLabels[coords.x + coords.y * mSize.x];
+    }
+    return -1;
+}
+
+const std::vector<int>& RegionLabeler::getLabels() const
+{
+    return mLabels;
+}
+
+const std::vector<RegionLabeler::Region>& RegionLabeler::getRegions() const
+{
+    return mRegions;
+}
+
+const sf::Vector2i& RegionLabeler::getSize() const
+{
+    return mSize;
+}
+
+int RegionLabeler::find(int cell) const
+{
+    while (mParents[cell] != cell)
+    {
+        cell = mParents[cell];
+    }
+    return cell;
+}
+
+void RegionLabeler::unite(int a, int b)
+{
+    // Path halving, the smaller index becomes the root
+    while (mParents[a] != a)
+    {
+        mParents[a] = mParents[mParents[a]];
+        a = mParents[a];
+    }
+    while (mParents[b] != b)
+    {
+        mParents[b] = mParents[mParents[b]];
+        b = mParents[b];
+    }
+    if (a < b)
+    {
+        mParents[b] = a;
+    }
+    else if (b < a)
+    {
+        mParents[a] = b;
+    }
+}
+
+} // namespace tmx
@@ -0,0 +1,53 @@
+#ifndef TMX_REGIONLABELER_HPP
+#define TMX_REGIONLABELER_HPP
+
+#include "BitGrid.hpp"
+#include "Layer.hpp"
+#include "MapGeometry.hpp"
+#include "TileSelector.hpp"
+
+namespace tmx
+{
+
+// Connected regions of the set cells of a mask, neighbours follow the map geometry
+// Bands of rows are joined in parallel with a union-find, then merged along their borders
+// The buffers are kept between computations
+class RegionLabeler
+{
+    public:
+        struct Region
+        {
+            std::size_t area;
+            sf::IntRect bounds;
+            sf::Vector2i seed; // First cell in row-major order
+        };
+
+        RegionLabeler(unsigned int bandHeight = 32);
+
+        // Returns the number of regions, labelled in the order of their first cell
+        std::size_t compute(BitGrid const& mask, MapGeometry const& geometry, bool corners = false);
+        std::size_t compute(Layer const& layer, TileSelector const& selector, bool corners = false);
+
+        // -1 for the cells out of every region
+        int getLabel(sf::Vector2i const& coords) const;
+        const std::vector<int>& getLabels() const;
+
+        const std::vector<Region>& getRegions() const;
+        const sf::Vector2i& getSize() const;
+
+    private:
+        int find(int cell) const;
+        void unite(int a, int b);
+
+    private:
+        unsigned int mBandHeight;
+        sf::Vector2i mSize;
+        std::vector<int> mParents;
+        std::vector<int> mLabels;
+        std::vector<Region> mRegions;
+        BitGrid mMask;
+};
+
+} // namespace tmx
+
+#endif // TMX_REGIONLABELER_HPP
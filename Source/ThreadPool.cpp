@@ -0,0 +1,143 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace tmx
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Set on worker threads, and on the caller while it helps, so nested calls run inline instead of waiting on themselves
+thread_local bool insidePool = false;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads)
+: mThreads()
+, mTask(nullptr)
+, mCount(0)
+, mGrain(1)
+, mNext(0)
+, mPending(0)
+, mGeneration(0)
+, mStop(false)
+{
+    if (threads == 0)
+    {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        threads = (hardware > 1) ? hardware - 1 : 0;
+    }
+    mThreads.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++)
+    {
+        mThreads.push_back(std::thread(&ThreadPool::work, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (std::size_t i = 0; i < mThreads.size(); i++)
+    {
+        mThreads[i].join();
+    }
+}
+
+std::size_t ThreadPool::getThreadCount() const
+{
+    return mThreads.size() + 1;
+}
+
+void ThreadPool::parallelFor(std::size_t count, Task const& task, std::size_t grain)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (grain == 0)
+    {
+        grain = std::max<std::size_t>(1, count / (getThreadCount() * 4));
+    }
+    if (mThreads.empty() || count <= grain || insidePool)
+    {
+        task(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(mCallMutex);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTask = &task;
+        mCount = count;
+        mGrain = grain;
+        mNext = 0;
+        mPending = mThreads.size();
+        mGeneration++;
+    }
+    mWake.notify_all();
+
+    insidePool = true;
+    runChunks();
+    insidePool = false;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this]() { return mPending == 0; });
+    mTask = nullptr;
+}
+
+ThreadPool& ThreadPool::getDefault()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::work()
+{
+    insidePool = true;
+    unsigned int generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this, generation]() { return mStop || mGeneration != generation; });
+            if (mStop)
+            {
+                return;
+            }
+            generation = mGeneration;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (--mPending == 0)
+            {
+                mDone.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    while (true)
+    {
+        std::size_t begin = mNext.fetch_add(mGrain);
+        if (begin >= mCount)
+        {
+            return;
+        }
+        (*mTask)(begin, std::min(begin + mGrain, mCount));
+    }
+}
+
+} // namespace detail
+
+} // namespace tmx
@@ -0,0 +1,58 @@
+#ifndef TMX_THREADPOOL_HPP
+#define TMX_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SFML/System/NonCopyable.hpp>
+
+namespace tmx
+{
+
+namespace detail
+{
+
+// Fixed set of worker threads running index ranges, the calling thread works too
+class ThreadPool : sf::NonCopyable
+{
+    public:
+        typedef std::function<void(std::size_t begin, std::size_t end)> Task;
+
+        ThreadPool(std::size_t threads = 0);
+        ~ThreadPool();
+
+        std::size_t getThreadCount() const;
+
+        // Splits [0, count) in chunks of grain indices (0 : automatic), returns when every chunk is done
+        void parallelFor(std::size_t count, Task const& task, std::size_t grain = 0);
+
+        static ThreadPool& getDefault();
+
+    private:
+        void work();
+        void runChunks();
+
+    private:
+        std::vector<std::thread> mThreads;
+        std::mutex mCallMutex;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        const Task* mTask;
+        std::size_t mCount;
+        std::size_t mGrain;
+        std::atomic<std::size_t> mNext;
+        std::size_t mPending;
+        unsigned int mGeneration;
+        bool mStop;
+};
+
+} // namespace detail
+
+} // namespace tmx
+
+#endif // TMX_THREADPOOL_HPP
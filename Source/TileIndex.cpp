@@ -0,0 +1,242 @@
+#include "TileIndex.hpp"
+#include "Map.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace tmx
+{
+
+namespace
+{
+
+bool rowMajorLess(sf::Vector2i const& a, sf::Vector2i const& b)
+{
+    return (a.y < b.y) || (a.y == b.y && a.x < b.x);
+}
+
+} // namespace
+
+TileIndex::TileIndex(Layer& layer)
+: mLayer(layer)
+, mProperty("")
+, mKeys()
+, mGroups()
+, mCells()
+, mBatching(false)
+, mMoves()
+{
+    mLayer.addListener(this);
+    rebuild();
+}
+
+TileIndex::TileIndex(Layer& layer, std::string const& property)
+: mLayer(layer)
+, mProperty(property)
+, mKeys()
+, mGroups()
+, mCells()
+, mBatching(false)
+, mMoves()
+{
+    mLayer.addListener(this);
+    rebuild();
+}
+
+TileIndex::~TileIndex()
+{
+    mLayer.removeListener(this);
+}
+
+Span<sf::Vector2i> TileIndex::getCells(unsigned int gid) const
+{
+    auto itr = mCells.find(gid);
+    return (itr != mCells.end() && mProperty == "") ? Span<sf::Vector2i>(itr->second) : Span<sf::Vector2i>();
+}
+
+Span<sf::Vector2i> TileIndex::getCells(std::string const& value) const
+{
+    auto group = mGroups.find(value);
+    if (group == mGroups.end())
+    {
+        return Span<sf::Vector2i>();
+    }
+    auto itr = mCells.find(group->second);
+    return (itr != mCells.end()) ? Span<sf::Vector2i>(itr->second) : Span<sf::Vector2i>();
+}
+
+const std::string& TileIndex::getProperty() const
+{
+    return mProperty;
+}
+
+void TileIndex::onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid)
+{
+    unsigned int previousKey = getKey(previous);
+    unsigned int key = getKey(gid);
+    if (previousKey != key)
+    {
+        if (mBatching)
+        {
+            Move move;
+            move.coords = coords;
+            move.previousKey = previousKey;
+            move.key = key;
+            mMoves.push_back(move);
+        }
+        else
+        {
+            erase(previousKey, coords);
+            insert(key, coords);
+        }
+    }
+}
+
+void TileIndex::onBatchBegin(Layer& layer)
+{
+    mBatching = true;
+    mMoves.clear();
+}
+
+void TileIndex::onBatchEnd(Layer& layer)
+{
+    mBatching = false;
+    applyMoves();
+}
+
+void TileIndex::rebuild()
+{
+    mKeys.clear();
+    mGroups.clear();
+    mCells.clear();
+
+    // Tiles sharing a property value share a key, the keys start at 1
+    if (mProperty != "")
+    {
+        Map& map = mLayer.getMap();
+        for (std::size_t i = 0; i < map.getTilesetCount(); i++)
+        {
+            Tileset* tileset = map.getTilesetAt(i);
+            for (std::size_t j = 0; j < tileset->tiles(); j++)
+            {
+                Tileset::Tile& tile = tileset->getTile(j);
+                if (tile.hasProperty(mProperty))
+                {
+                    std::string value = tile.getProperty<std::string>(mProperty);
+                    auto group = mGroups.insert(std::make_pair(value, static_cast<unsigned int>(mGroups.size() + 1))).first;
+                    unsigned int gid = tileset->getFirstGid() + tile.getId();
+                    if (gid >= mKeys.size())
+                    {
+                        mKeys.resize(gid + 1, 0);
+                    }
+                    mKeys[gid] = group->second;
+                }
+            }
+        }
+    }
+
+    // Visited in row-major order, the groups are sorted as they are filled
+    const sf::Vector2i size = mLayer.getMap().getMapSize();
+    for (int y = 0; y < size.y; y++)
+    {
+        for (int x = 0; x < size.x; x++)
+        {
+            unsigned int key = getKey(mLayer.getTileId(sf::Vector2i(x, y)));
+            if (key != 0)
+            {
+                mCells[key].push_back(sf::Vector2i(x, y));
+            }
+        }
+    }
+}
+
+unsigned int TileIndex::getKey(unsigned int gid) const
+{
+    if (mProperty == "")
+    {
+        return gid;
+    }
+    return (gid < mKeys.size()) ? mKeys[gid] : 0;
+}
+
+void TileIndex::insert(unsigned int key, sf::Vector2i const& coords)
+{
+    if (key != 0)
+    {
+        std::vector<sf::Vector2i>& cells = mCells[key];
+        cells.insert(std::lower_bound(cells.begin(), cells.end(), coords, rowMajorLess), coords);
+    }
+}
+
+void TileIndex::erase(unsigned int key, sf::Vector2i const& coords)
+{
+    auto itr = mCells.find(key);
+    if (key == 0 || itr == mCells.end())
+    {
+        return;
+    }
+    std::vector<sf::Vector2i>& cells = itr->second;
+    auto found = std::lower_bound(cells.begin(), cells.end(), coords, rowMajorLess);
+    if (found != cells.end() && *found == coords)
+    {
+        cells.erase(found);
+    }
+}
+
+void TileIndex::applyMoves()
+{
+    const sf::Vector2i size = mLayer.getMap().getMapSize();
+    if (mMoves.size() * 4 >= static_cast<std::size_t>(size.x * size.y))
+    {
+        mMoves.clear();
+        rebuild();
+        return;
+    }
+
+    // A cell moved several times goes from its first group to its last one
+    auto less = [](Move const& a, Move const& b)
+    {
+        return rowMajorLess(a.coords, b.coords);
+    };
+    if (!std::is_sorted(mMoves.begin(), mMoves.end(), less))
+    {
+        std::stable_sort(mMoves.begin(), mMoves.end(), less);
+    }
+    std::unordered_map<unsigned int, std::pair<std::vector<sf::Vector2i>, std::vector<sf::Vector2i>>> changes; // Erased, inserted
+    for (std::size_t i = 0; i < mMoves.size();)
+    {
+        Move const& first = mMoves[i];
+        unsigned int key = first.key;
+        for (i++; i < mMoves.size() && mMoves[i].coords == first.coords; i++)
+        {
+            key = mMoves[i].key;
+        }
+        if (first.previousKey != key)
+        {
+            if (first.previousKey != 0)
+            {
+                changes[first.previousKey].first.push_back(first.coords);
+            }
+            if (key != 0)
+            {
+                changes[key].second.push_back(first.coords);
+            }
+        }
+    }
+    mMoves.clear();
+
+    // Each group is merged once with its sorted erased and inserted cells
+    std::vector<sf::Vector2i> kept;
+    std::vector<sf::Vector2i> merged;
+    for (auto itr = changes.begin(); itr != changes.end(); itr++)
+    {
+        std::vector<sf::Vector2i>& cells = mCells[itr->first];
+        kept.clear();
+        std::set_difference(cells.begin(), cells.end(), itr->second.first.begin(), itr->second.first.end(), std::back_inserter(kept), rowMajorLess);
+        merged.clear();
+        std::merge(kept.begin(), kept.end(), itr->second.second.begin(), itr->second.second.end(), std::back_inserter(merged), rowMajorLess);
+        cells.swap(merged);
+    }
+}
+
+} // namespace tmx
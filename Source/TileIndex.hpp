@@ -0,0 +1,60 @@
+#ifndef TMX_TILEINDEX_HPP
+#define TMX_TILEINDEX_HPP
+
+#include "Layer.hpp"
+
+namespace tmx
+{
+
+// Cells of a layer grouped by gid, or by the value of a tile property, sorted in row-major order
+// Each tile change moves one cell between groups, spans are invalidated by the next change
+// The index listens to its layer and must not outlive it
+class TileIndex : public Layer::Listener
+{
+    public:
+        TileIndex(Layer& layer);
+        TileIndex(Layer& layer, std::string const& property);
+        ~TileIndex();
+
+        // Cells using a gid, when indexing by gid
+        Span<sf::Vector2i> getCells(unsigned int gid) const;
+
+        // Cells whose tile has the property set to a value, when indexing by property
+        Span<sf::Vector2i> getCells(std::string const& value) const;
+
+        const std::string& getProperty() const;
+
+        void onTileChanged(Layer& layer, sf::Vector2i const& coords, unsigned int previous, unsigned int gid);
+        // The moves of a bulk edit are merged into each group once, or the index is rebuilt when they cover much of the layer
+        void onBatchBegin(Layer& layer);
+        void onBatchEnd(Layer& layer);
+
+        // Needed after the tilesets or their properties changed
+        void rebuild();
+
+    private:
+        unsigned int getKey(unsigned int gid) const;
+        void insert(unsigned int key, sf::Vector2i const& coords);
+        void erase(unsigned int key, sf::Vector2i const& coords);
+        void applyMoves();
+
+    private:
+        struct Move
+        {
+            sf::Vector2i coords;
+            unsigned int previousKey;
+            unsigned int key;
+        };
+
+        Layer& mLayer;
+        std::string mProperty;
+        std::vector<unsigned int> mKeys;
+        std::unordered_map<std::string, unsigned int> mGroups;
+        std::unordered_map<unsigned int, std::vector<sf::Vector2i>> mCells;
+        bool mBatching;
+        std::vector<Move> mMoves;
+};
+
+} // namespace tmx
+
+#endif // TMX_TILEINDEX_HPP
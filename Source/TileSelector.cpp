@@ -0,0 +1,86 @@
+#include "TileSelector.hpp"
+#include "BitGrid.hpp"
+#include "Layer.hpp"
+#include "Map.hpp"
+
+namespace tmx
+{
+
+TileSelector::TileSelector()
+: mSelected()
+{
+}
+
+TileSelector::TileSelector(std::vector<unsigned int> const& gids)
+: mSelected()
+{
+    for (std::size_t i = 0; i < gids.size(); i++)
+    {
+        select(gids[i]);
+    }
+}
+
+TileSelector::TileSelector(Map& map, std::string const& property, std::string const& value)
+: mSelected()
+{
+    selectProperty(map, property, value);
+}
+
+void TileSelector::select(unsigned int gid, bool selected)
+{
+    if (gid == 0)
+    {
+        return;
+    }
+    if (gid >= mSelected.size())
+    {
+        if (!selected)
+        {
+            return;
+        }
+        mSelected.resize(gid + 1, 0);
+    }
+    mSelected[gid] = (selected) ? 1 : 0;
+}
+
+void TileSelector::selectProperty(Map& map, std::string const& property, std::string const& value)
+{
+    // Without a value, any value other than false selects the tile
+    for (std::size_t i = 0; i < map.getTilesetCount(); i++)
+    {
+        Tileset* tileset = map.getTilesetAt(i);
+        for (std::size_t j = 0; j < tileset->tiles(); j++)
+        {
+            Tileset::Tile& tile = tileset->getTile(j);
+            if (tile.hasProperty(property))
+            {
+                std::string v = tile.getProperty<std::string>(property);
+                bool selected = (value != "") ? (v == value) : (v != "false" && v != "0");
+                select(tileset->getFirstGid() + tile.getId(), selected);
+            }
+        }
+    }
+}
+
+void TileSelector::selectCells(Layer const& layer, BitGrid& mask) const
+{
+    const sf::Vector2i size = layer.getMap().getMapSize();
+    const std::vector<unsigned int>& gids = layer.getTileIds();
+    mask.resize(size);
+    if (gids.size() < static_cast<std::size_t>(size.x * size.y))
+    {
+        return;
+    }
+    for (int y = 0; y < size.y; y++)
+    {
+        for (int x = 0; x < size.x; x++)
+        {
+            if (isSelected(gids[x + y * size.x]))
+            {
+                mask.set(sf::Vector2i(x, y));
+            }
+        }
+    }
+}
+
+} // namespace tmx
@@ -0,0 +1,46 @@
+#ifndef TMX_TILESELECTOR_HPP
+#define TMX_TILESELECTOR_HPP
+
+#include "Utils.hpp"
+
+namespace tmx
+{
+
+class BitGrid;
+class Layer;
+class Map;
+
+// Gid lookup table telling which tiles take part in an extraction (collision, opacity, ...)
+class TileSelector
+{
+    public:
+        TileSelector();
+        TileSelector(std::vector<unsigned int> const& gids);
+        TileSelector(Map& map, std::string const& property, std::string const& value = "");
+
+        void select(unsigned int gid, bool selected = true);
+        void selectProperty(Map& map, std::string const& property, std::string const& value = "");
+
+        bool isSelected(unsigned int gid) const;
+        bool operator()(unsigned int gid) const;
+
+        // Sets the bits of the selected cells of a layer, the mask takes the size of the map
+        void selectCells(Layer const& layer, BitGrid& mask) const;
+
+    private:
+        std::vector<unsigned char> mSelected;
+};
+
+inline bool TileSelector::isSelected(unsigned int gid) const
+{
+    return gid < mSelected.size() && mSelected[gid] != 0;
+}
+
+inline bool TileSelector::operator()(unsigned int gid) const
+{
+    return isSelected(gid);
+}
+
+} // namespace tmx
+
+#endif // TMX_TILESELECTOR_HPP
@@ -1,5 +1,8 @@
 #include "Tileset.hpp"
 #include "Map.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
 
 namespace tmx
 {
@@ -17,8 +20,10 @@ Tileset::Tileset(Map& map)
 , mTileOffset({0.f, 0.f})
 , mImage()
 , mTexture()
+, mAverageColors()
 , mTerrains()
 , mTiles()
+, mTileIndex()
 {
 }
 
@@ -97,10 +102,11 @@ bool Tileset::loadFromNode(pugi::xml_node const& tileset, bool fromTsx)
         mTiles.push_back(Tile());
         mTiles.back().loadFromNode(tile);
     }
+    mTileIndex.clear();
 
     loadProperties(tileset);
 
-    return mImage.loadTexture(mTexture, mMap.getPath());
+    return loadTexture();
 }
 
 bool Tileset::loadFromFile(std::string const& filename)
@@ -340,7 +346,73 @@ void Tileset::setImageSize(sf::Vector2i const& size)
 
 bool Tileset::loadTexture()
 {
-    return mImage.loadTexture(mTexture, mMap.getPath());
+    sf::Image image;
+    mAverageColors.clear();
+    if (!mImage.loadImage(image, mMap.getPath()))
+    {
+        return false;
+    }
+    computeAverageColors(image);
+    if (!mTexture.loadFromImage(image))
+    {
+        detail::log("Unable to load texture from image");
+        return false;
+    }
+    return true;
+}
+
+sf::Color Tileset::getAverageColor(unsigned int gid) const
+{
+    if (gid < mFirstGid || gid - mFirstGid >= mAverageColors.size())
+    {
+        return sf::Color::Transparent;
+    }
+    return mAverageColors[gid - mFirstGid];
+}
+
+const std::vector<sf::Color>& Tileset::getAverageColors() const
+{
+    return mAverageColors;
+}
+
+void Tileset::computeAverageColors(sf::Image const& image)
+{
+    const sf::Uint8* pixels = image.getPixelsPtr();
+    sf::Vector2i imageSize = static_cast<sf::Vector2i>(image.getSize());
+    if (pixels == nullptr || mColumns == 0)
+    {
+        return;
+    }
+    mAverageColors.assign(mTileCount, sf::Color::Transparent);
+    detail::ThreadPool::getDefault().parallelFor(mTileCount, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t id = begin; id < end; id++)
+        {
+            int left = (id % mColumns) * (mTileSize.x + mSpacing) + mMargin;
+            int top = (id / mColumns) * (mTileSize.y + mSpacing) + mMargin;
+            int right = std::min(left + mTileSize.x, imageSize.x);
+            int bottom = std::min(top + mTileSize.y, imageSize.y);
+
+            // Colors weighted by their alpha, so transparent pixels do not darken the tile
+            sf::Uint64 r = 0, g = 0, b = 0, a = 0;
+            for (int y = top; y < bottom; y++)
+            {
+                const sf::Uint8* p = pixels + (y * imageSize.x + left) * 4;
+                for (int x = left; x < right; x++, p += 4)
+                {
+                    r += p[0] * p[3];
+                    g += p[1] * p[3];
+                    b += p[2] * p[3];
+                    a += p[3];
+                }
+            }
+            sf::Uint64 count = static_cast<sf::Uint64>(std::max(right - left, 0)) * std::max(bottom - top, 0);
+            if (a > 0)
+            {
+                mAverageColors[id] = sf::Color(static_cast<sf::Uint8>(r / a), static_cast<sf::Uint8>(g / a), static_cast<sf::Uint8>(b / a), static_cast<sf::Uint8>(a / count));
+            }
+        }
+    }, 16);
 }
 
 sf::Texture& Tileset::getTexture()
@@ -438,6 +510,7 @@ Tileset::Tile::Tile()
 , mTerrains()
 , mProbability(1.f)
 , mAnimations()
+, mShapes()
 {
 }
 
@@ -461,7 +534,7 @@ void Tileset::Tile::loadFromNode(pugi::xml_node const& tile)
         }
     }
 
-    mProbability = tile.attribute("probability").as_float();
+    mProbability = tile.attribute("probability").as_float(1.f);
 
     for (const pugi::xml_node& animation : tile.children("animation"))
     {
@@ -469,6 +542,16 @@ void Tileset::Tile::loadFromNode(pugi::xml_node const& tile)
         mAnimations.back().loadFromNode(animation);
     }
 
+    pugi::xml_node objectgroup = tile.child("objectgroup");
+    if (objectgroup)
+    {
+        for (const pugi::xml_node& object : objectgroup.children("object"))
+        {
+            mShapes.push_back(Shape());
+            mShapes.back().loadFromNode(object);
+        }
+    }
+
     loadProperties(tile);
 }
 
@@ -492,6 +575,19 @@ void Tileset::Tile::saveToNode(pugi::xml_node& tile)
         tile.append_attribute("probability") = mProbability;
     }
 
+    saveProperties(tile);
+
+    if (mShapes.size() > 0)
+    {
+        pugi::xml_node objectgroup = tile.append_child("objectgroup");
+        objectgroup.append_attribute("draworder") = "index";
+        for (std::size_t i = 0; i < mShapes.size(); i++)
+        {
+            pugi::xml_node object = objectgroup.append_child("object");
+            mShapes[i].saveToNode(object);
+        }
+    }
+
     for (std::size_t i = 0; i < mAnimations.size(); i++)
     {
         pugi::xml_node animation = tile.append_child("animation");
@@ -598,6 +694,234 @@ void Tileset::Tile::removeAnimation(std::size_t index)
     mAnimations.erase(mAnimations.begin() + index);
 }
 
+Tileset::Tile::Shape::Shape()
+: mId(0)
+, mName("")
+, mType("")
+, mObjectType(tmx::ESimple)
+, mPosition({0.f, 0.f})
+, mSize({0.f, 0.f})
+, mRotation(0.f)
+, mPoints()
+{
+}
+
+void Tileset::Tile::Shape::loadFromNode(pugi::xml_node const& object)
+{
+    for (const pugi::xml_attribute& attr : object.attributes())
+    {
+        if (attr.name() == std::string("id"))
+        {
+            mId = attr.as_uint();
+        }
+        if (attr.name() == std::string("name"))
+        {
+            mName = attr.as_string();
+        }
+        if (attr.name() == std::string("type"))
+        {
+            mType = attr.as_string();
+        }
+        if (attr.name() == std::string("x"))
+        {
+            mPosition.x = attr.as_float();
+        }
+        if (attr.name() == std::string("y"))
+        {
+            mPosition.y = attr.as_float();
+        }
+        if (attr.name() == std::string("width"))
+        {
+            mSize.x = attr.as_float();
+        }
+        if (attr.name() == std::string("height"))
+        {
+            mSize.y = attr.as_float();
+        }
+        if (attr.name() == std::string("rotation"))
+        {
+            mRotation = attr.as_float();
+        }
+    }
+
+    pugi::xml_node points;
+    if (object.child("ellipse"))
+    {
+        mObjectType = tmx::EEllipse;
+    }
+    else if ((points = object.child("polygon")))
+    {
+        mObjectType = tmx::EPolygon;
+    }
+    else if ((points = object.child("polyline")))
+    {
+        mObjectType = tmx::EPolyline;
+    }
+    else
+    {
+        mObjectType = tmx::ESimple;
+    }
+    if (points)
+    {
+        std::string point;
+        std::stringstream ss(points.attribute("points").as_string());
+        while (std::getline(ss, point, ' '))
+        {
+            mPoints.push_back(detail::fromString<sf::Vector2f>(point));
+        }
+    }
+
+    loadProperties(object);
+}
+
+void Tileset::Tile::Shape::saveToNode(pugi::xml_node& object)
+{
+    object.append_attribute("id") = mId;
+    if (mName != "")
+    {
+        object.append_attribute("name") = mName.c_str();
+    }
+    if (mType != "")
+    {
+        object.append_attribute("type") = mType.c_str();
+    }
+    object.append_attribute("x") = mPosition.x;
+    object.append_attribute("y") = mPosition.y;
+    if (mSize != sf::Vector2f())
+    {
+        object.append_attribute("width") = mSize.x;
+        object.append_attribute("height") = mSize.y;
+    }
+    if (mRotation != 0.f)
+    {
+        object.append_attribute("rotation") = mRotation;
+    }
+    saveProperties(object);
+    if (mObjectType == tmx::EEllipse)
+    {
+        object.append_child("ellipse");
+    }
+    else if (mObjectType == tmx::EPolygon || mObjectType == tmx::EPolyline)
+    {
+        std::string points;
+        for (std::size_t i = 0; i < mPoints.size(); i++)
+        {
+            points += detail::toString(mPoints[i]) + " ";
+        }
+        if (points.size() > 0)
+        {
+            points.pop_back(); // Remove the last space
+        }
+        const char* name = (mObjectType == tmx::EPolygon) ? "polygon" : "polyline";
+        object.append_child(name).append_attribute("points") = points.c_str();
+    }
+}
+
+unsigned int Tileset::Tile::Shape::getId() const
+{
+    return mId;
+}
+
+const std::string& Tileset::Tile::Shape::getName() const
+{
+    return mName;
+}
+
+const std::string& Tileset::Tile::Shape::getType() const
+{
+    return mType;
+}
+
+ObjectType Tileset::Tile::Shape::getObjectType() const
+{
+    return mObjectType;
+}
+
+const sf::Vector2f& Tileset::Tile::Shape::getPosition() const
+{
+    return mPosition;
+}
+
+const sf::Vector2f& Tileset::Tile::Shape::getSize() const
+{
+    return mSize;
+}
+
+float Tileset::Tile::Shape::getRotation() const
+{
+    return mRotation;
+}
+
+const std::vector<sf::Vector2f>& Tileset::Tile::Shape::getPoints() const
+{
+    return mPoints;
+}
+
+void Tileset::Tile::Shape::setId(unsigned int id)
+{
+    mId = id;
+}
+
+void Tileset::Tile::Shape::setName(std::string const& name)
+{
+    mName = name;
+}
+
+void Tileset::Tile::Shape::setType(std::string const& type)
+{
+    mType = type;
+}
+
+void Tileset::Tile::Shape::setObjectType(ObjectType objectType)
+{
+    mObjectType = objectType;
+}
+
+void Tileset::Tile::Shape::setPosition(sf::Vector2f const& position)
+{
+    mPosition = position;
+}
+
+void Tileset::Tile::Shape::setSize(sf::Vector2f const& size)
+{
+    mSize = size;
+}
+
+void Tileset::Tile::Shape::setRotation(float rotation)
+{
+    mRotation = rotation;
+}
+
+void Tileset::Tile::Shape::setPoints(std::vector<sf::Vector2f> const& points)
+{
+    mPoints = points;
+}
+
+void Tileset::Tile::addShape()
+{
+    mShapes.push_back(Shape());
+}
+
+Tileset::Tile::Shape& Tileset::Tile::getShape(std::size_t index)
+{
+    return mShapes.at(index);
+}
+
+const Tileset::Tile::Shape& Tileset::Tile::getShape(std::size_t index) const
+{
+    return mShapes.at(index);
+}
+
+std::size_t Tileset::Tile::shapes() const
+{
+    return mShapes.size();
+}
+
+void Tileset::Tile::removeShape(std::size_t index)
+{
+    mShapes.erase(mShapes.begin() + index);
+}
+
 void Tileset::addTerrain(std::string const& name, unsigned int tileId)
 {
     mTerrains.push_back(Terrain());
@@ -624,6 +948,7 @@ void Tileset::addTile(unsigned int tileId)
 {
     mTiles.push_back(Tile());
     mTiles.back().setId(tileId);
+    mTileIndex.clear();
 }
 
 Tileset::Tile& Tileset::getTile(std::size_t index)
@@ -639,6 +964,33 @@ std::size_t Tileset::tiles() const
 void Tileset::removeTile(std::size_t index)
 {
     mTiles.erase(mTiles.begin() + index);
+    mTileIndex.clear();
+}
+
+Tileset::Tile* Tileset::getTileByGid(unsigned int gid)
+{
+    if (gid < mFirstGid || mTiles.empty())
+    {
+        return nullptr;
+    }
+    if (mTileIndex.empty())
+    {
+        for (std::size_t i = 0; i < mTiles.size(); i++)
+        {
+            unsigned int id = mTiles[i].getId();
+            if (id >= mTileIndex.size())
+            {
+                mTileIndex.resize(id + 1, -1);
+            }
+            mTileIndex[id] = static_cast<int>(i);
+        }
+    }
+    unsigned int id = gid - mFirstGid;
+    if (id < mTileIndex.size() && mTileIndex[id] >= 0)
+    {
+        return &mTiles[mTileIndex[id]];
+    }
+    return nullptr;
 }
 
 } // namespace tmx
@@ -47,9 +47,14 @@ class Tileset : public detail::PropertiesHolder
         void setImageTransparent(sf::Color const& color);
         void setImageSize(sf::Vector2i const& size);
 
+        // Also computes the average color of every tile, from the pixels still on the CPU side
         bool loadTexture();
 
         sf::Texture& getTexture();
+
+        // Average of the tile pixels weighted by their alpha, transparent for unknown gids or before the texture is loaded
+        sf::Color getAverageColor(unsigned int gid) const;
+        const std::vector<sf::Color>& getAverageColors() const;
         sf::Vector2i toPos(unsigned int gid);
         sf::IntRect toRect(unsigned int gid);
         unsigned int toId(sf::Vector2i const& pos);
@@ -73,7 +78,6 @@ class Tileset : public detail::PropertiesHolder
                 unsigned int mTile;
         };
 
-        // TODO : T - Tile::ObjectGroup
         // TODO : T - Tile::Image
         class Tile : public PropertiesHolder
         {
@@ -119,11 +123,56 @@ class Tileset : public detail::PropertiesHolder
                 std::size_t animations() const;
                 void removeAnimation(std::size_t index);
 
+                // Collision shape from the tile objectgroup, relative to the top left of the tile
+                class Shape : public PropertiesHolder
+                {
+                    public:
+                        Shape();
+
+                        void loadFromNode(pugi::xml_node const& object);
+                        void saveToNode(pugi::xml_node& object);
+
+                        unsigned int getId() const;
+                        const std::string& getName() const;
+                        const std::string& getType() const;
+                        ObjectType getObjectType() const;
+                        const sf::Vector2f& getPosition() const;
+                        const sf::Vector2f& getSize() const;
+                        float getRotation() const;
+                        const std::vector<sf::Vector2f>& getPoints() const;
+
+                        void setId(unsigned int id);
+                        void setName(std::string const& name);
+                        void setType(std::string const& type);
+                        void setObjectType(ObjectType objectType);
+                        void setPosition(sf::Vector2f const& position);
+                        void setSize(sf::Vector2f const& size);
+                        void setRotation(float rotation);
+                        void setPoints(std::vector<sf::Vector2f> const& points);
+
+                    private:
+                        unsigned int mId;
+                        std::string mName;
+                        std::string mType;
+                        ObjectType mObjectType;
+                        sf::Vector2f mPosition;
+                        sf::Vector2f mSize;
+                        float mRotation;
+                        std::vector<sf::Vector2f> mPoints;
+                };
+
+                void addShape();
+                Shape& getShape(std::size_t index);
+                const Shape& getShape(std::size_t index) const;
+                std::size_t shapes() const;
+                void removeShape(std::size_t index);
+
             private:
                 unsigned int mId;
                 std::array<std::string,4> mTerrains;
                 float mProbability;
                 std::vector<Animation> mAnimations;
+                std::vector<Shape> mShapes;
         };
 
         void addTerrain(std::string const& name, unsigned int tileId);
@@ -135,6 +184,10 @@ class Tileset : public detail::PropertiesHolder
         Tile& getTile(std::size_t index);
         std::size_t tiles() const;
         void removeTile(std::size_t index);
+        Tile* getTileByGid(unsigned int gid);
+
+    protected:
+        void computeAverageColors(sf::Image const& image);
 
     protected:
         Map& mMap;
@@ -151,9 +204,11 @@ class Tileset : public detail::PropertiesHolder
 
         detail::Image mImage;
         sf::Texture mTexture;
+        std::vector<sf::Color> mAverageColors;
 
         std::vector<Terrain> mTerrains;
         std::vector<Tile> mTiles;
+        std::vector<int> mTileIndex; // Local id to index in mTiles, rebuilt when the tiles change
 };
 
 } // namespace tmx
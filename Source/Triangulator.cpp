@@ -0,0 +1,170 @@
+#include "Triangulator.hpp"
+
+namespace tmx
+{
+
+namespace detail
+{
+
+Triangulator::Triangulator()
+: mPoints(nullptr)
+, mWinding(1.f)
+, mPrevious()
+, mNext()
+, mReflex()
+, mReflexVertices()
+, mIndices()
+{
+}
+
+bool Triangulator::triangulate(std::vector<sf::Vector2f> const& points, std::vector<unsigned int>& indices)
+{
+    const unsigned int count = static_cast<unsigned int>(points.size());
+    if (count < 3)
+    {
+        return false;
+    }
+    mPoints = &points;
+
+    // The sign of the area gives the winding, every cross product is then compared with it
+    float area = 0.f;
+    for (unsigned int i = 0, j = count - 1; i < count; j = i++)
+    {
+        area += points[j].x * points[i].y - points[i].x * points[j].y;
+    }
+    mWinding = (area < 0.f) ? -1.f : 1.f;
+
+    mPrevious.resize(count);
+    mNext.resize(count);
+    mReflex.resize(count);
+    mReflexVertices.clear();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        mPrevious[i] = (i == 0) ? count - 1 : i - 1;
+        mNext[i] = (i + 1 == count) ? 0 : i + 1;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        mReflex[i] = isReflex(i);
+        if (mReflex[i])
+        {
+            mReflexVertices.push_back(i);
+        }
+    }
+
+    bool success = true;
+    unsigned int remaining = count;
+    unsigned int vertex = 0;
+    unsigned int tested = 0;
+    while (remaining > 3)
+    {
+        unsigned int previous = mPrevious[vertex];
+        unsigned int next = mNext[vertex];
+        float c = cross(previous, vertex, next);
+        bool degenerate = (c == 0.f);
+        if (degenerate || isEar(vertex) || tested >= remaining)
+        {
+            // Degenerate vertices are dropped, and a polygon without ears (self intersecting) is clipped anyway
+            if (!degenerate)
+            {
+                indices.push_back(previous);
+                indices.push_back(vertex);
+                indices.push_back(next);
+            }
+            if (tested >= remaining)
+            {
+                success = false;
+            }
+            mNext[previous] = next;
+            mPrevious[next] = previous;
+            remaining--;
+            if (mReflex[previous] && !isReflex(previous))
+            {
+                mReflex[previous] = 0;
+            }
+            if (mReflex[next] && !isReflex(next))
+            {
+                mReflex[next] = 0;
+            }
+            mReflex[vertex] = 0;
+            vertex = previous;
+            tested = 0;
+        }
+        else
+        {
+            vertex = next;
+            tested++;
+        }
+    }
+    if (cross(mPrevious[vertex], vertex, mNext[vertex]) != 0.f)
+    {
+        indices.push_back(mPrevious[vertex]);
+        indices.push_back(vertex);
+        indices.push_back(mNext[vertex]);
+    }
+    mPoints = nullptr;
+    return success;
+}
+
+bool Triangulator::triangulate(std::vector<sf::Vector2f> const& points, std::vector<sf::Vector2f>& triangles)
+{
+    mIndices.clear();
+    bool success = triangulate(points, mIndices);
+    triangles.reserve(triangles.size() + mIndices.size());
+    for (std::size_t i = 0; i < mIndices.size(); i++)
+    {
+        triangles.push_back(points[mIndices[i]]);
+    }
+    return success;
+}
+
+float Triangulator::cross(unsigned int a, unsigned int b, unsigned int c) const
+{
+    const sf::Vector2f& pa = (*mPoints)[a];
+    const sf::Vector2f& pb = (*mPoints)[b];
+    const sf::Vector2f& pc = (*mPoints)[c];
+    return ((pb.x - pa.x) * (pc.y - pb.y) - (pb.y - pa.y) * (pc.x - pb.x)) * mWinding;
+}
+
+bool Triangulator::isReflex(unsigned int vertex) const
+{
+    return cross(mPrevious[vertex], vertex, mNext[vertex]) < 0.f;
+}
+
+bool Triangulator::isEar(unsigned int vertex) const
+{
+    if (mReflex[vertex])
+    {
+        return false;
+    }
+    const unsigned int a = mPrevious[vertex];
+    const unsigned int c = mNext[vertex];
+    const std::vector<sf::Vector2f>& points = *mPoints;
+
+    // Only the reflex vertices can be inside the candidate ear
+    for (std::size_t i = 0; i < mReflexVertices.size(); i++)
+    {
+        unsigned int r = mReflexVertices[i];
+        if (!mReflex[r] || r == a || r == vertex || r == c)
+        {
+            continue;
+        }
+        const sf::Vector2f& p = points[r];
+        if (points[r] == points[a] || points[r] == points[c])
+        {
+            continue;
+        }
+        float ab = ((points[vertex].x - points[a].x) * (p.y - points[a].y) - (points[vertex].y - points[a].y) * (p.x - points[a].x)) * mWinding;
+        float bc = ((points[c].x - points[vertex].x) * (p.y - points[vertex].y) - (points[c].y - points[vertex].y) * (p.x - points[vertex].x)) * mWinding;
+        float ca = ((points[a].x - points[c].x) * (p.y - points[c].y) - (points[a].y - points[c].y) * (p.x - points[c].x)) * mWinding;
+        if (ab >= 0.f && bc >= 0.f && ca >= 0.f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+} // namespace tmx
@@ -0,0 +1,41 @@
+#ifndef TMX_TRIANGULATOR_HPP
+#define TMX_TRIANGULATOR_HPP
+
+#include "Utils.hpp"
+
+namespace tmx
+{
+
+namespace detail
+{
+
+// Ear clipping triangulation of simple polygons, concave or not, in any winding
+// The working buffers are kept between calls, so a triangulator reused over many polygons doesn't allocate
+class Triangulator
+{
+    public:
+        Triangulator();
+
+        bool triangulate(std::vector<sf::Vector2f> const& points, std::vector<unsigned int>& indices);
+        bool triangulate(std::vector<sf::Vector2f> const& points, std::vector<sf::Vector2f>& triangles);
+
+    private:
+        float cross(unsigned int a, unsigned int b, unsigned int c) const;
+        bool isEar(unsigned int vertex) const;
+        bool isReflex(unsigned int vertex) const;
+
+    private:
+        const std::vector<sf::Vector2f>* mPoints;
+        float mWinding;
+        std::vector<unsigned int> mPrevious;
+        std::vector<unsigned int> mNext;
+        std::vector<unsigned char> mReflex;
+        std::vector<unsigned int> mReflexVertices;
+        std::vector<unsigned int> mIndices;
+};
+
+} // namespace detail
+
+} // namespace tmx
+
+#endif // TMX_TRIANGULATOR_HPP
@@ -1,104 +1,43 @@
 #include "Utils.hpp"
 #include "Map.hpp"
+#include "MapGeometry.hpp"
 
 namespace tmx
 {
 
 sf::Vector2i worldToOrthoCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize)
 {
-    return sf::Vector2i(world.x / tileSize.x, world.y / tileSize.y);
+    return MapGeometry("orthogonal", tileSize).worldToCoords(world);
 }
 
 sf::Vector2i worldToIsoCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize)
 {
-    // TODO : M - Conversion test
-    return sf::Vector2i();
+    return MapGeometry("isometric", tileSize).worldToCoords(world);
 }
 
-// TODO : M - Conversion test
 sf::Vector2i worldToStaggerCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize, std::string const& axis, std::string const& index)
 {
-    sf::Vector2f s = sf::Vector2f(tileSize.x * 0.5f, tileSize.y * 0.5f);
-    sf::Vector2f mc = sf::Vector2f(floor(world.x / s.x), floor(world.y / s.y));
-    sf::Vector2f p = world - sf::Vector2f(mc.x * s.x, mc.y * s.y);
-    const float rad = 0.523599f; // = 30 degrees
-    int indexInt = (index == "odd") ? 0 : 1;
-    if (axis == "y")
-    {
-        if (((int)mc.x + (int)mc.y) % 2 == indexInt)
-        {
-            if (std::atan2(s.y - p.y,p.x) > rad)
-            {
-                mc.x--;
-                mc.y--;
-            }
-        }
-        else
-        {
-            if (std::atan2(-p.y,p.x) > -rad)
-            {
-                mc.y--;
-            }
-            else
-            {
-                mc.x--;
-            }
-        }
-        return sf::Vector2i(floor(mc.x * 0.5f), mc.y);
-    }
-    else
-    {
-        if (((int)mc.x + (int)mc.y) % 2 == indexInt)
-        {
-            if (std::atan2(s.x - p.x,p.y) > rad)
-            {
-                mc.x--;
-                mc.y--;
-            }
-        }
-        else
-        {
-            if (std::atan2(-p.x,p.y) > -rad)
-            {
-                mc.x--;
-            }
-            else
-            {
-                mc.y--;
-            }
-        }
-        return sf::Vector2i(mc.x, floor(mc.y * 0.5f));
-    }
+    return MapGeometry("staggered", tileSize, axis, index).worldToCoords(world);
 }
 
 sf::Vector2i worldToHexaCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize, unsigned int hexSideLength, std::string const& axis, std::string const& index)
 {
-    return sf::Vector2i(); // TODO :M - Conversion
+    return MapGeometry("hexagonal", tileSize, axis, index, hexSideLength).worldToCoords(world);
 }
 
 sf::Vector2i worldToCoords(std::string const& orientation, sf::Vector2f const& world, sf::Vector2i const& tileSize, std::string const& axis, std::string const& index, unsigned int hexSideLength)
 {
-    if (orientation == "hexagonal")
-    {
-        return worldToHexaCoords(world, tileSize, hexSideLength, axis, index);
-    }
-    else if (orientation == "staggered")
-    {
-        return worldToStaggerCoords(world, tileSize, axis, index);
-    }
-    else if (orientation == "isometric")
-    {
-        return worldToIsoCoords(world, tileSize);
-    }
-    else if (orientation == "orthogonal")
-    {
-        return worldToOrthoCoords(world, tileSize);
-    }
-    else
+    if (orientation != "orthogonal" && orientation != "isometric" && orientation != "staggered" && orientation != "hexagonal")
     {
         detail::log("Incorrect orientation in worldToCoords");
         return sf::Vector2i();
     }
+    return MapGeometry(orientation, tileSize, axis, index, hexSideLength).worldToCoords(world);
+}
+
+sf::Vector2f coordsToWorld(std::string const& orientation, sf::Vector2i const& coords, sf::Vector2i const& tileSize, std::string const& axis, std::string const& index, unsigned int hexSideLength)
+{
+    return MapGeometry(orientation, tileSize, axis, index, hexSideLength).coordsToWorld(coords);
 }
 
 
@@ -127,6 +66,13 @@ void readFlip(unsigned int& gid, bool& horizontal, bool& vertical, bool& diagona
     gid &= ~(FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG);
 }
 
+void writeFlip(unsigned int& gid, bool horizontal, bool vertical, bool diagonal)
+{
+    gid |= (horizontal) ? FLIPPED_HORIZONTALLY_FLAG : 0;
+    gid |= (vertical) ? FLIPPED_VERTICALLY_FLAG : 0;
+    gid |= (diagonal) ? FLIPPED_DIAGONALLY_FLAG : 0;
+}
+
 PropertiesHolder::PropertiesHolder()
 : mProperites()
 {
@@ -158,6 +104,70 @@ void PropertiesHolder::saveProperties(pugi::xml_node& node)
     }
 }
 
+bool PropertiesHolder::hasProperty(std::string const& name) const
+{
+    return mProperites.find(name) != mProperites.end();
+}
+
+void PropertiesHolder::removeProperty(std::string const& name)
+{
+    mProperites.erase(name);
+}
+
+const std::unordered_map<std::string,std::string>& PropertiesHolder::getProperties() const
+{
+    return mProperites;
+}
+
+Pool::Pool(std::size_t slotSize, std::size_t slotsPerBlock)
+: mSlotSize(slotSize)
+, mSlotsPerBlock(slotsPerBlock)
+, mBlocks()
+, mFreeSlots()
+{
+    // Keep every slot aligned for any object type
+    const std::size_t alignment = alignof(std::max_align_t);
+    mSlotSize = ((mSlotSize + alignment - 1) / alignment) * alignment;
+}
+
+Pool::~Pool()
+{
+    for (std::size_t i = 0; i < mBlocks.size(); i++)
+    {
+        delete[] mBlocks[i];
+    }
+}
+
+void* Pool::allocate()
+{
+    if (mFreeSlots.empty())
+    {
+        char* block = new char[mSlotSize * mSlotsPerBlock];
+        mBlocks.push_back(block);
+        mFreeSlots.reserve(mFreeSlots.size() + mSlotsPerBlock);
+        for (std::size_t i = mSlotsPerBlock; i > 0; i--)
+        {
+            mFreeSlots.push_back(block + (i - 1) * mSlotSize);
+        }
+    }
+    void* slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    return slot;
+}
+
+void Pool::deallocate(void* slot)
+{
+    if (slot != nullptr)
+    {
+        mFreeSlots.push_back(slot);
+    }
+}
+
+std::size_t Pool::getSlotSize() const
+{
+    return mSlotSize;
+}
+
 Image::Image()
 : mData("")
 , mFormat("")
@@ -277,66 +287,48 @@ void Image::setSize(sf::Vector2i const& size)
     mSize = size;
 }
 
-bool Image::loadTexture(sf::Texture& texture, std::string const& additionalPath) const
+bool Image::loadImage(sf::Image& image, std::string const& additionalPath) const
 {
-    if (mTransparent != sf::Color::Transparent)
+    if (mSource != "")
     {
-        sf::Image image;
-        if (mSource != "")
-        {
-            if (!image.loadFromFile(additionalPath + mSource))
-            {
-                detail::log("Unable to load image from file : " + additionalPath + mSource);
-                return false;
-            }
-        }
-        else if (mData != "")
-        {
-            if (!image.loadFromMemory(mData.data(), mData.size()))
-            {
-                detail::log("Unable to load image from memory");
-                return false;
-            }
-        }
-        else
+        if (!image.loadFromFile(additionalPath + mSource))
         {
+            detail::log("Unable to load image from file : " + additionalPath + mSource);
             return false;
         }
-
-        image.createMaskFromColor(mTransparent);
-
-        if (!texture.loadFromImage(image))
+    }
+    else if (mData != "")
+    {
+        if (!image.loadFromMemory(mData.data(), mData.size()))
         {
-            detail::log("Unable to load texture from image");
+            detail::log("Unable to load image from memory");
             return false;
         }
-        return true;
     }
     else
     {
-        if (mSource != "")
-        {
-            bool ret = texture.loadFromFile(additionalPath + mSource);
-            if (!ret)
-            {
-                detail::log("Unable to load texture from file : " + additionalPath + mSource);
-            }
-            return ret;
-        }
-        else if (mData != "")
-        {
-            bool ret = texture.loadFromMemory(mData.data(), mData.size());
-            if (!ret)
-            {
-                detail::log("Unable to load texture from memory");
-            }
-            return ret;
-        }
-        else
-        {
-            return false;
-        }
+        return false;
     }
+    if (mTransparent != sf::Color::Transparent)
+    {
+        image.createMaskFromColor(mTransparent);
+    }
+    return true;
+}
+
+bool Image::loadTexture(sf::Texture& texture, std::string const& additionalPath) const
+{
+    sf::Image image;
+    if (!loadImage(image, additionalPath))
+    {
+        return false;
+    }
+    if (!texture.loadFromImage(image))
+    {
+        detail::log("Unable to load texture from image");
+        return false;
+    }
+    return true;
 }
 
 } // namespace detail
@@ -1,18 +1,22 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include <cstddef>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <SFML/Graphics/ConvexShape.hpp>
 #include <SFML/Graphics/Drawable.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/RenderStates.hpp>
 #include <SFML/Graphics/RenderTarget.hpp>
 #include <SFML/Graphics/Sprite.hpp>
 #include <SFML/Graphics/Texture.hpp>
 #include <SFML/Graphics/VertexArray.hpp>
+#include <SFML/System/NonCopyable.hpp>
 
 #include "../ExtLibs/Compression.hpp"
 #include "../ExtLibs/ConcaveShape.hpp"
@@ -27,7 +31,8 @@ enum LayerType
 {
     ELayer,
     EObjectGroup,
-    EImageLayer
+    EImageLayer,
+    EFogLayer
 };
 
 enum ObjectType
@@ -38,11 +43,98 @@ enum ObjectType
     EPolyline
 };
 
+enum ObjectFlag
+{
+    EVisible = 1 << 0,
+    EFlippedHorizontally = 1 << 1,
+    EFlippedVertically = 1 << 2,
+    EFlippedDiagonally = 1 << 3
+};
+
+// Non owning view over contiguous elements, invalidated when its container changes
+template <typename T>
+class Span
+{
+    public:
+        Span();
+        Span(const T* data, std::size_t size);
+        Span(std::vector<T> const& vector);
+
+        const T* begin() const;
+        const T* end() const;
+        const T* data() const;
+        std::size_t size() const;
+        bool empty() const;
+        const T& operator[](std::size_t index) const;
+
+    private:
+        const T* mData;
+        std::size_t mSize;
+};
+
+template <typename T>
+Span<T>::Span()
+: mData(nullptr)
+, mSize(0)
+{
+}
+
+template <typename T>
+Span<T>::Span(const T* data, std::size_t size)
+: mData(data)
+, mSize(size)
+{
+}
+
+template <typename T>
+Span<T>::Span(std::vector<T> const& vector)
+: mData(vector.data())
+, mSize(vector.size())
+{
+}
+
+template <typename T>
+const T* Span<T>::begin() const
+{
+    return mData;
+}
+
+template <typename T>
+const T* Span<T>::end() const
+{
+    return mData + mSize;
+}
+
+template <typename T>
+const T* Span<T>::data() const
+{
+    return mData;
+}
+
+template <typename T>
+std::size_t Span<T>::size() const
+{
+    return mSize;
+}
+
+template <typename T>
+bool Span<T>::empty() const
+{
+    return mSize == 0;
+}
+
+template <typename T>
+const T& Span<T>::operator[](std::size_t index) const
+{
+    return mData[index];
+}
+
 sf::Vector2i worldToOrthoCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize);
 sf::Vector2i worldToIsoCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize);
 sf::Vector2i worldToStaggerCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize, std::string const& axis = "y", std::string const& index = "odd");
 sf::Vector2i worldToHexaCoords(sf::Vector2f const& world, sf::Vector2i const& tileSize, unsigned int hexSideLength = 0, std::string const& axis = "y", std::string const& index = "odd");
 sf::Vector2i worldToCoords(std::string const& orientation, sf::Vector2f const& world, sf::Vector2i const& tileSize, std::string const& axis = "y", std::string const& index = "odd", unsigned int hexSideLength = 0);
+sf::Vector2f coordsToWorld(std::string const& orientation, sf::Vector2i const& coords, sf::Vector2i const& tileSize, std::string const& axis = "y", std::string const& index = "odd", unsigned int hexSideLength = 0);
 
 namespace detail
 {
@@ -50,6 +142,7 @@ namespace detail
 void log(std::string const& message);
 void readFlip(unsigned int& gid);
 void readFlip(unsigned int& gid, bool& horizontal, bool& vertical, bool& diagonal);
+void writeFlip(unsigned int& gid, bool horizontal, bool vertical, bool diagonal);
 
 template <typename T>
 std::string toString(T const& value)
@@ -166,6 +259,10 @@ class PropertiesHolder
         template <typename T>
         T getProperty(std::string const& name);
 
+        bool hasProperty(std::string const& name) const;
+        void removeProperty(std::string const& name);
+        const std::unordered_map<std::string,std::string>& getProperties() const;
+
     protected:
         std::unordered_map<std::string,std::string> mProperites;
 };
@@ -179,7 +276,7 @@ void PropertiesHolder::setProperty(std::string const& name, T const& value)
 template <typename T>
 T PropertiesHolder::getProperty(std::string const& name)
 {
-    T value;
+    T value = T();
     auto itr = mProperites.find(name);
     if (itr != mProperites.end())
     {
@@ -188,6 +285,24 @@ T PropertiesHolder::getProperty(std::string const& name)
     return value;
 }
 
+class Pool : sf::NonCopyable
+{
+    public:
+        Pool(std::size_t slotSize, std::size_t slotsPerBlock = 256);
+        ~Pool();
+
+        void* allocate();
+        void deallocate(void* slot);
+
+        std::size_t getSlotSize() const;
+
+    private:
+        std::size_t mSlotSize;
+        std::size_t mSlotsPerBlock;
+        std::vector<char*> mBlocks;
+        std::vector<void*> mFreeSlots;
+};
+
 class Image
 {
     public:
@@ -208,6 +323,8 @@ class Image
         void setTransparent(sf::Color const& color);
         void setSize(sf::Vector2i const& size);
 
+        // The image keeps the pixels on the CPU side, with the transparent color masked
+        bool loadImage(sf::Image& image, std::string const& additionalPath = "") const;
         bool loadTexture(sf::Texture& texture, std::string const& additionalPath = "") const;
 
     protected: